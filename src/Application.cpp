@@ -5,7 +5,6 @@
 #include "../imgui-docking/backends/imgui_impl_glfw.h"
 #include "../imgui-docking/backends/imgui_impl_opengl3.h"
 
-#define STB_IMAGE_IMPLEMENTATION
 #include "../stb-master/stb_image.h"
 
 #define GL_SILENCE_DEPRECATION
@@ -20,6 +19,7 @@ Application::Application(int windowWidth, int windowHeight) noexcept :
     m_InitialWindowWidth(windowWidth), m_InitialWindowHeight(windowHeight),
     m_LastViewportWidth(-1), m_LastViewportHeight(-1),
     m_Renderer(windowWidth, windowHeight),
+    m_ImageTexture(nullptr),
     m_TotalRenderTime(0.f), m_LastRenderTime(0.f),
     m_SaveImageFilePath(c_AnyInputFilePathLength, '\0'),
     m_SceneFilePath(c_AnyInputFilePathLength, '\0'),
@@ -45,33 +45,12 @@ Application::Application(int windowWidth, int windowHeight) noexcept :
 
     m_Scene.camera = Camera(windowWidth, windowHeight);
 
-    m_AccelerationStructure = nullptr;
-    m_ObjectsBLAS = nullptr;
-
-    m_NonHittable = new NonHittable();
-    std::array<IHittable*, 1> m_NonHittableArray = {m_NonHittable};
-    m_NonHittableBLAS = new BLAS(new BVH(m_NonHittableArray));
-
     LoadSceneFromFile(c_DefaultScenePath);
 }
 
 Application::~Application() noexcept {
-    if (m_AccelerationStructure != nullptr) {
-        delete m_AccelerationStructure;
-    }
-
-    if (m_ObjectsBLAS != nullptr) {
-        delete m_ObjectsBLAS->GetBVH();
-        delete m_ObjectsBLAS;
-    }
-
-    if (m_NonHittable != nullptr) {
-        delete m_NonHittable;
-    }
-
-    if (m_NonHittableBLAS != nullptr) {
-        delete m_NonHittableBLAS->GetBVH();
-        delete m_NonHittableBLAS;
+    if (m_ImageTexture != nullptr) {
+        delete m_ImageTexture;
     }
 }
 
@@ -123,6 +102,11 @@ int Application::Run() noexcept {
 
     MainLoop();
 
+    if (m_ImageTexture != nullptr) {
+        delete m_ImageTexture;
+        m_ImageTexture = nullptr;
+    }
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -198,11 +182,28 @@ void Application::OnUpdate() noexcept {
             m_Scene.camera.OnViewportResize(m_LastViewportWidth, m_LastViewportHeight);
 
             m_Renderer.OnResize(m_LastViewportWidth, m_LastViewportHeight);
+
+            if (m_ImageTexture != nullptr) {
+                delete m_ImageTexture;
+                m_ImageTexture = nullptr;
+            }
         }
 
         Image *image = m_Renderer.GetImage();
-        if (image != nullptr) {
-            ImGui::Image((void*)(intptr_t)image->GetDescriptor(), ImGui::GetContentRegionAvail());
+        if (image != nullptr && m_ImageTexture == nullptr) {
+            m_ImageTexture = new ImageTexture(image);
+        }
+
+        if (m_ImageTexture != nullptr) {
+            ImGui::Image((void*)(intptr_t)m_ImageTexture->GetDescriptor(), ImGui::GetContentRegionAvail());
+
+            if (ImGui::IsItemHovered()) {
+                ImVec2 imageMin = ImGui::GetItemRectMin();
+                ImVec2 mousePosition = ImGui::GetMousePos();
+                m_Renderer.SetFocusPoint((int)(mousePosition.x - imageMin.x), (int)(mousePosition.y - imageMin.y));
+            } else {
+                m_Renderer.SetFocusPoint(-1, -1);
+            }
         }
     }
     ImGui::End();
@@ -216,14 +217,47 @@ void Application::OnUpdate() noexcept {
         m_LastID = 0;
         m_SomeObjectChanged = false;
         m_SomeGeometryChanged = false;
+        m_MovedInstances.clear();
 
         ProcessSceneCollapsingHeaders();
 
         ImGui::Checkbox("Accumulate", Math::ValuePointer(m_Renderer.Accumulate()));
         ImGui::Checkbox("Accelerate", Math::ValuePointer(m_Renderer.Accelerate()));
+        ImGui::Checkbox("Adaptive sampling", Math::ValuePointer(m_Renderer.Adaptive()));
+        if (m_Renderer.Adaptive()) {
+            ImGui::InputFloat("Target noise", Math::ValuePointer(m_Renderer.TargetNoise()));
+            ImGui::InputInt("Min samples", Math::ValuePointer(m_Renderer.MinAdaptiveSamples()));
+            ImGui::InputInt("Max samples per frame", Math::ValuePointer(m_Renderer.MaxSamplesPerFrame()));
+            m_Renderer.TargetNoise() = Math::Max(m_Renderer.TargetNoise(), 0.0001f);
+            m_Renderer.MinAdaptiveSamples() = Math::Max(m_Renderer.MinAdaptiveSamples(), 2);
+            m_Renderer.MaxSamplesPerFrame() = Math::Max(m_Renderer.MaxSamplesPerFrame(), 1);
+        }
         if (ImGui::InputInt("Used threads", Math::ValuePointer(m_Renderer.UsedThreadCount()))) {
             m_Renderer.SetUsedThreadCount(m_Renderer.UsedThreadCount());
         }
+        ImGui::InputInt("Tile size", Math::ValuePointer(m_Renderer.TileSize()));
+        m_Renderer.TileSize() = Math::Max(m_Renderer.TileSize(), 1);
+
+        int tileOrder = static_cast<int>(m_Renderer.GetTileOrder());
+        if (ImGui::Combo("Tile order", &tileOrder, "Scanline\0Morton\0Spiral\0")) {
+            m_Renderer.SetTileOrder(static_cast<TileOrder>(tileOrder));
+        }
+
+        int integrator = static_cast<int>(m_Renderer.GetIntegrator());
+        if (ImGui::Combo("Integrator", &integrator, "Megakernel\0Wavefront\0")) {
+            m_Renderer.SetIntegrator(static_cast<Integrator>(integrator));
+        }
+
+        int packetWidth = m_Renderer.GetPacketWidth() == 8 ? 2 : (m_Renderer.GetPacketWidth() == 4 ? 1 : 0);
+        if (ImGui::Combo("Camera ray packets", &packetWidth, "Off\0Width 4\0Width 8\0")) {
+            m_Renderer.SetPacketWidth(packetWidth == 2 ? 8 : (packetWidth == 1 ? 4 : 1));
+        }
+
+        int lightSamplingStrategy = static_cast<int>(m_SceneGeometry.GetLightSampler().GetStrategy());
+        if (ImGui::Combo("Light sampling", &lightSamplingStrategy, "All\0Power\0BVH\0")) {
+            m_SceneGeometry.GetLightSampler().SetStrategy(static_cast<LightSamplingStrategy>(lightSamplingStrategy));
+        }
+
         ImGui::InputInt("Ray depth", Math::ValuePointer(m_Renderer.RayDepth()));
         ImGui::InputFloat("Gamma", Math::ValuePointer(m_Renderer.Gamma()));
 
@@ -236,12 +270,16 @@ void Application::OnUpdate() noexcept {
 
             m_LastRenderTime = Timer::MeasureInMillis([this](){
                 if (m_Renderer.Accelerate()) {
-                    m_Renderer.Render(m_Scene.camera, m_AccelerationStructure, m_Lights, m_Scene.materials);
+                    m_Renderer.Render(m_Scene.camera, m_SceneGeometry.GetAccelerationStructure(), m_SceneGeometry.GetLightSampler(), m_Scene.materials);
                 } else {
-                    m_Renderer.Render(m_Scene.camera, m_Objects, m_Lights, m_Scene.materials);
+                    m_Renderer.Render(m_Scene.camera, m_SceneGeometry.GetObjects(), m_SceneGeometry.GetLightSampler(), m_Scene.materials);
                 }
             });
 
+            if (m_ImageTexture != nullptr) {
+                m_ImageTexture->Update();
+            }
+
             if (m_Renderer.Accumulate()) {
                 m_TotalRenderTime += m_LastRenderTime;
             } else {
@@ -272,6 +310,15 @@ void Application::OnUpdate() noexcept {
         ImGui::Text("Last render time: %fms", m_LastRenderTime);
         ImGui::Text("Average render time: %fms", m_TotalRenderTime / (Math::Max(m_Renderer.GetFrameIndex() - 1, 1)));
         ImGui::Text("Accumulated frame count: %d", Math::Max(m_Renderer.GetFrameIndex() - 1, 1));
+        if (m_Renderer.Adaptive()) {
+            ImGui::Text("Noise level: %f", m_Renderer.GetNoiseLevel());
+            ImGui::Text("Converged pixels: %d", m_Renderer.GetConvergedPixelCount());
+        }
+
+        auto idleTimes = m_Renderer.GetThreadIdleTimes();
+        for (int i = 0; i < (int)idleTimes.size(); ++i) {
+            ImGui::Text("Thread %d idle time: %fms", i, idleTimes[i]);
+        }
     }
 
     ImGui::End();
@@ -294,12 +341,19 @@ void Application::ProcessSceneCollapsingHeaders() noexcept {
     ProcessMaterialsCollapsingHeader();
     ProcessLoadingPropertiesHeader();
 
+    // Lights point into object arrays, so they are gathered again after adds and deletes
     if (m_SomeObjectChanged) {
         UpdateObjects();
+        UpdateLights();
+    } else if (m_SomeGeometryChanged) {
+        m_SceneGeometry.RefitObjects();
     }
 
-    if (m_SomeGeometryChanged) {
+    bool objectsRebuilt = m_SceneGeometry.PollObjectsRebuild();
+    if (m_SomeObjectChanged || objectsRebuilt) {
         UpdateTLAS();
+    } else if (!m_MovedInstances.empty()) {
+        m_SceneGeometry.UpdateInstances(m_MovedInstances);
     }
 }
 
@@ -520,12 +574,12 @@ void Application::ProcessModelsCollapsingHeader() noexcept {
 
             if (ImGui::InputFloat3("Translation", Math::ValuePointer(modelInstance->Translation()))) {
                 modelInstance->UpdateTransform();
-                m_SomeGeometryChanged = true;
+                m_MovedInstances.push_back(modelInstance->GetBLAS());
             }
 
             if (ImGui::InputFloat3("Angles", Math::ValuePointer(modelInstance->Angles()))) {
                 modelInstance->UpdateTransform();
-                m_SomeGeometryChanged = true;
+                m_MovedInstances.push_back(modelInstance->GetBLAS());
             }
 
             ImGui::PopID();
@@ -637,6 +691,24 @@ void Application::ProcessLoadingPropertiesHeader() noexcept {
 
         ImGui::Checkbox("Generate smooth normals", &loadingProperties.generateSmoothNormals);
         ImGui::Checkbox("Surface area weighting", &loadingProperties.surfaceAreaWeighting);
+
+        auto &bvhBuildOptions = loadingProperties.bvhBuildOptions;
+        int bvhBuildMethod = static_cast<int>(bvhBuildOptions.method);
+        if (ImGui::Combo("BVH builder", &bvhBuildMethod, "Sweep SAH\0Binned SAH\0Spatial SAH\0Linear (Morton)\0")) {
+            bvhBuildOptions.method = static_cast<BVHBuildMethod>(bvhBuildMethod);
+        }
+
+        if (ImGui::InputInt("BVH max leaf size", &bvhBuildOptions.maxLeafSize)) {
+            bvhBuildOptions.maxLeafSize = Math::Clamp(bvhBuildOptions.maxLeafSize, 1, 16);
+        }
+
+        if (bvhBuildOptions.method == BVHBuildMethod::LinearMorton) {
+            ImGui::Checkbox("Optimize BVH treelets", &bvhBuildOptions.optimizeTreelets);
+        }
+
+        ImGui::Checkbox("Wide BVH nodes", &bvhBuildOptions.wideNodes);
+        ImGui::Checkbox("Quantized BVH nodes", &bvhBuildOptions.quantizedNodes);
+        ImGui::Checkbox("Cache BVH on disk", &loadingProperties.cacheBVH);
     }
 }
 
@@ -661,25 +733,7 @@ void Application::LoadSceneFromFile(const std::filesystem::path &pathToFile) noe
 }
 
 void Application::UpdateTLAS() noexcept {
-    if (m_AccelerationStructure != nullptr) {
-        delete m_AccelerationStructure;
-        m_AccelerationStructure = nullptr;
-    }
-
-    std::vector<BLAS*> blas;
-    if (m_ObjectsBLAS != nullptr) {
-        blas.push_back(m_ObjectsBLAS);
-    }
-
-    for (auto modelInstance : m_Scene.modelInstances) {
-        blas.push_back(modelInstance->GetBLAS());
-    }
-
-    if (blas.empty()) {
-        blas.push_back(m_NonHittableBLAS);
-    }
-
-    m_AccelerationStructure = new TLAS(blas);
+    m_SceneGeometry.UpdateTLAS(m_Scene);
 }
 
 void Application::SaveSceneToFile(const std::filesystem::path &pathToFile) const noexcept {
@@ -696,60 +750,26 @@ void Application::SaveSceneToFile(const std::filesystem::path &pathToFile) const
 }
 
 void Application::UpdateObjects() noexcept {
-    m_Objects.clear();
-
     m_SphereMaterialIndices.clear();
-    for (auto &sphere : m_Scene.spheres) {
-        m_Objects.push_back(&sphere);
+    for (const auto &sphere : m_Scene.spheres) {
         m_SphereMaterialIndices.push_back(sphere.material->index);
     }
 
     m_TriangleMaterialIndices.clear();
-    for (auto &triangle : m_Scene.triangles) {
-        m_Objects.push_back(&triangle);
+    for (const auto &triangle : m_Scene.triangles) {
         m_TriangleMaterialIndices.push_back(triangle.material->index);
     }
 
     m_BoxMaterialIndices.clear();
-    for (auto &box : m_Scene.boxes) {
-        m_Objects.push_back(&box);
+    for (const auto &box : m_Scene.boxes) {
         m_BoxMaterialIndices.push_back(box.material->index);
     }
 
-    if (m_ObjectsBLAS != nullptr) {
-        delete m_ObjectsBLAS->GetBVH();
-        delete m_ObjectsBLAS;
-        m_ObjectsBLAS = nullptr;
-    }
-
-    if (m_Objects.empty()) {
-        return;
-    }
-
-    BVH *bvh = new BVH(m_Objects);
-    m_ObjectsBLAS = new BLAS(bvh);
+    m_SceneGeometry.UpdateObjects(m_Scene);
 }
 
 void Application::UpdateLights() noexcept {
-    m_Lights.clear();
-
-    for (auto &sphere : m_Scene.spheres) {
-        if (sphere.material->emissionPower > 0.f) {
-            m_Lights.emplace_back(&sphere);
-        }
-    }
-
-    for (auto &triangle : m_Scene.triangles) {
-        if (triangle.material->emissionPower > 0.f) {
-            m_Lights.emplace_back(&triangle);
-        }
-    }
-
-    for (auto &box : m_Scene.boxes) {
-        if (box.material->emissionPower > 0.f) {
-            m_Lights.emplace_back(&box);
-        }
-    }
+    m_SceneGeometry.UpdateLights(m_Scene);
 }
 
 void Application::UpdateObjectMaterials() noexcept {
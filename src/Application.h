@@ -4,11 +4,11 @@
 #include "../glfw-3.4/include/GLFW/glfw3.h"
 
 #include "Scene.h"
+#include "SceneGeometry.h"
 #include "Camera.h"
 #include "Renderer.h"
 #include "image/ImageSaver.h"
-#include "hittable/NonHittable.h"
-#include "acceleration/TLAS.h"
+#include "image/ImageTexture.h"
 
 #include <cstring>
 #include <filesystem>
@@ -68,6 +68,8 @@ private:
     int m_LastID;
     bool m_SomeObjectChanged;
     bool m_SomeGeometryChanged;
+    //! Models whose transform was edited this frame, their TLAS leaves are updated in place
+    std::vector<const BLAS*> m_MovedInstances;
 
     double m_TotalRenderTime;
     double m_LastRenderTime;
@@ -76,13 +78,9 @@ private:
     std::string m_SceneFilePath;
 
     Scene m_Scene;
+    SceneGeometry m_SceneGeometry;
     Renderer m_Renderer;
-
-    TLAS *m_AccelerationStructure;
-    BLAS *m_ObjectsBLAS;
-
-    NonHittable *m_NonHittable;
-    BLAS *m_NonHittableBLAS;
+    ImageTexture *m_ImageTexture;
 
     Math::Vector3f m_RayMissColor;
 
@@ -90,9 +88,6 @@ private:
     std::vector<int> m_TriangleMaterialIndices;
     std::vector<int> m_BoxMaterialIndices;
 
-    std::vector<IHittable*> m_Objects;
-    std::vector<Light> m_Lights;
-
     Material m_AddMaterial;
     Shapes::Sphere m_AddSphere;
     Shapes::Triangle m_AddTriangle;
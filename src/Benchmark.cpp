@@ -0,0 +1,1452 @@
+#include "acceleration/TLAS.h"
+#include "hittable/Sphere.h"
+#include "Light.h"
+#include "Scene.h"
+#include "SceneGeometry.h"
+#include "Renderer.h"
+#include "Timer.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <random>
+#include <thread>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+    //! Shadow ray with distance to sampled point on light
+    struct ShadowQuery {
+        Ray ray;
+        float tMax;
+    };
+
+    //! Scene of random spheres with all structures needed to trace rays through it
+    struct SphereScene {
+        std::vector<Shapes::Sphere> spheres;
+        std::vector<IHittable*> objects;
+        BVH *bvh = nullptr;
+        BLAS *blas = nullptr;
+        TLAS *tlas = nullptr;
+
+        SphereScene(int sphereCount, std::mt19937 &generator) noexcept {
+            std::uniform_real_distribution<float> position(-50.f, 50.f);
+            std::uniform_real_distribution<float> radius(0.5f, 2.f);
+
+            spheres.reserve(sphereCount);
+            for (int i = 0; i < sphereCount; ++i) {
+                spheres.emplace_back(Math::Vector3f(position(generator), position(generator), position(generator)), radius(generator), nullptr);
+            }
+
+            for (auto &sphere : spheres) {
+                objects.push_back(&sphere);
+            }
+
+            bvh = new BVH(objects);
+            blas = new BLAS(bvh);
+            std::vector<BLAS*> blasArray = {blas};
+            tlas = new TLAS(blasArray);
+        }
+
+        ~SphereScene() noexcept {
+            delete tlas;
+            delete blas;
+            delete bvh;
+        }
+    };
+
+    std::vector<ShadowQuery> GenerateShadowQueries(int count, std::mt19937 &generator) noexcept {
+        std::uniform_real_distribution<float> position(-60.f, 60.f);
+
+        std::vector<ShadowQuery> queries(count);
+        for (auto &query : queries) {
+            Math::Vector3f origin(position(generator), position(generator), position(generator));
+            Math::Vector3f target(position(generator), position(generator), position(generator));
+
+            Math::Vector3f toTarget = target - origin;
+            float distance = Math::Length(toTarget);
+
+            query.ray.origin = origin;
+            query.ray.direction = toTarget / distance;
+            query.ray.inverseDirection = 1.f / query.ray.direction;
+            query.tMax = distance - Light::DistanceEpsilon;
+        }
+
+        return queries;
+    }
+
+    //! Runs ```occluded``` for every query. Returns nanoseconds per ray and number of blocked rays
+    template<typename F>
+    std::pair<double, int> MeasureShadowRays(std::span<const ShadowQuery> queries, F occluded) noexcept {
+        int blocked = 0;
+        double time = Timer::MeasureInMillis([&]() {
+            for (const auto &query : queries) {
+                blocked += occluded(query) ? 1 : 0;
+            }
+        });
+
+        return {time * 1e6 / static_cast<double>(queries.size()), blocked};
+    }
+
+    //! Compares closest-hit and any-hit shadow rays, linear and through TLAS, for growing number of spheres
+    int RunShadowBenchmark(int rayCount) noexcept {
+        std::mt19937 generator(1);
+        auto queries = GenerateShadowQueries(rayCount, generator);
+
+        std::cout << "Shadow rays: " << rayCount << ", ns per ray\n";
+        std::cout << std::setw(10) << "spheres" << std::setw(14) << "linear hit" << std::setw(16) << "linear occl." << std::setw(12) << "tlas hit" << std::setw(14) << "tlas occl." << std::setw(10) << "blocked" << '\n';
+
+        for (int sphereCount = 16; sphereCount <= 4096; sphereCount *= 4) {
+            SphereScene scene(sphereCount, generator);
+
+            auto [linearHitTime, linearHitBlocked] = MeasureShadowRays(queries, [&scene](const ShadowQuery &query) {
+                HitPayload payload;
+                payload.t = Math::Constants::Infinity<float>;
+
+                bool anyHit = false;
+                for (auto object : scene.objects) {
+                    anyHit |= object->Hit(query.ray, 0.01f, Math::Min(payload.t, query.tMax), payload);
+                }
+
+                return anyHit;
+            });
+
+            auto [linearOccludedTime, linearOccludedBlocked] = MeasureShadowRays(queries, [&scene](const ShadowQuery &query) {
+                for (auto object : scene.objects) {
+                    if (object->Occluded(query.ray, 0.01f, query.tMax)) {
+                        return true;
+                    }
+                }
+
+                return false;
+            });
+
+            auto [tlasHitTime, tlasHitBlocked] = MeasureShadowRays(queries, [&scene](const ShadowQuery &query) {
+                HitPayload payload;
+                payload.t = Math::Constants::Infinity<float>;
+                return scene.tlas->Hit(query.ray, 0.01f, query.tMax, payload);
+            });
+
+            auto [tlasOccludedTime, tlasOccludedBlocked] = MeasureShadowRays(queries, [&scene](const ShadowQuery &query) {
+                return scene.tlas->Occluded(query.ray, 0.01f, query.tMax);
+            });
+
+            if (linearHitBlocked != linearOccludedBlocked || linearHitBlocked != tlasHitBlocked || linearHitBlocked != tlasOccludedBlocked) {
+                std::cerr << "Mismatch in blocked rays for " << sphereCount << " spheres\n";
+                return -1;
+            }
+
+            std::cout << std::fixed << std::setprecision(1)
+                      << std::setw(10) << sphereCount
+                      << std::setw(14) << linearHitTime
+                      << std::setw(16) << linearOccludedTime
+                      << std::setw(12) << tlasHitTime
+                      << std::setw(14) << tlasOccludedTime
+                      << std::setw(10) << tlasOccludedBlocked << '\n';
+        }
+
+        return 0;
+    }
+
+    Material MakeMaterial(const Math::Vector3f &albedo, float emissionPower) noexcept {
+        Material material;
+        material.textures[TextureIndex::Albedo] = new Texture(albedo);
+        material.textures[TextureIndex::Metallic] = new Texture(Math::Vector3f(0.f));
+        material.textures[TextureIndex::Specular] = new Texture(Math::Vector3f(0.f));
+        material.textures[TextureIndex::Roughness] = new Texture(Math::Vector3f(1.f));
+        material.textures[TextureIndex::Bump] = nullptr;
+        material.emissionPower = emissionPower;
+        return material;
+    }
+
+    //! Fills ```scene``` with floor, some diffuse occluders and ```lightCount``` small emissive spheres
+    void MakeManyLightScene(Scene &scene, int lightCount, int width, int height, std::mt19937 &generator) noexcept {
+        std::uniform_real_distribution<float> planar(-40.f, 40.f);
+        std::uniform_real_distribution<float> height01(0.f, 1.f);
+
+        scene.materials.reserve(2);
+        scene.materials.push_back(MakeMaterial(Math::Vector3f(0.8f), 0.f));
+        scene.materials.push_back(MakeMaterial(Math::Vector3f(1.f), 200.f / static_cast<float>(lightCount)));
+
+        const Material *diffuse = &scene.materials[0];
+        const Material *emissive = &scene.materials[1];
+
+        scene.spheres.emplace_back(Math::Vector3f(0.f, -1000.f, 0.f), 1000.f, diffuse);
+        for (int i = 0; i < 32; ++i) {
+            float radius = 1.f + 2.f * height01(generator);
+            scene.spheres.emplace_back(Math::Vector3f(planar(generator), radius, planar(generator)), radius, diffuse);
+        }
+
+        for (int i = 0; i < lightCount; ++i) {
+            scene.spheres.emplace_back(Math::Vector3f(planar(generator), 8.f + 4.f * height01(generator), planar(generator)), 0.3f, emissive);
+        }
+
+        scene.camera = Camera(width, height, {0.f, 40.f, 70.f}, {0.f, 0.f, 0.f}, 45.f);
+    }
+
+    void FreeMaterials(Scene &scene) noexcept {
+        for (auto &material : scene.materials) {
+            for (auto texture : material.textures) {
+                if (texture != nullptr) {
+                    delete texture;
+                }
+            }
+        }
+    }
+
+    //! Renders many-light scene with every light sampling strategy and reports frame time and mean luminance
+    int RunLightBenchmark(int samplesPerPixel) noexcept {
+        constexpr int width = 64, height = 36;
+
+        std::cout << "Many lights, " << width << "x" << height << ", " << samplesPerPixel << " spp, ms per frame (mean luminance)\n";
+        std::cout << std::setw(10) << "lights" << std::setw(20) << "all" << std::setw(20) << "power" << std::setw(20) << "bvh" << '\n';
+
+        for (int lightCount = 16; lightCount <= 1024; lightCount *= 4) {
+            std::mt19937 generator(1);
+            Scene scene;
+            MakeManyLightScene(scene, lightCount, width, height, generator);
+
+            SceneGeometry sceneGeometry;
+            sceneGeometry.UpdateObjects(scene);
+            sceneGeometry.UpdateLights(scene);
+            sceneGeometry.UpdateTLAS(scene);
+
+            std::cout << std::setw(10) << lightCount;
+            for (auto strategy : {LightSamplingStrategy::All, LightSamplingStrategy::Power, LightSamplingStrategy::BVH}) {
+                sceneGeometry.GetLightSampler().SetStrategy(strategy);
+
+                Renderer renderer(width, height);
+                renderer.SetUsedThreadCount(renderer.GetAvailableThreadCount());
+                renderer.Accumulate() = true;
+                renderer.Accelerate() = true;
+
+                double time = Timer::MeasureInMillis([&]() {
+                    for (int sample = 0; sample < samplesPerPixel; ++sample) {
+                        scene.camera.ComputeRayDirections();
+                        renderer.Render(scene.camera, sceneGeometry.GetAccelerationStructure(), sceneGeometry.GetLightSampler(), scene.materials);
+                    }
+                });
+
+                double luminance = 0.0;
+                std::span<const std::uint32_t> pixels(renderer.GetImage()->GetData(), width * height);
+                for (auto pixel : pixels) {
+                    Math::Vector3f color(static_cast<float>(pixel & 0xff), static_cast<float>((pixel >> 8) & 0xff), static_cast<float>((pixel >> 16) & 0xff));
+                    luminance += Utilities::Luminance(color);
+                }
+                luminance /= static_cast<double>(pixels.size());
+
+                std::ostringstream cell;
+                cell << std::fixed << std::setprecision(1) << time / samplesPerPixel << " (" << luminance << ")";
+                std::cout << std::setw(20) << cell.str();
+            }
+            std::cout << '\n';
+
+            FreeMaterials(scene);
+        }
+
+        return 0;
+    }
+
+    //! Renders ```samplesPerPixel``` frames with given integrator. Returns ms per frame and copies image into ```pixels```
+    double RenderWithIntegrator(Scene &scene, const SceneGeometry &sceneGeometry, Integrator integrator, int width, int height, int samplesPerPixel, std::vector<std::uint32_t> &pixels) noexcept {
+        Renderer renderer(width, height);
+        renderer.SetUsedThreadCount(renderer.GetAvailableThreadCount());
+        renderer.Accumulate() = true;
+        renderer.Accelerate() = true;
+        renderer.SetIntegrator(integrator);
+
+        double time = Timer::MeasureInMillis([&]() {
+            for (int sample = 0; sample < samplesPerPixel; ++sample) {
+                scene.camera.ComputeRayDirections();
+                renderer.Render(scene.camera, sceneGeometry.GetAccelerationStructure(), sceneGeometry.GetLightSampler(), scene.materials);
+            }
+        });
+
+        const std::uint32_t *data = renderer.GetImage()->GetData();
+        pixels.assign(data, data + width * height);
+
+        return time / samplesPerPixel;
+    }
+
+    //! Root mean square difference of RGB channels of two images in 8-bit units
+    double ComputeRMSE(std::span<const std::uint32_t> a, std::span<const std::uint32_t> b) noexcept {
+        double sum = 0.0;
+        for (int i = 0; i < (int)a.size(); ++i) {
+            for (int shift = 0; shift < 24; shift += 8) {
+                double difference = static_cast<double>((a[i] >> shift) & 0xff) - static_cast<double>((b[i] >> shift) & 0xff);
+                sum += difference * difference;
+            }
+        }
+
+        return std::sqrt(sum / (3.0 * a.size()));
+    }
+
+    //! Root mean square difference of RGB channels averaged over ```blockSize``` square blocks of two ```width``` wide images. Averaging hides per-pixel noise, but not shifted lighting
+    double ComputeBlockRMSE(std::span<const std::uint32_t> a, std::span<const std::uint32_t> b, int width, int height, int blockSize) noexcept {
+        double sum = 0.0;
+        int blockCount = 0;
+        for (int y = 0; y + blockSize <= height; y += blockSize) {
+            for (int x = 0; x + blockSize <= width; x += blockSize) {
+                for (int shift = 0; shift < 24; shift += 8) {
+                    double difference = 0.0;
+                    for (int t = y; t < y + blockSize; ++t) {
+                        for (int j = x; j < x + blockSize; ++j) {
+                            difference += static_cast<double>((a[width * t + j] >> shift) & 0xff) - static_cast<double>((b[width * t + j] >> shift) & 0xff);
+                        }
+                    }
+                    difference /= static_cast<double>(blockSize * blockSize);
+                    sum += difference * difference;
+                }
+                ++blockCount;
+            }
+        }
+
+        return std::sqrt(sum / (3.0 * blockCount));
+    }
+
+    //! Returns sorted paths of all scenes in ```assets```
+    std::vector<std::filesystem::path> ListScenes() noexcept {
+        std::vector<std::filesystem::path> scenePaths;
+        for (const auto &entry : std::filesystem::directory_iterator("assets")) {
+            if (entry.path().extension() == ".scn") {
+                scenePaths.push_back(entry.path());
+            }
+        }
+        std::sort(scenePaths.begin(), scenePaths.end());
+
+        return scenePaths;
+    }
+
+    //! Loads scene with camera of given size. Returns false if scene cannot be read
+    bool LoadScene(const std::filesystem::path &scenePath, int width, int height, Scene &scene) noexcept {
+        scene.camera = Camera(width, height);
+
+        std::ifstream fileStream(scenePath, std::ios::binary);
+        if (!fileStream || scene.Deserialize(fileStream).has_value()) {
+            std::cerr << "Skipping scene: " << scenePath << '\n';
+            return false;
+        }
+
+        return true;
+    }
+
+    //! Renders every scene in ```assets``` with megakernel and wavefront integrators. Second megakernel render shows noise floor of the difference
+    int RunIntegratorBenchmark(int samplesPerPixel) noexcept {
+        constexpr int width = 160, height = 90;
+
+        auto scenePaths = ListScenes();
+
+        std::cout << "Integrators, " << width << "x" << height << ", " << samplesPerPixel << " spp, ms per frame\n";
+        std::cout << std::setw(28) << "scene" << std::setw(12) << "megakernel" << std::setw(12) << "wavefront" << std::setw(10) << "speedup" << std::setw(14) << "rmse mk-wf" << std::setw(14) << "rmse mk-mk" << '\n';
+
+        for (const auto &scenePath : scenePaths) {
+            Scene scene;
+            if (!LoadScene(scenePath, width, height, scene)) {
+                continue;
+            }
+
+            SceneGeometry sceneGeometry;
+            sceneGeometry.UpdateObjects(scene);
+            sceneGeometry.UpdateLights(scene);
+            sceneGeometry.UpdateTLAS(scene);
+
+            std::vector<std::uint32_t> megakernelPixels, wavefrontPixels, referencePixels;
+            double megakernelTime = RenderWithIntegrator(scene, sceneGeometry, Integrator::Megakernel, width, height, samplesPerPixel, megakernelPixels);
+            double wavefrontTime = RenderWithIntegrator(scene, sceneGeometry, Integrator::Wavefront, width, height, samplesPerPixel, wavefrontPixels);
+            RenderWithIntegrator(scene, sceneGeometry, Integrator::Megakernel, width, height, samplesPerPixel, referencePixels);
+
+            std::cout << std::fixed << std::setprecision(2)
+                      << std::setw(28) << scenePath.filename().string()
+                      << std::setw(12) << megakernelTime
+                      << std::setw(12) << wavefrontTime
+                      << std::setw(10) << megakernelTime / wavefrontTime
+                      << std::setw(14) << ComputeRMSE(megakernelPixels, wavefrontPixels)
+                      << std::setw(14) << ComputeRMSE(megakernelPixels, referencePixels) << '\n';
+        }
+
+        return 0;
+    }
+
+    //! Renders ```samplesPerPixel``` frames of ```tlas``` lit by ```lightSampler``` with given integrator and copies image into ```pixels```. Paths stop after direct light at first hit and one bounce, which keeps noise low
+    void RenderAccelerationStructure(Scene &scene, const TLAS &tlas, const LightSampler &lightSampler, Integrator integrator, int width, int height, int samplesPerPixel, std::vector<std::uint32_t> &pixels) noexcept {
+        Renderer renderer(width, height);
+        renderer.SetUsedThreadCount(renderer.GetAvailableThreadCount());
+        renderer.Accumulate() = true;
+        renderer.Accelerate() = true;
+        renderer.SetIntegrator(integrator);
+        renderer.RayDepth() = 2;
+
+        for (int sample = 0; sample < samplesPerPixel; ++sample) {
+            scene.camera.ComputeRayDirections();
+            renderer.Render(scene.camera, &tlas, lightSampler, scene.materials);
+        }
+
+        const std::uint32_t *data = renderer.GetImage()->GetData();
+        pixels.assign(data, data + width * height);
+    }
+
+    //! Renders spheres and triangles as rotated and translated instance and as the same shapes transformed into world space. Both must shade alike, difference is compared with noise between two world space renders
+    int RunInstanceBenchmark(int samplesPerPixel) noexcept {
+        constexpr int width = 96, height = 54;
+
+        Scene scene;
+        scene.materials.reserve(2);
+        scene.materials.push_back(MakeMaterial(Math::Vector3f(0.8f), 0.f));
+        scene.materials.push_back(MakeMaterial(Math::Vector3f(1.f), 3.f));
+
+        const Material *diffuse = &scene.materials[0];
+        const Material *emissive = &scene.materials[1];
+
+        std::vector<Shapes::Sphere> localSpheres = {
+            {Math::Vector3f(-1.5f, 1.f, 0.f), 1.f, diffuse},
+            {Math::Vector3f(1.5f, 0.5f, 1.f), 0.5f, diffuse}
+        };
+        std::vector<Shapes::Triangle> localTriangles = {
+            {Math::Vector3f(-6.f, 0.f, -6.f), Math::Vector3f(-6.f, 0.f, 6.f), Math::Vector3f(6.f, 0.f, 6.f), diffuse},
+            {Math::Vector3f(-6.f, 0.f, -6.f), Math::Vector3f(6.f, 0.f, 6.f), Math::Vector3f(6.f, 0.f, -6.f), diffuse},
+            {Math::Vector3f(0.f, 0.f, -2.f), Math::Vector3f(2.f, 0.f, -2.f), Math::Vector3f(1.f, 2.f, -2.f), diffuse}
+        };
+
+        Math::Matrix4f transform = Math::TranslationMatrix(Math::Vector3f(3.f, -1.f, -2.f)) * Math::RotationMatrix(Math::Vector3f(0.3f, 0.8f, 0.f));
+
+        std::vector<Shapes::Sphere> worldSpheres;
+        for (const auto &sphere : localSpheres) {
+            worldSpheres.emplace_back(Math::TransformPoint(transform, sphere.center), sphere.radius, diffuse);
+        }
+
+        std::vector<Shapes::Triangle> worldTriangles;
+        for (const auto &triangle : localTriangles) {
+            auto data = triangle.GetShapeData();
+            worldTriangles.emplace_back(Math::TransformPoint(transform, data.points[0]), Math::TransformPoint(transform, data.points[1]), Math::TransformPoint(transform, data.points[2]), diffuse);
+        }
+
+        auto gatherObjects = [](std::vector<Shapes::Sphere> &spheres, std::vector<Shapes::Triangle> &triangles) {
+            std::vector<IHittable*> objects;
+            for (auto &sphere : spheres) {
+                objects.push_back(&sphere);
+            }
+            for (auto &triangle : triangles) {
+                objects.push_back(&triangle);
+            }
+            return objects;
+        };
+
+        Shapes::Sphere lightSphere(Math::Vector3f(2.f, 7.f, 2.f), 2.f, emissive);
+        std::vector<IHittable*> lightObjects = {&lightSphere};
+
+        BVH localBVH(gatherObjects(localSpheres, localTriangles));
+        BVH worldBVH(gatherObjects(worldSpheres, worldTriangles));
+        BVH lightBVH(lightObjects);
+
+        BLAS instance(&localBVH), placed(&worldBVH), light(&lightBVH);
+        instance.SetTransform(transform);
+
+        std::vector<BLAS*> instancedBLAS = {&instance, &light};
+        std::vector<BLAS*> placedBLAS = {&placed, &light};
+        TLAS instancedTLAS(instancedBLAS), placedTLAS(placedBLAS);
+
+        std::vector<Light> lights = {Light(&lightSphere, emissive)};
+        LightSampler lightSampler;
+        lightSampler.Build(lights);
+
+        scene.camera = Camera(width, height, {3.f, 6.f, 10.f}, {3.f, 0.f, -2.f}, 45.f);
+
+        std::cout << "Instance shading, " << width << "x" << height << ", " << samplesPerPixel << " spp\n";
+        std::cout << std::setw(12) << "integrator" << std::setw(20) << "rmse instance-world" << std::setw(18) << "rmse world-world" << "  (6x6 block means)" << '\n';
+
+        bool matches = true;
+        for (auto integrator : {Integrator::Megakernel, Integrator::Wavefront}) {
+            std::vector<std::uint32_t> instancedPixels, placedPixels, referencePixels;
+            RenderAccelerationStructure(scene, instancedTLAS, lightSampler, integrator, width, height, samplesPerPixel, instancedPixels);
+            RenderAccelerationStructure(scene, placedTLAS, lightSampler, integrator, width, height, samplesPerPixel, placedPixels);
+            RenderAccelerationStructure(scene, placedTLAS, lightSampler, integrator, width, height, samplesPerPixel, referencePixels);
+
+            double instanceError = ComputeBlockRMSE(instancedPixels, placedPixels, width, height, 6);
+            double noise = ComputeBlockRMSE(referencePixels, placedPixels, width, height, 6);
+
+            std::cout << std::fixed << std::setprecision(2)
+                      << std::setw(12) << (integrator == Integrator::Megakernel ? "megakernel" : "wavefront")
+                      << std::setw(20) << instanceError
+                      << std::setw(18) << noise << '\n';
+
+            // Same geometry differs by noise only, wrong space of shading point shows up as shifted lighting
+            matches &= instanceError <= 1.5 * noise + 1.0;
+        }
+
+        FreeMaterials(scene);
+
+        if (!matches) {
+            std::cerr << "Transformed instance shades differently than the same shapes placed in world space\n";
+            return -1;
+        }
+
+        return 0;
+    }
+
+    //! Traces all camera rays through TLAS in packets of ```Width``` neighbouring pixels. Returns nanoseconds per ray
+    template<int Width>
+    double TraceCameraPackets(const TLAS &tlas, std::span<const Ray> rays, std::vector<HitPayload> &payloads) noexcept {
+        int count = static_cast<int>(rays.size());
+        double time = Timer::MeasureInMillis([&]() {
+            for (int first = 0; first < count; first += Width) {
+                int packetCount = Math::Min(Width, count - first);
+                RayPacket<Width> packet(&rays[first], packetCount);
+
+                HitPayload lanePayloads[Width];
+                for (auto &payload : lanePayloads) {
+                    payload.t = Math::Constants::Infinity<float>;
+                    payload.hittable = nullptr;
+                }
+
+                int hitMask = tlas.Hit(packet, 0.01f, lanePayloads);
+                for (int lane = 0; lane < packetCount; ++lane) {
+                    payloads[first + lane] = lanePayloads[lane];
+                    payloads[first + lane].t = (hitMask >> lane & 1) ? lanePayloads[lane].t : -1.f;
+                }
+            }
+        });
+
+        return time * 1e6 / static_cast<double>(count);
+    }
+
+    //! Counts rays whose closest hit differs from reference
+    int CountMismatches(const TLAS &tlas, std::span<const Ray> rays, std::span<const HitPayload> reference, std::span<const HitPayload> payloads) noexcept {
+        // Neighbouring triangles tie on shared edges, so hits are compared by surface material instead of primitive
+        auto getMaterial = [&tlas](const Ray &ray, HitPayload payload) {
+            payload.hittable->ComputeSurfaceInteraction(tlas.GetInstance(payload.instanceId)->ToLocal(ray), payload);
+            return payload.material;
+        };
+
+        int mismatches = 0;
+        for (int i = 0; i < (int)reference.size(); ++i) {
+            bool bothMiss = reference[i].t < 0.f && payloads[i].t < 0.f;
+            bool sameHit = reference[i].t >= 0.f && payloads[i].t >= 0.f && Math::Abs(reference[i].t - payloads[i].t) <= 1e-4f * Math::Max(reference[i].t, 1.f) && getMaterial(rays[i], reference[i]) == getMaterial(rays[i], payloads[i]);
+            mismatches += bothMiss || sameHit ? 0 : 1;
+        }
+
+        return mismatches;
+    }
+
+    //! Compares single camera rays with 4 and 8 wide packets, first on TLAS alone and then in one bounce render of every scene in ```assets```
+    int RunPacketBenchmark(int samplesPerPixel) noexcept {
+        constexpr int width = 640, height = 360;
+
+        std::cout << "Camera ray packets, " << width << "x" << height << ", ns per ray on TLAS | ms per frame of 1 bounce render, " << samplesPerPixel << " spp\n";
+        std::cout << std::setw(28) << "scene" << std::setw(10) << "single" << std::setw(10) << "x4" << std::setw(10) << "x8" << std::setw(12) << "mismatch" << " |" << std::setw(10) << "single" << std::setw(10) << "x4" << std::setw(10) << "x8" << '\n';
+
+        for (const auto &scenePath : ListScenes()) {
+            Scene scene;
+            if (!LoadScene(scenePath, width, height, scene)) {
+                continue;
+            }
+
+            SceneGeometry sceneGeometry;
+            sceneGeometry.UpdateObjects(scene);
+            sceneGeometry.UpdateLights(scene);
+            sceneGeometry.UpdateTLAS(scene);
+
+            const TLAS *tlas = sceneGeometry.GetAccelerationStructure();
+            if (tlas == nullptr) {
+                std::cerr << "Skipping scene without objects: " << scenePath << '\n';
+                continue;
+            }
+
+            scene.camera.ComputeRayDirections();
+            std::vector<Ray> rays(width * height);
+            for (int i = 0; i < width * height; ++i) {
+                rays[i].origin = scene.camera.GetPosition();
+                rays[i].direction = scene.camera.GetRayDirections()[i];
+                rays[i].inverseDirection = 1.f / rays[i].direction;
+                rays[i].opticalDensity = 1.f;
+            }
+
+            std::vector<HitPayload> reference(rays.size()), payloads4(rays.size()), payloads8(rays.size());
+            double singleTime = Timer::MeasureInMillis([&]() {
+                for (int i = 0; i < (int)rays.size(); ++i) {
+                    reference[i].t = Math::Constants::Infinity<float>;
+                    reference[i].hittable = nullptr;
+                    if (!tlas->Hit(rays[i], 0.01f, Math::Constants::Infinity<float>, reference[i])) {
+                        reference[i].t = -1.f;
+                    }
+                }
+            }) * 1e6 / static_cast<double>(rays.size());
+
+            double packet4Time = TraceCameraPackets<4>(*tlas, rays, payloads4);
+            double packet8Time = TraceCameraPackets<8>(*tlas, rays, payloads8);
+            int mismatches = CountMismatches(*tlas, rays, reference, payloads4) + CountMismatches(*tlas, rays, reference, payloads8);
+
+            std::cout << std::fixed << std::setprecision(1)
+                      << std::setw(28) << scenePath.filename().string()
+                      << std::setw(10) << singleTime
+                      << std::setw(10) << packet4Time
+                      << std::setw(10) << packet8Time
+                      << std::setw(12) << mismatches << " |";
+
+            for (int packetWidth : {1, 4, 8}) {
+                Renderer renderer(width, height);
+                renderer.SetUsedThreadCount(renderer.GetAvailableThreadCount());
+                renderer.Accumulate() = true;
+                renderer.Accelerate() = true;
+                renderer.RayDepth() = 2;
+                renderer.SetPacketWidth(packetWidth);
+
+                double time = Timer::MeasureInMillis([&]() {
+                    for (int sample = 0; sample < samplesPerPixel; ++sample) {
+                        scene.camera.ComputeRayDirections();
+                        renderer.Render(scene.camera, tlas, sceneGeometry.GetLightSampler(), scene.materials);
+                    }
+                });
+
+                std::cout << std::setw(10) << time / samplesPerPixel;
+            }
+            std::cout << '\n';
+
+            if (mismatches != 0) {
+                std::cerr << "Packet hits differ from single rays in " << scenePath << '\n';
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    //! Traces current camera rays of ```scene``` through single ```blas```. Returns nanoseconds per ray, hit distances are written to ```distances``` if given
+    double MeasureCameraRays(Scene &scene, BLAS *blas, std::vector<float> *distances = nullptr) noexcept {
+        std::vector<BLAS*> blasArray = {blas};
+        TLAS tlas(blasArray);
+
+        auto directions = scene.camera.GetRayDirections();
+        if (distances != nullptr) {
+            distances->clear();
+            distances->reserve(directions.size());
+        }
+
+        double time = Timer::MeasureInMillis([&]() {
+            for (const auto &direction : directions) {
+                Ray ray{};
+                ray.origin = scene.camera.GetPosition();
+                ray.direction = direction;
+                ray.inverseDirection = 1.f / ray.direction;
+
+                HitPayload payload;
+                payload.t = Math::Constants::Infinity<float>;
+                tlas.Hit(ray, 0.01f, Math::Constants::Infinity<float>, payload);
+
+                if (distances != nullptr) {
+                    distances->push_back(payload.t);
+                }
+            }
+        });
+
+        return time * 1e6 / static_cast<double>(directions.size());
+    }
+
+    //! Builds BVH of every model used by scenes in ```assets``` with sweep and binned SAH builders. Reports build time, SAH cost and camera ray cost
+    int RunBVHBenchmark() noexcept {
+        constexpr int width = 320, height = 180;
+
+        std::cout << "BVH builders, build time in ms, SAH cost, ns per camera ray at " << width << "x" << height << '\n';
+        std::cout << std::setw(36) << "model" << std::setw(10) << "faces" << std::setw(12) << "sweep ms" << std::setw(12) << "binned ms" << std::setw(12) << "sweep SAH" << std::setw(12) << "binned SAH" << std::setw(10) << "sweep ns" << std::setw(11) << "binned ns" << '\n';
+
+        std::vector<std::filesystem::path> measuredModels;
+        for (const auto &scenePath : ListScenes()) {
+            struct Measurement {
+                std::filesystem::path path;
+                int faceCount;
+                BVH::BuildStatistics statistics;
+                double rayTime;
+            };
+
+            std::vector<Measurement> measurements[2];
+            for (auto buildMethod : {BVHBuildMethod::SweepSAH, BVHBuildMethod::BinnedSAH}) {
+                AssetLoader::Instance().GetLoadingProperties().bvhBuildOptions.method = buildMethod;
+
+                Scene scene;
+                int firstModel = static_cast<int>(AssetLoader::Instance().GetModels().size());
+                if (!LoadScene(scenePath, width, height, scene)) {
+                    break;
+                }
+
+                auto models = AssetLoader::Instance().GetModels();
+                for (int i = 0; i < (int)scene.modelInstances.size() && firstModel + i < (int)models.size(); ++i) {
+                    const Model *model = models[firstModel + i];
+                    BLAS *blas = scene.modelInstances[i]->GetBLAS();
+
+                    int faceCount = 0;
+                    for (auto mesh : model->GetMeshes()) {
+                        faceCount += mesh->GetFaceCount();
+                    }
+
+                    scene.camera.ComputeRayDirections();
+                    measurements[static_cast<int>(buildMethod)].push_back({model->GetPathToFile(), faceCount, model->GetBVH()->GetBuildStatistics(), MeasureCameraRays(scene, blas)});
+                }
+            }
+
+            for (int i = 0; i < (int)Math::Min(measurements[0].size(), measurements[1].size()); ++i) {
+                const auto &sweep = measurements[0][i];
+                const auto &binned = measurements[1][i];
+                if (std::find(measuredModels.begin(), measuredModels.end(), sweep.path) != measuredModels.end()) {
+                    continue;
+                }
+                measuredModels.push_back(sweep.path);
+
+                std::cout << std::fixed << std::setprecision(1)
+                          << std::setw(36) << sweep.path.filename().string()
+                          << std::setw(10) << sweep.faceCount
+                          << std::setw(12) << sweep.statistics.buildTime
+                          << std::setw(12) << binned.statistics.buildTime
+                          << std::setw(12) << sweep.statistics.sahCost
+                          << std::setw(12) << binned.statistics.sahCost
+                          << std::setw(10) << sweep.rayTime
+                          << std::setw(11) << binned.rayTime << '\n';
+            }
+        }
+
+        return 0;
+    }
+
+    //! Builds BVH of every model used by scenes in ```assets``` with growing leaf size. Reports tree size, SAH cost and camera ray cost
+    int RunLeafSizeBenchmark() noexcept {
+        constexpr int width = 320, height = 180;
+        constexpr int leafSizes[] = {1, 2, 4, 8};
+
+        std::cout << "BVH leaf sizes, ns per camera ray at " << width << "x" << height << '\n';
+        std::cout << std::setw(36) << "model" << std::setw(10) << "faces" << std::setw(8) << "leaf" << std::setw(10) << "nodes" << std::setw(10) << "leaves" << std::setw(12) << "memory KB" << std::setw(10) << "SAH" << std::setw(8) << "depth" << std::setw(10) << "ray ns" << '\n';
+
+        std::vector<std::filesystem::path> measuredModels;
+        for (const auto &scenePath : ListScenes()) {
+            std::vector<std::filesystem::path> sceneModels;
+            for (int leafSize : leafSizes) {
+                AssetLoader::Instance().GetLoadingProperties().bvhBuildOptions.maxLeafSize = leafSize;
+
+                Scene scene;
+                int firstModel = static_cast<int>(AssetLoader::Instance().GetModels().size());
+                if (!LoadScene(scenePath, width, height, scene)) {
+                    break;
+                }
+
+                auto models = AssetLoader::Instance().GetModels();
+                for (int i = 0; i < (int)scene.modelInstances.size() && firstModel + i < (int)models.size(); ++i) {
+                    const Model *model = models[firstModel + i];
+                    if (std::find(measuredModels.begin(), measuredModels.end(), model->GetPathToFile()) != measuredModels.end()) {
+                        continue;
+                    }
+                    sceneModels.push_back(model->GetPathToFile());
+
+                    int faceCount = 0;
+                    for (auto mesh : model->GetMeshes()) {
+                        faceCount += mesh->GetFaceCount();
+                    }
+
+                    const auto &statistics = model->GetBVH()->GetBuildStatistics();
+                    scene.camera.ComputeRayDirections();
+                    double rayTime = MeasureCameraRays(scene, scene.modelInstances[i]->GetBLAS());
+
+                    std::cout << std::fixed << std::setprecision(1)
+                              << std::setw(36) << model->GetPathToFile().filename().string()
+                              << std::setw(10) << faceCount
+                              << std::setw(8) << leafSize
+                              << std::setw(10) << statistics.nodeCount
+                              << std::setw(10) << statistics.leafCount
+                              << std::setw(12) << static_cast<double>(statistics.memoryFootprint) / 1024.0
+                              << std::setw(10) << statistics.sahCost
+                              << std::setw(8) << statistics.depth
+                              << std::setw(10) << rayTime << '\n';
+                }
+            }
+
+            measuredModels.insert(measuredModels.end(), sceneModels.begin(), sceneModels.end());
+        }
+
+        AssetLoader::Instance().GetLoadingProperties().bvhBuildOptions = BVHBuildOptions();
+
+        return 0;
+    }
+
+    //! Builds BVH of every model used by scenes in ```assets``` with binned and spatial split builders. Reports references, SAH cost, nodes and hittables visited per camera ray and ray cost, checks that both trees find the same hits
+    int RunSpatialSplitBenchmark() noexcept {
+        constexpr int width = 320, height = 180;
+        constexpr int builderCount = 2;
+        constexpr BVHBuildMethod buildMethods[builderCount] = {BVHBuildMethod::BinnedSAH, BVHBuildMethod::SpatialSAH};
+        const char *builderNames[builderCount] = {"binned", "spatial"};
+
+        std::cout << "BVH spatial splits, traversal per camera ray at " << width << "x" << height << '\n';
+        std::cout << std::setw(36) << "model" << std::setw(10) << "faces" << std::setw(10) << "builder" << std::setw(10) << "refs" << std::setw(10) << "build ms"
+                  << std::setw(10) << "SAH" << std::setw(10) << "nodes" << std::setw(10) << "tests" << std::setw(10) << "ray ns" << '\n';
+
+        std::vector<std::filesystem::path> measuredModels;
+        for (const auto &scenePath : ListScenes()) {
+            Scene scenes[builderCount];
+            int firstModels[builderCount];
+            bool loaded = true;
+            for (int builder = 0; builder < builderCount && loaded; ++builder) {
+                AssetLoader::Instance().GetLoadingProperties().bvhBuildOptions.method = buildMethods[builder];
+
+                firstModels[builder] = static_cast<int>(AssetLoader::Instance().GetModels().size());
+                loaded = LoadScene(scenePath, width, height, scenes[builder]);
+            }
+
+            if (!loaded) {
+                continue;
+            }
+
+            // Camera jitters directions on every update, so both trees are traced with rays of first scene
+            scenes[0].camera.ComputeRayDirections();
+            auto directions = scenes[0].camera.GetRayDirections();
+
+            auto models = AssetLoader::Instance().GetModels();
+            for (int i = 0; i < (int)scenes[0].modelInstances.size() && firstModels[builderCount - 1] + i < (int)models.size(); ++i) {
+                const Model *model = models[firstModels[0] + i];
+                if (std::find(measuredModels.begin(), measuredModels.end(), model->GetPathToFile()) != measuredModels.end()) {
+                    continue;
+                }
+                measuredModels.push_back(model->GetPathToFile());
+
+                int faceCount = 0;
+                for (auto mesh : model->GetMeshes()) {
+                    faceCount += mesh->GetFaceCount();
+                }
+
+                int mismatches = 0;
+                std::vector<float> referenceDistances;
+                for (int builder = 0; builder < builderCount; ++builder) {
+                    const BLAS *blas = scenes[builder].modelInstances[i]->GetBLAS();
+
+                    std::vector<float> distances;
+                    double rayTime = MeasureCameraRays(scenes[0], scenes[builder].modelInstances[i]->GetBLAS(), &distances);
+
+                    if (builder == 0) {
+                        referenceDistances = std::move(distances);
+                    } else {
+                        for (int j = 0; j < (int)distances.size(); ++j) {
+                            mismatches += distances[j] != referenceDistances[j] ? 1 : 0;
+                        }
+                    }
+
+                    std::int64_t nodeCount = 0, hittableCount = 0;
+                    for (const auto &direction : directions) {
+                        Ray ray{};
+                        ray.origin = scenes[0].camera.GetPosition();
+                        ray.direction = direction;
+                        ray.inverseDirection = 1.f / ray.direction;
+
+                        auto traversal = blas->MeasureTraversal(ray, 0.01f, Math::Constants::Infinity<float>);
+                        nodeCount += traversal.nodeCount;
+                        hittableCount += traversal.hittableCount;
+                    }
+
+                    const auto &statistics = models[firstModels[builder] + i]->GetBVH()->GetBuildStatistics();
+                    double rayCount = static_cast<double>(directions.size());
+                    std::cout << std::fixed << std::setprecision(1)
+                              << std::setw(36) << (builder == 0 ? model->GetPathToFile().filename().string() : "")
+                              << std::setw(10) << faceCount
+                              << std::setw(10) << builderNames[builder]
+                              << std::setw(10) << statistics.referenceCount
+                              << std::setw(10) << statistics.buildTime
+                              << std::setw(10) << statistics.sahCost
+                              << std::setw(10) << static_cast<double>(nodeCount) / rayCount
+                              << std::setw(10) << static_cast<double>(hittableCount) / rayCount
+                              << std::setw(10) << rayTime << '\n';
+                }
+
+                if (mismatches != 0) {
+                    std::cerr << "Spatial split BVH finds different hits in " << model->GetPathToFile() << '\n';
+                    return -1;
+                }
+            }
+        }
+
+        AssetLoader::Instance().GetLoadingProperties().bvhBuildOptions = BVHBuildOptions();
+
+        return 0;
+    }
+
+    //! Traces camera rays through BVH of every model used by scenes in ```assets``` with binary, 4-wide and quantized 4-wide nodes. Reports memory and ray cost, checks that all layouts find the same hits
+    int RunLayoutBenchmark() noexcept {
+        constexpr int width = 320, height = 180;
+        constexpr int layoutCount = 3;
+        const char *layoutNames[layoutCount] = {"binary", "wide", "quantized"};
+
+        std::cout << "BVH node layouts, memory in KB and ns per camera ray at " << width << "x" << height << '\n';
+        std::cout << std::setw(36) << "model" << std::setw(10) << "faces";
+        for (const char *name : layoutNames) {
+            std::cout << std::setw(14) << std::string(name) + " KB" << std::setw(14) << std::string(name) + " ns";
+        }
+        std::cout << std::setw(10) << "mismatch" << '\n';
+
+        std::vector<std::filesystem::path> measuredModels;
+        for (const auto &scenePath : ListScenes()) {
+            Scene scenes[layoutCount];
+            int firstModels[layoutCount];
+            bool loaded = true;
+            for (int layout = 0; layout < layoutCount && loaded; ++layout) {
+                auto &options = AssetLoader::Instance().GetLoadingProperties().bvhBuildOptions;
+                options.wideNodes = layout == 1;
+                options.quantizedNodes = layout == 2;
+
+                firstModels[layout] = static_cast<int>(AssetLoader::Instance().GetModels().size());
+                loaded = LoadScene(scenePath, width, height, scenes[layout]);
+            }
+
+            if (!loaded) {
+                continue;
+            }
+
+            // Camera jitters directions on every update, so all trees are traced with rays of first scene
+            scenes[0].camera.ComputeRayDirections();
+
+            auto models = AssetLoader::Instance().GetModels();
+            for (int i = 0; i < (int)scenes[0].modelInstances.size() && firstModels[layoutCount - 1] + i < (int)models.size(); ++i) {
+                const Model *model = models[firstModels[0] + i];
+                if (std::find(measuredModels.begin(), measuredModels.end(), model->GetPathToFile()) != measuredModels.end()) {
+                    continue;
+                }
+                measuredModels.push_back(model->GetPathToFile());
+
+                int faceCount = 0;
+                for (auto mesh : model->GetMeshes()) {
+                    faceCount += mesh->GetFaceCount();
+                }
+
+                std::cout << std::fixed << std::setprecision(1) << std::setw(36) << model->GetPathToFile().filename().string() << std::setw(10) << faceCount;
+
+                int mismatches = 0;
+                std::vector<float> referenceDistances;
+                for (int layout = 0; layout < layoutCount; ++layout) {
+                    std::vector<float> distances;
+                    double rayTime = MeasureCameraRays(scenes[0], scenes[layout].modelInstances[i]->GetBLAS(), &distances);
+
+                    if (layout == 0) {
+                        referenceDistances = std::move(distances);
+                    } else {
+                        for (int j = 0; j < (int)distances.size(); ++j) {
+                            mismatches += distances[j] != referenceDistances[j] ? 1 : 0;
+                        }
+                    }
+
+                    const auto &statistics = models[firstModels[layout] + i]->GetBVH()->GetBuildStatistics();
+                    std::cout << std::setw(14) << static_cast<double>(statistics.memoryFootprint) / 1024.0 << std::setw(14) << rayTime;
+                }
+                std::cout << std::setw(10) << mismatches << '\n';
+
+                if (mismatches != 0) {
+                    std::cerr << "BVH node layouts find different hits in " << model->GetPathToFile() << '\n';
+                    return -1;
+                }
+            }
+        }
+
+        AssetLoader::Instance().GetLoadingProperties().bvhBuildOptions = BVHBuildOptions();
+
+        return 0;
+    }
+
+    //! Loads every scene in ```assets``` without BVH cache, with empty cache and with warm cache. Compares build with mapped load and checks that cached trees find the same hits
+    int RunCacheBenchmark() noexcept {
+        constexpr int width = 320, height = 180;
+        constexpr int passCount = 3;
+
+        auto &loadingProperties = AssetLoader::Instance().GetLoadingProperties();
+        std::filesystem::path cacheDirectory = std::filesystem::temp_directory_path() / "ptrace-bench-bvh-cache";
+        std::filesystem::remove_all(cacheDirectory);
+        loadingProperties.bvhCacheDirectory = cacheDirectory;
+
+        std::cout << "BVH cache, build and load time in ms, cache file size in KB\n";
+        std::cout << std::setw(36) << "model" << std::setw(10) << "faces" << std::setw(12) << "build ms" << std::setw(12) << "load ms" << std::setw(10) << "speedup" << std::setw(12) << "file KB" << std::setw(10) << "mismatch" << '\n';
+
+        int result = 0;
+        std::vector<std::filesystem::path> measuredModels;
+        for (const auto &scenePath : ListScenes()) {
+            Scene scenes[passCount];
+            int firstModels[passCount];
+            bool loaded = true;
+            for (int pass = 0; pass < passCount && loaded; ++pass) {
+                loadingProperties.cacheBVH = pass > 0;
+
+                firstModels[pass] = static_cast<int>(AssetLoader::Instance().GetModels().size());
+                loaded = LoadScene(scenePath, width, height, scenes[pass]);
+            }
+
+            if (!loaded) {
+                continue;
+            }
+
+            // Camera jitters directions on every update, so all trees are traced with rays of first scene
+            scenes[0].camera.ComputeRayDirections();
+
+            auto models = AssetLoader::Instance().GetModels();
+            for (int i = 0; i < (int)scenes[0].modelInstances.size() && firstModels[passCount - 1] + i < (int)models.size(); ++i) {
+                const Model *model = models[firstModels[0] + i];
+                if (std::find(measuredModels.begin(), measuredModels.end(), model->GetPathToFile()) != measuredModels.end()) {
+                    continue;
+                }
+                measuredModels.push_back(model->GetPathToFile());
+
+                int faceCount = 0;
+                for (auto mesh : model->GetMeshes()) {
+                    faceCount += mesh->GetFaceCount();
+                }
+
+                const auto &built = models[firstModels[0] + i]->GetBVH()->GetBuildStatistics();
+                const auto &cached = models[firstModels[passCount - 1] + i]->GetBVH()->GetBuildStatistics();
+
+                std::vector<float> builtDistances, cachedDistances;
+                MeasureCameraRays(scenes[0], scenes[0].modelInstances[i]->GetBLAS(), &builtDistances);
+                MeasureCameraRays(scenes[0], scenes[passCount - 1].modelInstances[i]->GetBLAS(), &cachedDistances);
+
+                int mismatches = 0;
+                for (int j = 0; j < (int)builtDistances.size(); ++j) {
+                    mismatches += builtDistances[j] != cachedDistances[j] ? 1 : 0;
+                }
+
+                std::error_code error;
+                std::filesystem::path fileName = model->GetPathToFile().filename();
+                fileName += ".bvh";
+                auto fileSize = std::filesystem::file_size(cacheDirectory / fileName, error);
+
+                std::cout << std::fixed << std::setprecision(1)
+                          << std::setw(36) << model->GetPathToFile().filename().string()
+                          << std::setw(10) << faceCount
+                          << std::setw(12) << built.buildTime
+                          << std::setw(12) << cached.buildTime
+                          << std::setw(10) << built.buildTime / cached.buildTime
+                          << std::setw(12) << (error ? 0.0 : static_cast<double>(fileSize) / 1024.0)
+                          << std::setw(10) << mismatches << '\n';
+
+                if (!cached.loadedFromCache || mismatches != 0) {
+                    std::cerr << "Cached BVH of " << model->GetPathToFile() << (cached.loadedFromCache ? " finds different hits" : " was not loaded from cache") << '\n';
+                    result = -1;
+                }
+            }
+        }
+
+        std::filesystem::remove_all(cacheDirectory);
+        loadingProperties.cacheBVH = false;
+        loadingProperties.bvhCacheDirectory.clear();
+
+        return result;
+    }
+
+    //! Builds binned BVH over ```primitiveCount``` random spheres with growing number of threads. Checks that every tree answers shadow rays the same
+    int RunBuildScalingBenchmark(int primitiveCount, int rayCount) noexcept {
+        std::mt19937 generator(1);
+        std::uniform_real_distribution<float> position(-50.f, 50.f);
+        std::uniform_real_distribution<float> radius(0.01f, 0.2f);
+
+        std::vector<Shapes::Sphere> spheres;
+        spheres.reserve(primitiveCount);
+        for (int i = 0; i < primitiveCount; ++i) {
+            spheres.emplace_back(Math::Vector3f(position(generator), position(generator), position(generator)), radius(generator), nullptr);
+        }
+
+        std::vector<IHittable*> objects;
+        objects.reserve(primitiveCount);
+        for (auto &sphere : spheres) {
+            objects.push_back(&sphere);
+        }
+
+        auto queries = GenerateShadowQueries(rayCount, generator);
+        std::vector<bool> reference;
+
+        int maxThreadCount = Math::Max(static_cast<int>(std::thread::hardware_concurrency()), 4);
+
+        std::cout << "Binned BVH build, " << primitiveCount << " spheres, " << std::thread::hardware_concurrency() << " hardware threads\n";
+        std::cout << std::setw(10) << "threads" << std::setw(12) << "build ms" << std::setw(10) << "speedup" << std::setw(10) << "SAH" << std::setw(8) << "depth" << '\n';
+
+        double serialTime = 0.0;
+        for (int threadCount = 1; threadCount <= maxThreadCount; threadCount *= 2) {
+            ThreadPool threadPool(threadCount);
+            BVHBuildOptions options;
+            options.parallelBuild = threadCount > 1;
+            options.threadPool = &threadPool;
+            BVH bvh(objects, options);
+            const auto &statistics = bvh.GetBuildStatistics();
+            if (threadCount == 1) {
+                serialTime = statistics.buildTime;
+            }
+
+            std::vector<bool> occluded(queries.size());
+            for (int i = 0; i < (int)queries.size(); ++i) {
+                occluded[i] = bvh.Occluded(queries[i].ray, 0.01f, queries[i].tMax);
+            }
+
+            if (reference.empty()) {
+                reference = occluded;
+            } else if (occluded != reference) {
+                std::cerr << "Tree built with " << threadCount << " threads answers shadow rays differently\n";
+                return -1;
+            }
+
+            std::cout << std::fixed << std::setprecision(1)
+                      << std::setw(10) << threadCount
+                      << std::setw(12) << statistics.buildTime
+                      << std::setw(10) << serialTime / statistics.buildTime
+                      << std::setw(10) << statistics.sahCost
+                      << std::setw(8) << statistics.depth << '\n';
+        }
+
+        return 0;
+    }
+
+    //! Builds BVH over ```primitiveCount``` random spheres with binned and linear builders. Reports build time, SAH cost and ray cost, and checks that all trees find the same hits
+    int RunLinearBuildBenchmark(int primitiveCount, int rayCount) noexcept {
+        std::mt19937 generator(1);
+        std::uniform_real_distribution<float> position(-50.f, 50.f);
+        std::uniform_real_distribution<float> radius(0.01f, 0.2f);
+
+        std::vector<Shapes::Sphere> spheres;
+        spheres.reserve(primitiveCount);
+        for (int i = 0; i < primitiveCount; ++i) {
+            spheres.emplace_back(Math::Vector3f(position(generator), position(generator), position(generator)), radius(generator), nullptr);
+        }
+
+        std::vector<IHittable*> objects;
+        objects.reserve(primitiveCount);
+        for (auto &sphere : spheres) {
+            objects.push_back(&sphere);
+        }
+
+        auto queries = GenerateShadowQueries(rayCount, generator);
+
+        constexpr int builderCount = 3;
+        const char *builderNames[builderCount] = {"binned", "linear", "linear+treelets"};
+
+        std::cout << "BVH builders, " << primitiveCount << " spheres, " << std::thread::hardware_concurrency() << " hardware threads\n";
+        std::cout << std::setw(16) << "builder" << std::setw(12) << "build ms" << std::setw(10) << "SAH" << std::setw(8) << "depth" << std::setw(10) << "hit ns" << std::setw(12) << "shadow ns" << std::setw(10) << "mismatch" << '\n';
+
+        std::vector<float> referenceDistances;
+        std::vector<bool> referenceOccluded;
+        for (int builder = 0; builder < builderCount; ++builder) {
+            BVHBuildOptions options;
+            options.method = builder == 0 ? BVHBuildMethod::BinnedSAH : BVHBuildMethod::LinearMorton;
+            options.optimizeTreelets = builder == 2;
+            BVH bvh(objects, options);
+
+            std::vector<float> distances(queries.size());
+            std::vector<bool> occluded(queries.size());
+            auto [hitTime, hitCount] = MeasureShadowRays(queries, [&bvh, &queries, &distances](const ShadowQuery &query) {
+                HitPayload payload;
+                payload.t = Math::Constants::Infinity<float>;
+                bool hit = bvh.Hit(query.ray, 0.01f, query.tMax, payload);
+                distances[&query - queries.data()] = hit ? payload.t : Math::Constants::Infinity<float>;
+                return hit;
+            });
+            auto [shadowTime, blocked] = MeasureShadowRays(queries, [&bvh, &queries, &occluded](const ShadowQuery &query) {
+                bool result = bvh.Occluded(query.ray, 0.01f, query.tMax);
+                occluded[&query - queries.data()] = result;
+                return result;
+            });
+
+            int mismatches = 0;
+            if (builder == 0) {
+                referenceDistances = std::move(distances);
+                referenceOccluded = std::move(occluded);
+            } else {
+                for (int i = 0; i < (int)queries.size(); ++i) {
+                    mismatches += distances[i] != referenceDistances[i] || occluded[i] != referenceOccluded[i] ? 1 : 0;
+                }
+            }
+
+            const auto &statistics = bvh.GetBuildStatistics();
+            std::cout << std::fixed << std::setprecision(1)
+                      << std::setw(16) << builderNames[builder]
+                      << std::setw(12) << statistics.buildTime
+                      << std::setw(10) << statistics.sahCost
+                      << std::setw(8) << statistics.depth
+                      << std::setw(10) << hitTime
+                      << std::setw(12) << shadowTime
+                      << std::setw(10) << mismatches << '\n';
+
+            if (mismatches != 0) {
+                std::cerr << "Tree of " << builderNames[builder] << " builder finds different hits\n";
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    //! Moves random spheres of built BVH by growing distances. Compares refit with full rebuild on time and SAH cost, and checks that both answer shadow rays the same
+    int RunRefitBenchmark(int primitiveCount, int rayCount) noexcept {
+        std::mt19937 generator(1);
+        std::uniform_real_distribution<float> position(-50.f, 50.f);
+        std::uniform_real_distribution<float> radius(0.01f, 0.2f);
+        std::uniform_real_distribution<float> direction(-1.f, 1.f);
+
+        std::vector<Shapes::Sphere> spheres;
+        spheres.reserve(primitiveCount);
+        for (int i = 0; i < primitiveCount; ++i) {
+            spheres.emplace_back(Math::Vector3f(position(generator), position(generator), position(generator)), radius(generator), nullptr);
+        }
+
+        std::vector<Math::Vector3f> centers;
+        std::vector<IHittable*> objects;
+        centers.reserve(primitiveCount);
+        objects.reserve(primitiveCount);
+        for (auto &sphere : spheres) {
+            centers.push_back(sphere.center);
+            objects.push_back(&sphere);
+        }
+
+        auto queries = GenerateShadowQueries(rayCount, generator);
+
+        BVH refitted(objects);
+        std::cout << "BVH refit, " << primitiveCount << " spheres, built in " << refitted.GetBuildStatistics().buildTime << "ms\n";
+        std::cout << std::setw(10) << "distance" << std::setw(12) << "refit ms" << std::setw(12) << "rebuild ms" << std::setw(12) << "refit SAH" << std::setw(12) << "rebuild SAH" << std::setw(14) << "degradation" << '\n';
+
+        constexpr float distances[] = {0.1f, 1.f, 5.f, 25.f};
+        for (float distance : distances) {
+            for (int i = 0; i < primitiveCount; ++i) {
+                spheres[i].center = centers[i] + Math::Vector3f(direction(generator), direction(generator), direction(generator)) * distance;
+            }
+
+            refitted.Refit();
+            BVH rebuilt(objects);
+
+            for (const auto &query : queries) {
+                if (refitted.Occluded(query.ray, 0.01f, query.tMax) != rebuilt.Occluded(query.ray, 0.01f, query.tMax)) {
+                    std::cerr << "Refitted tree answers shadow rays differently after moving spheres by " << distance << '\n';
+                    return -1;
+                }
+            }
+
+            std::cout << std::fixed << std::setprecision(2)
+                      << std::setw(10) << distance
+                      << std::setw(12) << refitted.GetBuildStatistics().refitTime
+                      << std::setw(12) << rebuilt.GetBuildStatistics().buildTime
+                      << std::setw(12) << refitted.GetBuildStatistics().sahCost
+                      << std::setw(12) << rebuilt.GetBuildStatistics().sahCost
+                      << std::setw(14) << refitted.GetSAHDegradation() << '\n';
+        }
+
+        return 0;
+    }
+
+    //! Returns true if ```tlas``` answers every shadow query like testing all ```instances``` one by one
+    bool MatchesInstances(const TLAS &tlas, std::span<const BLAS> instances, std::span<const ShadowQuery> queries) noexcept {
+        for (const auto &query : queries) {
+            bool occluded = std::any_of(instances.begin(), instances.end(), [&](const BLAS &instance) {
+                return instance.Occluded(query.ray, 0.01f, query.tMax, TraversalStack::Get(instance.GetBVH()->GetStackSize()));
+            });
+
+            if (occluded != tlas.Occluded(query.ray, 0.01f, query.tMax)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    //! Builds TLAS over growing number of randomly placed clones of one sphere cloud and reports SAH cost and shadow ray time. Then moves tenth of instances and compares in place update with rebuild
+    int RunTLASBenchmark(int rayCount) noexcept {
+        std::mt19937 generator(1);
+        std::uniform_real_distribution<float> unit(-1.f, 1.f);
+        std::uniform_real_distribution<float> position(-50.f, 50.f);
+        std::uniform_real_distribution<float> angle(-Math::Constants::Pi<float>, Math::Constants::Pi<float>);
+
+        std::vector<Shapes::Sphere> spheres;
+        for (int i = 0; i < 64; ++i) {
+            spheres.emplace_back(Math::Vector3f(unit(generator), unit(generator), unit(generator)), 0.1f, nullptr);
+        }
+
+        std::vector<IHittable*> objects;
+        for (auto &sphere : spheres) {
+            objects.push_back(&sphere);
+        }
+
+        BVH bvh(objects);
+        auto queries = GenerateShadowQueries(rayCount, generator);
+
+        auto randomTransform = [&]() {
+            Math::Vector3f translation(position(generator), position(generator), position(generator));
+            return Math::TranslationMatrix(translation) * Math::RotationMatrix(Math::Vector3f(angle(generator), angle(generator), angle(generator)));
+        };
+
+        std::cout << "TLAS over instances of " << spheres.size() << " spheres, tenth of instances moved before update\n";
+        std::cout << std::setw(10) << "instances" << std::setw(12) << "build ms" << std::setw(10) << "SAH" << std::setw(12) << "ns per ray"
+                  << std::setw(12) << "update ms" << std::setw(12) << "rebuild ms" << std::setw(12) << "update SAH" << std::setw(13) << "rebuild SAH" << '\n';
+
+        constexpr int instanceCounts[] = {16, 256, 4096};
+        for (int instanceCount : instanceCounts) {
+            std::vector<BLAS> instances;
+            instances.reserve(instanceCount);
+            for (int i = 0; i < instanceCount; ++i) {
+                instances.emplace_back(&bvh);
+                instances.back().SetTransform(randomTransform());
+            }
+
+            std::vector<BLAS*> blas;
+            for (auto &instance : instances) {
+                blas.push_back(&instance);
+            }
+
+            TLAS *tlas = nullptr;
+            double buildTime = Timer::MeasureInMillis([&]() {
+                tlas = new TLAS(blas);
+            });
+            float sahCost = tlas->ComputeSAHCost();
+
+            auto [time, blocked] = MeasureShadowRays(queries, [tlas](const ShadowQuery &query) {
+                return tlas->Occluded(query.ray, 0.01f, query.tMax);
+            });
+
+            if (!MatchesInstances(*tlas, instances, queries)) {
+                std::cerr << "TLAS over " << instanceCount << " instances answers shadow rays differently than instances alone\n";
+                delete tlas;
+                return -1;
+            }
+
+            std::vector<const BLAS*> moved;
+            for (int i = 0; i < instanceCount; i += 10) {
+                instances[i].SetTransform(randomTransform());
+                moved.push_back(&instances[i]);
+            }
+
+            double updateTime = Timer::MeasureInMillis([&]() {
+                tlas->Update(moved);
+            });
+
+            TLAS *rebuilt = nullptr;
+            double rebuildTime = Timer::MeasureInMillis([&]() {
+                rebuilt = new TLAS(blas);
+            });
+
+            bool matches = MatchesInstances(*tlas, instances, queries);
+
+            std::cout << std::fixed << std::setprecision(2)
+                      << std::setw(10) << instanceCount
+                      << std::setw(12) << buildTime
+                      << std::setw(10) << sahCost
+                      << std::setw(12) << time
+                      << std::setw(12) << updateTime
+                      << std::setw(12) << rebuildTime
+                      << std::setw(12) << tlas->ComputeSAHCost()
+                      << std::setw(13) << rebuilt->ComputeSAHCost() << '\n';
+
+            delete rebuilt;
+            delete tlas;
+
+            if (!matches) {
+                std::cerr << "Updated TLAS over " << instanceCount << " instances answers shadow rays differently than instances alone\n";
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    void PrintUsage() {
+        std::cerr << "Usage: ptrace-bench shadow [--rays N]\n"
+                  << "       ptrace-bench lights [--spp N]\n"
+                  << "       ptrace-bench integrators [--spp N]\n"
+                  << "       ptrace-bench instances [--spp N]\n"
+                  << "       ptrace-bench packets [--spp N]\n"
+                  << "       ptrace-bench bvh\n"
+                  << "       ptrace-bench leaves\n"
+                  << "       ptrace-bench layout\n"
+                  << "       ptrace-bench cache\n"
+                  << "       ptrace-bench spatial\n"
+                  << "       ptrace-bench build [--primitives N] [--rays N]\n"
+                  << "       ptrace-bench linear [--primitives N] [--rays N]\n"
+                  << "       ptrace-bench refit [--primitives N] [--rays N]\n"
+                  << "       ptrace-bench tlas [--rays N]\n";
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        PrintUsage();
+        return -1;
+    }
+
+    std::string_view command = argv[1];
+
+    int rayCount = 100000;
+    int samplesPerPixel = 4;
+    int primitiveCount = 1000000;
+    for (int i = 2; i < argc; ++i) {
+        std::string_view argument = argv[i];
+        if (argument == "--rays" && i + 1 < argc) {
+            rayCount = atoi(argv[++i]);
+        } else if (argument == "--spp" && i + 1 < argc) {
+            samplesPerPixel = atoi(argv[++i]);
+        } else if (argument == "--primitives" && i + 1 < argc) {
+            primitiveCount = atoi(argv[++i]);
+        } else {
+            PrintUsage();
+            return -1;
+        }
+    }
+
+    if (rayCount <= 0 || samplesPerPixel <= 0 || primitiveCount <= 0) {
+        PrintUsage();
+        return -1;
+    }
+
+    // Benchmarks measure builds, only cache benchmark turns BVH cache on
+    AssetLoader::Instance().GetLoadingProperties().cacheBVH = false;
+
+    if (command == "shadow") {
+        return RunShadowBenchmark(rayCount);
+    }
+
+    if (command == "lights") {
+        return RunLightBenchmark(samplesPerPixel);
+    }
+
+    if (command == "integrators") {
+        return RunIntegratorBenchmark(samplesPerPixel);
+    }
+
+    if (command == "instances") {
+        return RunInstanceBenchmark(samplesPerPixel);
+    }
+
+    if (command == "packets") {
+        return RunPacketBenchmark(samplesPerPixel);
+    }
+
+    if (command == "bvh") {
+        return RunBVHBenchmark();
+    }
+
+    if (command == "leaves") {
+        return RunLeafSizeBenchmark();
+    }
+
+    if (command == "layout") {
+        return RunLayoutBenchmark();
+    }
+
+    if (command == "cache") {
+        return RunCacheBenchmark();
+    }
+
+    if (command == "build") {
+        return RunBuildScalingBenchmark(primitiveCount, rayCount);
+    }
+
+    if (command == "linear") {
+        return RunLinearBuildBenchmark(primitiveCount, rayCount);
+    }
+
+    if (command == "spatial") {
+        return RunSpatialSplitBenchmark();
+    }
+
+    if (command == "refit") {
+        return RunRefitBenchmark(primitiveCount, rayCount);
+    }
+
+    if (command == "tlas") {
+        return RunTLASBenchmark(rayCount);
+    }
+
+    PrintUsage();
+    return -1;
+}
@@ -0,0 +1,220 @@
+#include "Scene.h"
+#include "SceneGeometry.h"
+#include "Renderer.h"
+#include "Timer.h"
+#include "image/ImageSaver.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+namespace {
+    //! Options of offline render passed through command line
+    struct Options {
+        std::string scenePath;
+        std::string outputPath;
+        int samplesPerPixel = 64;
+        int threadCount = 0;
+        int width = 1280, height = 720;
+        int rayDepth = 5;
+        float gamma = 2.f;
+        bool accelerate = true;
+        float targetNoise = 0.f;
+        Integrator integrator = Integrator::Megakernel;
+        int packetWidth = 4;
+        BVHBuildOptions bvhBuildOptions;
+        bool cacheBVH = true;
+        std::string bvhCacheDirectory;
+        LightSamplingStrategy lightSampling = LightSamplingStrategy::BVH;
+    };
+
+    void PrintUsage() {
+        std::cerr << "Usage: ptrace-cli <scene.scn> <output.png> [--spp N] [--threads N] [--width W] [--height H] [--depth D] [--gamma G] [--target-noise E] [--integrator megakernel|wavefront] [--packet-width 1|4|8] [--bvh-builder sweep|binned|spatial|linear] [--bvh-leaf-size N] [--light-sampling all|power|bvh] [--no-wide-bvh] [--quantized-bvh] [--no-treelets] [--no-bvh-cache] [--bvh-cache-dir DIR] [--no-accelerate]\n";
+    }
+
+    bool ParseOptions(int argc, char **argv, Options &options) {
+        if (argc < 3) {
+            return false;
+        }
+
+        options.scenePath = argv[1];
+        options.outputPath = argv[2];
+
+        for (int i = 3; i < argc; ++i) {
+            std::string_view argument = argv[i];
+
+            if (argument == "--no-accelerate") {
+                options.accelerate = false;
+                continue;
+            }
+
+            if (argument == "--no-wide-bvh") {
+                options.bvhBuildOptions.wideNodes = false;
+                continue;
+            }
+
+            if (argument == "--quantized-bvh") {
+                options.bvhBuildOptions.quantizedNodes = true;
+                continue;
+            }
+
+            if (argument == "--no-treelets") {
+                options.bvhBuildOptions.optimizeTreelets = false;
+                continue;
+            }
+
+            if (argument == "--no-bvh-cache") {
+                options.cacheBVH = false;
+                continue;
+            }
+
+            if (i + 1 >= argc) {
+                return false;
+            }
+
+            const char *value = argv[++i];
+            if (argument == "--spp") {
+                options.samplesPerPixel = atoi(value);
+            } else if (argument == "--threads") {
+                options.threadCount = atoi(value);
+            } else if (argument == "--width") {
+                options.width = atoi(value);
+            } else if (argument == "--height") {
+                options.height = atoi(value);
+            } else if (argument == "--depth") {
+                options.rayDepth = atoi(value);
+            } else if (argument == "--gamma") {
+                options.gamma = static_cast<float>(atof(value));
+            } else if (argument == "--target-noise") {
+                options.targetNoise = static_cast<float>(atof(value));
+            } else if (argument == "--integrator") {
+                std::string_view integrator = value;
+                if (integrator == "megakernel") {
+                    options.integrator = Integrator::Megakernel;
+                } else if (integrator == "wavefront") {
+                    options.integrator = Integrator::Wavefront;
+                } else {
+                    return false;
+                }
+            } else if (argument == "--packet-width") {
+                options.packetWidth = atoi(value);
+                if (options.packetWidth != 1 && options.packetWidth != 4 && options.packetWidth != 8) {
+                    return false;
+                }
+            } else if (argument == "--bvh-builder") {
+                std::string_view builder = value;
+                if (builder == "sweep") {
+                    options.bvhBuildOptions.method = BVHBuildMethod::SweepSAH;
+                } else if (builder == "binned") {
+                    options.bvhBuildOptions.method = BVHBuildMethod::BinnedSAH;
+                } else if (builder == "spatial") {
+                    options.bvhBuildOptions.method = BVHBuildMethod::SpatialSAH;
+                } else if (builder == "linear") {
+                    options.bvhBuildOptions.method = BVHBuildMethod::LinearMorton;
+                } else {
+                    return false;
+                }
+            } else if (argument == "--bvh-leaf-size") {
+                options.bvhBuildOptions.maxLeafSize = atoi(value);
+                if (options.bvhBuildOptions.maxLeafSize <= 0) {
+                    return false;
+                }
+            } else if (argument == "--bvh-cache-dir") {
+                options.bvhCacheDirectory = value;
+            } else if (argument == "--light-sampling") {
+                std::string_view strategy = value;
+                if (strategy == "all") {
+                    options.lightSampling = LightSamplingStrategy::All;
+                } else if (strategy == "power") {
+                    options.lightSampling = LightSamplingStrategy::Power;
+                } else if (strategy == "bvh") {
+                    options.lightSampling = LightSamplingStrategy::BVH;
+                } else {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+        }
+
+        return options.samplesPerPixel > 0 && options.width > 0 && options.height > 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return -1;
+    }
+
+    auto &loadingProperties = AssetLoader::Instance().GetLoadingProperties();
+    loadingProperties.bvhBuildOptions = options.bvhBuildOptions;
+    loadingProperties.cacheBVH = options.cacheBVH;
+    loadingProperties.bvhCacheDirectory = options.bvhCacheDirectory;
+
+    Scene scene;
+    scene.camera = Camera(options.width, options.height);
+
+    std::ifstream fileStream(options.scenePath, std::ios::binary);
+    if (!fileStream) {
+        std::cerr << "Failed to open file: " << options.scenePath << '\n';
+        return -1;
+    }
+
+    auto error = scene.Deserialize(fileStream);
+    if (error.has_value()) {
+        std::cerr << "Failed to deserialize scene: " << options.scenePath << '\n';
+        return -1;
+    }
+
+    SceneGeometry sceneGeometry;
+    sceneGeometry.UpdateObjects(scene);
+    sceneGeometry.UpdateLights(scene);
+    sceneGeometry.UpdateTLAS(scene);
+    sceneGeometry.GetLightSampler().SetStrategy(options.lightSampling);
+
+    Renderer renderer(options.width, options.height);
+    renderer.SetUsedThreadCount(options.threadCount > 0 ? options.threadCount : renderer.GetAvailableThreadCount());
+    renderer.Accumulate() = true;
+    renderer.Accelerate() = options.accelerate;
+    renderer.RayDepth() = options.rayDepth;
+    renderer.Gamma() = options.gamma;
+    renderer.SetIntegrator(options.integrator);
+    renderer.SetPacketWidth(options.packetWidth);
+    if (options.targetNoise > 0.f) {
+        renderer.Adaptive() = true;
+        renderer.TargetNoise() = options.targetNoise;
+    }
+
+    std::cout << "Rendering " << options.scenePath << " at " << options.width << "x" << options.height << ", " << options.samplesPerPixel << " spp, " << renderer.GetUsedThreadCount() << " threads\n";
+
+    int frameCount = 0;
+    double renderTime = Timer::MeasureInMillis([&]() {
+        for (; frameCount < options.samplesPerPixel; ++frameCount) {
+            if (renderer.Adaptive() && renderer.IsConverged()) {
+                break;
+            }
+
+            scene.camera.ComputeRayDirections();
+
+            if (renderer.Accelerate()) {
+                renderer.Render(scene.camera, sceneGeometry.GetAccelerationStructure(), sceneGeometry.GetLightSampler(), scene.materials);
+            } else {
+                renderer.Render(scene.camera, sceneGeometry.GetObjects(), sceneGeometry.GetLightSampler(), scene.materials);
+            }
+        }
+    });
+
+    double samples = static_cast<double>(renderer.GetSampleCount());
+    std::cout << "Render time: " << renderTime << "ms, " << frameCount << " frames, " << samples / (renderTime * 1000.0) << " Msamples/s\n";
+    if (options.targetNoise > 0.f) {
+        std::cout << "Noise level: " << renderer.GetNoiseLevel() << ", converged pixels: " << renderer.GetConvergedPixelCount() << '\n';
+    }
+
+    ImageSaver(renderer.GetImage()).Save(options.outputPath);
+    std::cout << "Saved image: " << options.outputPath << '\n';
+
+    return 0;
+}
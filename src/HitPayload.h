@@ -5,13 +5,18 @@
 #include "Material.h"
 #include "Ray.h"
 
-//! Holds information about ray-surface interaction
+class IHittable;
+
+//! Holds information about ray-surface interaction. Traversal records distance, hittable and barycentrics, the rest is filled for the closest hit by IHittable::ComputeSurfaceInteraction
 struct HitPayload {
     float t;
+    const IHittable *hittable;
+    //! Weights of second and third triangle vertices at hit point
+    Math::Vector2f barycentrics;
     Math::Vector3f normal;
     Math::Vector2f texcoord;
-    Ray localRay;
-    Math::Matrix4f transform;
+    //! TLAS instance that was hit, its transform is looked up only for the closest hit. -1 if hittable lies in world space
+    int instanceId;
     const Material *material;
 };
 
@@ -2,26 +2,45 @@
 #define _LIGHT_H
 
 #include "hittable/IHittable.h"
+#include "Utilities.hpp"
 
 //! Class that samples lights directly
 class Light {
 public:
-    constexpr Light(const IHittable *object) noexcept :
-        m_Object(object) {}
+    inline Light(const IHittable *object, const Material *material) noexcept :
+        m_Object(object), m_Material(material) {
+        UpdatePower();
+    }
+
+    //! Recomputes power estimate after ```object``` was resized
+    inline void UpdatePower() noexcept {
+        m_Power = Utilities::Luminance(m_Material->GetEmission({0.5f, 0.5f})) * m_Object->GetSurfaceArea();
+    }
 
     //! Return pointer to ```object``` that light holds
     const IHittable* GetObject() const noexcept {
         return m_Object;
     }
 
-    //! Returns color sample using direct light sampling method
-    Math::Vector3f Sample(const Ray &lightRay, const HitPayload &objectHitPayload, const HitPayload &lightHitPayload, float distance, float distanceSquared) const noexcept {
-        constexpr float distanceEpsilon = 0.01f;
-        if (Math::Abs(lightHitPayload.t - distance) > distanceEpsilon) {
+    //! Returns emitted power estimate: emission luminance times surface area
+    constexpr float GetPower() const noexcept {
+        return m_Power;
+    }
+
+    //! Distance to sampled point within which the light surface is searched. Shadow rays should stop this far before the light
+    constexpr static float DistanceEpsilon = 0.01f;
+
+    //! Returns color sample using direct light sampling method. Visibility of the sampled point must be checked by caller
+    Math::Vector3f Sample(const Ray &lightRay, const HitPayload &objectHitPayload, float distance, float distanceSquared) const noexcept {
+        HitPayload lightHitPayload;
+        lightHitPayload.t = Math::Constants::Infinity<float>;
+        lightHitPayload.texcoord = Math::Vector2f(0.f);
+        if (!m_Object->Hit(lightRay, distance - DistanceEpsilon, distance + DistanceEpsilon, lightHitPayload)) {
             return Math::Vector3f(0.f);
         }
+        lightHitPayload.hittable->ComputeSurfaceInteraction(lightRay, lightHitPayload);
 
-        float pdf = distanceSquared / (Math::Dot(lightHitPayload.normal, -lightRay.direction) * m_Object->GetSurfaceArea());
+        float pdf = distanceSquared / (Math::Abs(Math::Dot(lightHitPayload.normal, lightRay.direction)) * m_Object->GetSurfaceArea());
 
         constexpr float pdfEpsilon = 0.01f;
         if (pdf <= pdfEpsilon) {
@@ -35,6 +54,8 @@ public:
 
 private:
     const IHittable *m_Object;
+    const Material *m_Material;
+    float m_Power;
 };
 
 #endif
@@ -2,25 +2,36 @@
 #include "Utilities.hpp"
 #include "sampling/BSDF.h"
 
-#include <vector>
 #include <thread>
-#include <cstring>
+#include <chrono>
+#include <algorithm>
 
 Renderer::Renderer(int width, int height) noexcept :
     m_Width(width), m_Height(height),
     m_Image(new Image(m_Width, m_Height)),
-    m_AccumulationData(new Math::Vector4f[m_Width * m_Height]),
-    m_AvailableThreads(std::thread::hardware_concurrency()),
+    m_AvailableThreads(Math::Max(static_cast<int>(std::thread::hardware_concurrency()), 1)),
     m_UsedThreads(1),
-    m_LinesPerThread(height) {}
+    m_ThreadPool(new ThreadPool(m_UsedThreads)),
+    m_AccumulationData(new Math::Vector4f[m_Width * m_Height]),
+    m_LuminanceSquaredData(new float[m_Width * m_Height]),
+    m_ConvergedMask(new std::uint8_t[m_Width * m_Height]) {}
 
 Renderer::~Renderer() noexcept {
+    if (m_ThreadPool != nullptr) {
+        delete m_ThreadPool;
+    }
     if (m_Image != nullptr) {
         delete m_Image;
     }
     if (m_AccumulationData != nullptr) {
         delete[] m_AccumulationData;
     }
+    if (m_LuminanceSquaredData != nullptr) {
+        delete[] m_LuminanceSquaredData;
+    }
+    if (m_ConvergedMask != nullptr) {
+        delete[] m_ConvergedMask;
+    }
 }
 
 void Renderer::OnResize(int width, int height) noexcept {
@@ -36,15 +47,25 @@ void Renderer::OnResize(int width, int height) noexcept {
         m_Image = new Image(m_Width, m_Height);
     }
     if (m_AccumulationData != nullptr) {
-        delete m_AccumulationData;
+        delete[] m_AccumulationData;
         m_AccumulationData = new Math::Vector4f[m_Width * m_Height];
     }
+    if (m_LuminanceSquaredData != nullptr) {
+        delete[] m_LuminanceSquaredData;
+        m_LuminanceSquaredData = new float[m_Width * m_Height];
+    }
+    if (m_ConvergedMask != nullptr) {
+        delete[] m_ConvergedMask;
+        m_ConvergedMask = new std::uint8_t[m_Width * m_Height];
+    }
+
+    m_FrameIndex = 1;
 }
 
-void Renderer::Render(const Camera &camera, std::span<IHittable* const> objects, std::span<const Light> lightSources, std::span<const Material> materials) noexcept {
+void Renderer::Render(const Camera &camera, std::span<IHittable* const> objects, const LightSampler &lightSampler, std::span<const Material> materials) noexcept {
     m_Camera = &camera;
     m_Objects = objects;
-    m_LightSources = lightSources;
+    m_LightSampler = &lightSampler;
     m_Materials = materials;
 
     if (!m_Accumulate) {
@@ -52,50 +73,16 @@ void Renderer::Render(const Camera &camera, std::span<IHittable* const> objects,
     }
 
     if (m_FrameIndex == 1) {
-        memset(m_AccumulationData, 0, m_Width * m_Height * sizeof(Math::Vector4f));
-    }
-
-    float inverseFrameIndex = 1.f / m_FrameIndex;
-    float inverseGamma = 1.f / m_Gamma;
-
-    std::vector<std::thread> handles;
-    handles.reserve(m_UsedThreads);
-
-    for (int i = 0; i < m_Height; i += m_LinesPerThread) {
-        handles.emplace_back([this, i, inverseFrameIndex, inverseGamma]() {
-            int nextBlock = i + m_LinesPerThread;
-            int limit = Math::Min(nextBlock, m_Height);
-            for (int t = i; t < limit; ++t) {
-                for (int j = 0; j < m_Width; ++j) {
-                    m_AccumulationData[m_Width * t + j] += PixelProgram(t, j);
-
-                    Math::Vector4f color = m_AccumulationData[m_Width * t + j];
-
-                    color *= inverseFrameIndex;
-                    color = Utilities::CorrectGamma(color, inverseGamma);
-                    color = Math::Clamp(color, 0.f, 1.f);
-
-                    m_Image->SetPixel(m_Width * t + j, Utilities::ConvertColorToRGBA(color));
-                }
-            }
-        });
-    }
-
-    for (auto &handle : handles) {
-        handle.join();
+        ResetAccumulation();
     }
 
-    m_Image->Update();
-
-    if (m_Accumulate) {
-        ++m_FrameIndex;
-    }
+    RenderFrame(&Renderer::TraceRays, &Renderer::TraceRay, &Renderer::Occluded);
 }
 
-void Renderer::Render(const Camera &camera, const TLAS *accelerationStructure, std::span<const Light> lightSources, std::span<const Material> materials) noexcept {
+void Renderer::Render(const Camera &camera, const TLAS *accelerationStructure, const LightSampler &lightSampler, std::span<const Material> materials) noexcept {
     m_Camera = &camera;
     m_AccelerationStructure = accelerationStructure;
-    m_LightSources = lightSources;
+    m_LightSampler = &lightSampler;
     m_Materials = materials;
 
     if (!m_Accumulate) {
@@ -103,128 +90,245 @@ void Renderer::Render(const Camera &camera, const TLAS *accelerationStructure, s
     }
 
     if (m_FrameIndex == 1) {
-        memset(m_AccumulationData, 0, m_Width * m_Height * sizeof(Math::Vector4f));
+        ResetAccumulation();
     }
 
-    float inverseFrameIndex = 1.f / m_FrameIndex;
+    RenderFrame(&Renderer::AcceleratedTraceRays, &Renderer::AcceleratedTraceRay, &Renderer::AcceleratedOccluded);
+}
+
+void Renderer::ResetAccumulation() noexcept {
+    int pixelCount = m_Width * m_Height;
+    std::fill_n(m_AccumulationData, pixelCount, Math::Vector4f(0.f));
+    std::fill_n(m_LuminanceSquaredData, pixelCount, 0.f);
+    std::fill_n(m_ConvergedMask, pixelCount, std::uint8_t(0));
+
+    m_NoiseLevel = Math::Constants::Infinity<float>;
+    m_ConvergedPixelCount = 0;
+    m_SampleScale = 1.f;
+    m_SampleCount = 0;
+}
+
+void Renderer::RenderFrame(TraceBatchFunction tracePrimaryRays, TraceFunction traceRay, OccludedFunction occluded) noexcept {
     float inverseGamma = 1.f / m_Gamma;
 
-    std::vector<std::thread> handles;
-    handles.reserve(m_UsedThreads);
+    int threadCount = m_ThreadPool->GetThreadCount();
+    int focusX = m_FocusX < 0 ? m_Width / 2 : m_FocusX;
+    int focusY = m_FocusY < 0 ? m_Height / 2 : m_FocusY;
+    m_TileScheduler.Prepare(m_Width, m_Height, m_TileSize, threadCount, m_TileOrder, focusX, focusY);
 
-    for (int i = 0; i < m_Height; i += m_LinesPerThread) {
-        handles.emplace_back([this, i, inverseFrameIndex, inverseGamma]() {
-            int nextBlock = i + m_LinesPerThread;
-            int limit = Math::Min(nextBlock, m_Height);
-            for (int t = i; t < limit; ++t) {
-                for (int j = 0; j < m_Width; ++j) {
-                    m_AccumulationData[m_Width * t + j] += AcceleratedPixelProgram(t, j);
+    m_ThreadBusyTimes.assign(threadCount, 0.0);
+    m_ThreadIdleTimes.assign(threadCount, 0.0);
+    m_ThreadStatistics.assign(threadCount, AdaptiveStatistics());
+    m_WavefrontQueues.resize(threadCount);
 
-                    Math::Vector4f color = m_AccumulationData[m_Width * t + j];
+    auto frameStart = std::chrono::steady_clock::now();
 
-                    color *= inverseFrameIndex;
-                    color = Utilities::CorrectGamma(color, inverseGamma);
-                    color = Math::Clamp(color, 0.f, 1.f);
+    m_ThreadPool->Dispatch([this, tracePrimaryRays, traceRay, occluded, inverseGamma](int threadIndex) {
+        auto start = std::chrono::steady_clock::now();
 
-                    m_Image->SetPixel(m_Width * t + j, Utilities::ConvertColorToRGBA(color));
-                }
-            }
-        });
-    }
+        Tile tile;
+        while (m_TileScheduler.Next(threadIndex, tile)) {
+            RenderTile(tile, tracePrimaryRays, traceRay, occluded, inverseGamma, threadIndex);
+        }
 
-    for (auto &handle : handles) {
-        handle.join();
+        auto finish = std::chrono::steady_clock::now();
+        m_ThreadBusyTimes[threadIndex] = std::chrono::duration<double, std::milli>(finish - start).count();
+    });
+
+    m_ThreadPool->Wait();
+
+    double frameTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+    for (int i = 0; i < threadCount; ++i) {
+        m_ThreadIdleTimes[i] = Math::Max(frameTime - m_ThreadBusyTimes[i], 0.0);
     }
 
-    m_Image->Update();
+    UpdateAdaptiveStatistics();
 
     if (m_Accumulate) {
         ++m_FrameIndex;
     }
 }
 
-Math::Vector4f Renderer::PixelProgram(int i, int j) const noexcept {
-    Ray ray;
-    ray.origin = m_Camera->GetPosition();
-    ray.direction = m_Camera->GetRayDirections()[m_Width * i + j];
-    ray.inverseDirection = 1.f / ray.direction;
-    
-    ray.opticalDensity = 1.f;
+void Renderer::UpdateAdaptiveStatistics() noexcept {
+    AdaptiveStatistics total;
+    for (const auto &statistics : m_ThreadStatistics) {
+        total.errorSum += statistics.errorSum;
+        total.weightSum += statistics.weightSum;
+        total.convergedCount += statistics.convergedCount;
+        total.sampleCount += statistics.sampleCount;
+    }
 
-    Math::Vector3f light(0.f), throughput(1.f);
-    for (int i = 0; i < m_RayDepth; ++i) {
-        HitPayload payload = TraceRay(ray);
+    int pixelCount = m_Width * m_Height;
+    m_ConvergedPixelCount = total.convergedCount;
+    m_SampleCount += total.sampleCount;
 
-        std::swap(ray, payload.localRay);
+    // Converged pixels are counted with target noise, which is upper bound of their error. Estimate is unreliable before minimum number of samples and not measured without adaptive sampling
+    if (!(m_Adaptive && m_Accumulate) || m_FrameIndex < m_MinAdaptiveSamples) {
+        m_NoiseLevel = Math::Constants::Infinity<float>;
+    } else {
+        m_NoiseLevel = static_cast<float>((total.errorSum + static_cast<double>(m_TargetNoise) * total.convergedCount) / pixelCount);
+    }
 
-        if (payload.t < 0.f) {
-            light += throughput * m_OnRayMiss(ray);
-            break;
+    // Budget of next frame is one sample per pixel, spread over not converged pixels proportionally to their error
+    m_SampleScale = total.weightSum > 0.0 ? static_cast<float>(pixelCount / total.weightSum) : 1.f;
+}
+
+float Renderer::ComputeRelativeError(int index) const noexcept {
+    float sampleCount = m_AccumulationData[index].a;
+    if (sampleCount < 2.f) {
+        return Math::Constants::Infinity<float>;
+    }
+
+    Math::Vector4f sum = m_AccumulationData[index];
+    float mean = Utilities::Luminance({sum.r, sum.g, sum.b}) / sampleCount;
+    float meanSquared = m_LuminanceSquaredData[index] / sampleCount;
+    float varianceOfMean = Math::Max(meanSquared - mean * mean, 0.f) / (sampleCount - 1.f);
+
+    return Math::Sqrt(varianceOfMean) / (Math::Max(mean, 0.f) + 0.01f);
+}
+
+void Renderer::RenderTile(const Tile &tile, TraceBatchFunction tracePrimaryRays, TraceFunction traceRay, OccludedFunction occluded, float inverseGamma, int threadIndex) noexcept {
+    AdaptiveStatistics &statistics = m_ThreadStatistics[threadIndex];
+    WavefrontQueues &queues = m_WavefrontQueues[threadIndex];
+    bool adaptive = m_Adaptive && m_Accumulate;
+
+    if (adaptive) {
+        bool tileConverged = true;
+        for (int t = tile.y; t < tile.y + tile.height && tileConverged; ++t) {
+            for (int j = tile.x; j < tile.x + tile.width; ++j) {
+                if (!m_ConvergedMask[m_Width * t + j]) {
+                    tileConverged = false;
+                    break;
+                }
+            }
         }
 
-        const Material *material = payload.material;
-        auto emission = material->GetEmission(payload.texcoord);
-            
-        light += emission * throughput;
+        if (tileConverged) {
+            statistics.convergedCount += tile.width * tile.height;
+            return;
+        }
+    }
 
-        if (material->emissionPower > 0.f) {
-            break;
+    auto &sampleCounts = queues.sampleCounts;
+    sampleCounts.assign(tile.width * tile.height, 1);
+
+    if (adaptive) {
+        for (int t = tile.y; t < tile.y + tile.height; ++t) {
+            for (int j = tile.x; j < tile.x + tile.width; ++j) {
+                int index = m_Width * t + j;
+                int &sampleCount = sampleCounts[tile.width * (t - tile.y) + (j - tile.x)];
+
+                if (m_ConvergedMask[index]) {
+                    sampleCount = 0;
+                    ++statistics.convergedCount;
+                    continue;
+                }
+
+                if (m_AccumulationData[index].a >= static_cast<float>(m_MinAdaptiveSamples)) {
+                    float wantedSamples = ComputeRelativeError(index) / m_TargetNoise * m_SampleScale;
+                    sampleCount = static_cast<int>(Math::Min(wantedSamples + Utilities::RandomFloatInZeroToOne(), static_cast<float>(m_MaxSamplesPerFrame)));
+                    sampleCount = Math::Clamp(sampleCount, 1, m_MaxSamplesPerFrame);
+                }
+            }
+        }
+    }
+
+    if (m_Integrator == Integrator::Wavefront) {
+        RenderTileWavefront(tile, tracePrimaryRays, traceRay, occluded, queues);
+    } else {
+        Ray rays[PrimaryBatchSize];
+        HitPayload payloads[PrimaryBatchSize];
+        int pixelIndices[PrimaryBatchSize];
+        int batchCount = 0;
+
+        // Neighbouring camera rays are intersected together, then every path continues on its own
+        auto traceBatch = [&]() {
+            (this->*tracePrimaryRays)({rays, static_cast<std::size_t>(batchCount)}, {payloads, static_cast<std::size_t>(batchCount)});
+            for (int k = 0; k < batchCount; ++k) {
+                AccumulateSample(pixelIndices[k], TracePath(rays[k], payloads[k], traceRay, occluded));
+            }
+            batchCount = 0;
+        };
+
+        for (int t = tile.y; t < tile.y + tile.height; ++t) {
+            for (int j = tile.x; j < tile.x + tile.width; ++j) {
+                int index = m_Width * t + j;
+                int sampleCount = sampleCounts[tile.width * (t - tile.y) + (j - tile.x)];
+
+                for (int s = 0; s < sampleCount; ++s) {
+                    rays[batchCount] = GetPrimaryRay(index);
+                    pixelIndices[batchCount++] = index;
+                    if (batchCount == PrimaryBatchSize) {
+                        traceBatch();
+                    }
+                }
+            }
         }
 
-        auto hitPoint = ray.origin + ray.direction * payload.t;
-        for (auto lightSource : m_LightSources) {
-            auto pointOnLight = lightSource.GetObject()->SampleUniform({Utilities::RandomFloatInZeroToOne(), Utilities::RandomFloatInZeroToOne()});
-            
-            auto toLight = pointOnLight - hitPoint;
-            float distanceSquared = Math::Dot(toLight, toLight);
-            float distance = Math::Sqrt(distanceSquared);
-            
-            Ray lightRay;
-            lightRay.origin = hitPoint;
-            lightRay.direction = toLight / distance;
-            lightRay.inverseDirection = 1.f / lightRay.direction;
-
-            HitPayload lightHitPayload = TraceRay(lightRay);
-            
-            light += throughput * lightSource.Sample(lightRay, payload, lightHitPayload, distance, distanceSquared);
+        if (batchCount > 0) {
+            traceBatch();
         }
+    }
 
-        BSDF bsdf(material);
-        auto direction = bsdf.Sample(ray, payload, throughput);
+    for (int t = tile.y; t < tile.y + tile.height; ++t) {
+        for (int j = tile.x; j < tile.x + tile.width; ++j) {
+            int index = m_Width * t + j;
+            int sampleCount = sampleCounts[tile.width * (t - tile.y) + (j - tile.x)];
+            if (sampleCount == 0) {
+                continue;
+            }
 
-        ray.origin = Math::TransformPoint(payload.transform, hitPoint);
-        ray.direction = Math::TransformVector(payload.transform, direction);
+            statistics.sampleCount += sampleCount;
 
-        // float p = Math::Max(throughput.x, Math::Max(throughput.y, throughput.z));
-        // if (Utilities::RandomFloatInZeroToOne() > p) {
-        //     break;
-        // }
+            Math::Vector4f color = m_AccumulationData[index];
 
-        // throughput *= 1 / p;
+            color *= 1.f / color.a;
+            color = Utilities::CorrectGamma(color, inverseGamma);
+            color = Math::Clamp(color, 0.f, 1.f);
 
-        // ray.origin = hitPoint;
-        // ray.direction = direction;
-        ray.inverseDirection = 1.f / ray.direction;
-        
-        // ray.opticalDensity = material->refractionIndex;
+            m_Image->SetPixel(index, Utilities::ConvertColorToRGBA(color));
+
+            if (!adaptive) {
+                continue;
+            }
+
+            float error = ComputeRelativeError(index);
+            if (m_AccumulationData[index].a >= static_cast<float>(m_MinAdaptiveSamples) && error <= m_TargetNoise) {
+                m_ConvergedMask[index] = 1;
+                ++statistics.convergedCount;
+                continue;
+            }
+
+            statistics.errorSum += error;
+            statistics.weightSum += Math::Min(error / m_TargetNoise, static_cast<float>(m_MaxSamplesPerFrame));
+        }
     }
- 
-    return {light.r, light.g, light.b, 1.f};
 }
 
-Math::Vector4f Renderer::AcceleratedPixelProgram(int i, int j) const noexcept {
+void Renderer::AccumulateSample(int index, const Math::Vector4f &sample) noexcept {
+    float luminance = Utilities::Luminance({sample.r, sample.g, sample.b});
+
+    m_AccumulationData[index] += sample;
+    m_LuminanceSquaredData[index] += luminance * luminance;
+}
+
+Ray Renderer::GetPrimaryRay(int index) const noexcept {
     Ray ray;
     ray.origin = m_Camera->GetPosition();
-    ray.direction = m_Camera->GetRayDirections()[m_Width * i + j];
+    ray.direction = m_Camera->GetRayDirections()[index];
     ray.inverseDirection = 1.f / ray.direction;
     
     ray.opticalDensity = 1.f;
 
+    return ray;
+}
+
+Math::Vector4f Renderer::TracePath(Ray ray, HitPayload payload, TraceFunction traceRay, OccludedFunction occluded) const noexcept {
     Math::Vector3f light(0.f), throughput(1.f);
     for (int i = 0; i < m_RayDepth; ++i) {
-        HitPayload payload = AcceleratedTraceRay(ray);
-
-        std::swap(ray, payload.localRay);
+        if (i > 0) {
+            payload = (this->*traceRay)(ray);
+        }
 
         if (payload.t < 0.f) {
             light += throughput * m_OnRayMiss(ray);
@@ -241,28 +345,13 @@ Math::Vector4f Renderer::AcceleratedPixelProgram(int i, int j) const noexcept {
         }
 
         auto hitPoint = ray.origin + ray.direction * payload.t;
-        for (auto lightSource : m_LightSources) {
-            auto pointOnLight = lightSource.GetObject()->SampleUniform({Utilities::RandomFloatInZeroToOne(), Utilities::RandomFloatInZeroToOne()});
-            
-            auto toLight = pointOnLight - hitPoint;
-            float distanceSquared = Math::Dot(toLight, toLight);
-            float distance = Math::Sqrt(distanceSquared);
-            
-            Ray lightRay;
-            lightRay.origin = hitPoint;
-            lightRay.direction = toLight / distance;
-            lightRay.inverseDirection = 1.f / lightRay.direction;
-
-            HitPayload lightHitPayload = TraceRay(lightRay);
-            
-            light += throughput * lightSource.Sample(lightRay, payload, lightHitPayload, distance, distanceSquared);
-        }
+        light += throughput * EstimateDirectLight(payload, hitPoint, occluded);
 
         BSDF bsdf(material);
         auto direction = bsdf.Sample(ray, payload, throughput);
 
-        ray.origin = Math::TransformPoint(payload.transform, hitPoint);
-        ray.direction = Math::TransformVector(payload.transform, direction);
+        ray.origin = hitPoint;
+        ray.direction = direction;
 
         // float p = Math::Max(throughput.x, Math::Max(throughput.y, throughput.z));
         // if (Utilities::RandomFloatInZeroToOne() > p) {
@@ -285,9 +374,9 @@ HitPayload Renderer::TraceRay(const Ray &ray) const noexcept {
     HitPayload payload;
     payload.t = Math::Constants::Infinity<float>;
     payload.normal = Math::Vector3f(0.f);
-    payload.localRay = ray;
-    payload.transform = Math::IdentityMatrix<float, 4>();
+    payload.instanceId = -1;
     payload.material = nullptr;
+    payload.hittable = nullptr;
 
     bool anyHit = false;
     int objectCount = (int)m_Objects.size();
@@ -299,28 +388,268 @@ HitPayload Renderer::TraceRay(const Ray &ray) const noexcept {
         return Miss(ray);
     }
 
-    payload.normal = Math::Dot(payload.localRay.direction, payload.normal) > Math::Constants::Epsilon<float> ? -payload.normal : payload.normal;
+    payload.hittable->ComputeSurfaceInteraction(ray, payload);
+    payload.normal = Math::Dot(ray.direction, payload.normal) > Math::Constants::Epsilon<float> ? -payload.normal : payload.normal;
 
     return payload;
 }
 
+void Renderer::TraceRays(std::span<const Ray> rays, std::span<HitPayload> payloads) const noexcept {
+    for (int i = 0; i < (int)rays.size(); ++i) {
+        payloads[i] = TraceRay(rays[i]);
+    }
+}
+
+template<typename F>
+void Renderer::GenerateShadowRays(const HitPayload &payload, const Math::Vector3f &hitPoint, F &&onShadowRay) const noexcept {
+    ShadowRay shadowRay;
+
+    if (m_LightSampler->GetStrategy() == LightSamplingStrategy::All) {
+        for (const auto &lightSource : m_LightSampler->GetLights()) {
+            if (SampleLight(lightSource, payload, hitPoint, 1.f, shadowRay)) {
+                onShadowRay(shadowRay);
+            }
+        }
+
+        return;
+    }
+
+    float pdf;
+    const Light *lightSource = m_LightSampler->Sample(hitPoint, Utilities::RandomFloatInZeroToOne(), pdf);
+    if (lightSource == nullptr || pdf <= 0.f) {
+        return;
+    }
+
+    if (SampleLight(*lightSource, payload, hitPoint, pdf, shadowRay)) {
+        onShadowRay(shadowRay);
+    }
+}
+
+Math::Vector3f Renderer::EstimateDirectLight(const HitPayload &payload, const Math::Vector3f &hitPoint, OccludedFunction occluded) const noexcept {
+    Math::Vector3f light(0.f);
+    GenerateShadowRays(payload, hitPoint, [this, occluded, &light](const ShadowRay &shadowRay) {
+        if (!(this->*occluded)(shadowRay.ray, shadowRay.tMax)) {
+            light += shadowRay.contribution;
+        }
+    });
+
+    return light;
+}
+
+void Renderer::RenderTileWavefront(const Tile &tile, TraceBatchFunction tracePrimaryRays, TraceFunction traceRay, OccludedFunction occluded, WavefrontQueues &queues) noexcept {
+    auto &paths = queues.paths;
+    auto &payloads = queues.payloads;
+    auto &activePaths = queues.activePaths;
+    auto &nextPaths = queues.nextPaths;
+    auto &shadingPaths = queues.shadingPaths;
+    auto &shadowRays = queues.shadowRays;
+
+    // Camera rays for every sample of every pixel in the tile
+    paths.clear();
+    for (int t = tile.y; t < tile.y + tile.height; ++t) {
+        for (int j = tile.x; j < tile.x + tile.width; ++j) {
+            int sampleCount = queues.sampleCounts[tile.width * (t - tile.y) + (j - tile.x)];
+            for (int s = 0; s < sampleCount; ++s) {
+                PathState path;
+                path.ray = GetPrimaryRay(m_Width * t + j);
+                path.light = Math::Vector3f(0.f);
+                path.throughput = Math::Vector3f(1.f);
+                path.pixelIndex = m_Width * t + j;
+                paths.push_back(path);
+            }
+        }
+    }
+
+    int pathCount = static_cast<int>(paths.size());
+    payloads.resize(pathCount);
+    activePaths.resize(pathCount);
+    for (int i = 0; i < pathCount; ++i) {
+        activePaths[i] = i;
+    }
+
+    for (int depth = 0; depth < m_RayDepth && !activePaths.empty(); ++depth) {
+        // Intersection stage. Camera rays are coherent, so they go in batches that may form packets
+        if (depth == 0) {
+            Ray rays[PrimaryBatchSize];
+            for (int first = 0; first < pathCount; first += PrimaryBatchSize) {
+                int batchCount = Math::Min(PrimaryBatchSize, pathCount - first);
+                for (int k = 0; k < batchCount; ++k) {
+                    rays[k] = paths[first + k].ray;
+                }
+
+                (this->*tracePrimaryRays)({rays, static_cast<std::size_t>(batchCount)}, {payloads.data() + first, static_cast<std::size_t>(batchCount)});
+            }
+        } else {
+            for (int pathIndex : activePaths) {
+                payloads[pathIndex] = (this->*traceRay)(paths[pathIndex].ray);
+            }
+        }
+
+        // Misses and emitters terminate, the rest is shaded grouped by material
+        shadingPaths.clear();
+        for (int pathIndex : activePaths) {
+            PathState &path = paths[pathIndex];
+            HitPayload &payload = payloads[pathIndex];
+
+            if (payload.t < 0.f) {
+                path.light += path.throughput * m_OnRayMiss(path.ray);
+                continue;
+            }
+
+            const Material *material = payload.material;
+            path.light += material->GetEmission(payload.texcoord) * path.throughput;
+
+            if (material->emissionPower > 0.f) {
+                continue;
+            }
+
+            shadingPaths.push_back(pathIndex);
+        }
+
+        std::sort(shadingPaths.begin(), shadingPaths.end(), [&payloads](int a, int b) {
+            return payloads[a].material < payloads[b].material;
+        });
+
+        // Shading stage queues shadow rays and continuation rays
+        shadowRays.clear();
+        nextPaths.clear();
+        for (int pathIndex : shadingPaths) {
+            PathState &path = paths[pathIndex];
+            const HitPayload &payload = payloads[pathIndex];
+
+            auto hitPoint = path.ray.origin + path.ray.direction * payload.t;
+            GenerateShadowRays(payload, hitPoint, [&shadowRays, &path, pathIndex](const ShadowRay &shadowRay) {
+                shadowRays.push_back({shadowRay.ray, shadowRay.tMax, shadowRay.contribution * path.throughput, pathIndex});
+            });
+
+            BSDF bsdf(payload.material);
+            auto direction = bsdf.Sample(path.ray, payload, path.throughput);
+
+            path.ray.origin = hitPoint;
+            path.ray.direction = direction;
+            path.ray.inverseDirection = 1.f / path.ray.direction;
+
+            nextPaths.push_back(pathIndex);
+        }
+
+        // Shadow stage
+        for (const auto &shadowRay : shadowRays) {
+            if (!(this->*occluded)(shadowRay.ray, shadowRay.tMax)) {
+                paths[shadowRay.pathIndex].light += shadowRay.contribution;
+            }
+        }
+
+        std::swap(activePaths, nextPaths);
+    }
+
+    for (const auto &path : paths) {
+        AccumulateSample(path.pixelIndex, {path.light.r, path.light.g, path.light.b, 1.f});
+    }
+}
+
+bool Renderer::SampleLight(const Light &lightSource, const HitPayload &payload, const Math::Vector3f &hitPoint, float selectionPdf, ShadowRay &shadowRay) const noexcept {
+    auto pointOnLight = lightSource.GetObject()->SampleUniform({Utilities::RandomFloatInZeroToOne(), Utilities::RandomFloatInZeroToOne()});
+
+    auto toLight = pointOnLight - hitPoint;
+    float distanceSquared = Math::Dot(toLight, toLight);
+    float distance = Math::Sqrt(distanceSquared);
+
+    shadowRay.ray.origin = hitPoint;
+    shadowRay.ray.direction = toLight / distance;
+    shadowRay.ray.inverseDirection = 1.f / shadowRay.ray.direction;
+    shadowRay.tMax = distance - Light::DistanceEpsilon;
+    shadowRay.contribution = lightSource.Sample(shadowRay.ray, payload, distance, distanceSquared) / selectionPdf;
+
+    return !Utilities::AlmostZero(shadowRay.contribution);
+}
+
+bool Renderer::Occluded(const Ray &ray, float tMax) const noexcept {
+    int objectCount = (int)m_Objects.size();
+    for (int i = 0; i < objectCount; ++i) {
+        if (m_Objects[i]->Occluded(ray, 0.01f, tMax)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 HitPayload Renderer::AcceleratedTraceRay(const Ray &ray) const noexcept {
     HitPayload payload;
     payload.t = Math::Constants::Infinity<float>;
     payload.normal = Math::Vector3f(0.f);
-    payload.localRay = ray;
-    payload.transform = Math::IdentityMatrix<float, 4>();
+    payload.instanceId = -1;
     payload.material = nullptr;
+    payload.hittable = nullptr;
 
     if (m_AccelerationStructure->Hit(ray, 0.01f, Math::Constants::Infinity<float>, payload) == false) {
         return Miss(ray);
     }
 
-    payload.normal = Math::Dot(payload.localRay.direction, payload.normal) > Math::Constants::Epsilon<float> ? -payload.normal : payload.normal;
+    ComputeSurfaceInteraction(ray, payload);
 
     return payload;
 }
 
+void Renderer::AcceleratedTraceRays(std::span<const Ray> rays, std::span<HitPayload> payloads) const noexcept {
+    int count = (int)rays.size();
+    for (int first = 0; first < count; first += m_PacketWidth) {
+        int packetCount = Math::Min(m_PacketWidth, count - first);
+
+        if (packetCount == 1) {
+            payloads[first] = AcceleratedTraceRay(rays[first]);
+        } else if (m_PacketWidth == 8) {
+            AcceleratedTracePacket<8>(&rays[first], &payloads[first], packetCount);
+        } else {
+            AcceleratedTracePacket<4>(&rays[first], &payloads[first], packetCount);
+        }
+    }
+}
+
+template<int Width>
+void Renderer::AcceleratedTracePacket(const Ray *rays, HitPayload *payloads, int count) const noexcept {
+    RayPacket<Width> packet(rays, count);
+
+    HitPayload lanePayloads[Width];
+    for (int lane = 0; lane < Width; ++lane) {
+        HitPayload &payload = lanePayloads[lane];
+        payload.t = Math::Constants::Infinity<float>;
+        payload.normal = Math::Vector3f(0.f);
+        payload.instanceId = -1;
+        payload.material = nullptr;
+        payload.hittable = nullptr;
+    }
+
+    int hitMask = m_AccelerationStructure->Hit(packet, 0.01f, lanePayloads);
+
+    for (int lane = 0; lane < count; ++lane) {
+        if ((hitMask >> lane & 1) == 0) {
+            payloads[lane] = Miss(rays[lane]);
+            continue;
+        }
+
+        HitPayload &payload = lanePayloads[lane];
+        ComputeSurfaceInteraction(rays[lane], payload);
+        payloads[lane] = payload;
+    }
+}
+
+bool Renderer::AcceleratedOccluded(const Ray &ray, float tMax) const noexcept {
+    return m_AccelerationStructure->Occluded(ray, 0.01f, tMax);
+}
+
+void Renderer::ComputeSurfaceInteraction(const Ray &ray, HitPayload &payload) const noexcept {
+    if (payload.instanceId < 0) {
+        payload.hittable->ComputeSurfaceInteraction(ray, payload);
+    } else {
+        const BLAS *instance = m_AccelerationStructure->GetInstance(payload.instanceId);
+        payload.hittable->ComputeSurfaceInteraction(instance->ToLocal(ray), payload);
+        payload.normal = instance->ToWorldNormal(payload.normal);
+    }
+
+    payload.normal = Math::Dot(ray.direction, payload.normal) > Math::Constants::Epsilon<float> ? -payload.normal : payload.normal;
+}
+
 HitPayload Renderer::Miss(const Ray &ray) const noexcept {
     HitPayload payload;
     payload.t = -1.f;
@@ -7,10 +7,21 @@
 #include "Ray.h"
 #include "Material.h"
 #include "Light.h"
+#include "sampling/LightSampler.h"
 #include "acceleration/TLAS.h"
+#include "ThreadPool.h"
+#include "TileScheduler.h"
 
 #include <functional>
 #include <span>
+#include <vector>
+#include <cstdint>
+
+//! Way in which paths are traced
+enum class Integrator : int {
+    Megakernel = 0,
+    Wavefront
+};
 
 //! Class that renders Scene to Image
 class Renderer {
@@ -20,14 +31,14 @@ public:
     //! Creates renderer with given width and height
     Renderer(int width, int height) noexcept;
 
-    //! Deallocates image data
+    //! Deallocates image data and stops worker threads
     ~Renderer() noexcept;
 
     //! Renders without object acceleration (but with model accelerator for speed purpose)
-    void Render(const Camera &camera, std::span<IHittable* const> objects, std::span<const Light> lightSources, std::span<const Material> materials) noexcept;
+    void Render(const Camera &camera, std::span<IHittable* const> objects, const LightSampler &lightSampler, std::span<const Material> materials) noexcept;
 
     //! Renders with object acceleration
-    void Render(const Camera &camera, const TLAS *accelerationStructure, std::span<const Light> lightSources, std::span<const Material> materials) noexcept;
+    void Render(const Camera &camera, const TLAS *accelerationStructure, const LightSampler &lightSampler, std::span<const Material> materials) noexcept;
 
     //! Returns reference to accumulation flag. GUI convinience
     constexpr bool& Accumulate() noexcept {
@@ -62,10 +73,10 @@ public:
         return m_UsedThreads;
     }
 
-    //! Sets used threads
-    constexpr void SetUsedThreadCount(int usedThreads) noexcept {
+    //! Sets used threads. Resizes worker pool without recreating renderer
+    inline void SetUsedThreadCount(int usedThreads) noexcept {
         m_UsedThreads = Math::Clamp(usedThreads, 1, m_AvailableThreads);
-        m_LinesPerThread = (m_Height + m_UsedThreads - 1) / m_UsedThreads;
+        m_ThreadPool->Resize(m_UsedThreads);
     }
 
     //! Returns reference to number of threads used in rendering. GUI convinience
@@ -73,11 +84,97 @@ public:
         return m_UsedThreads;
     }
 
+    //! Returns reference to tile size in pixels. GUI convinience
+    constexpr int& TileSize() noexcept {
+        return m_TileSize;
+    }
+
+    //! Returns order in which tiles are rendered
+    constexpr TileOrder GetTileOrder() const noexcept {
+        return m_TileOrder;
+    }
+
+    //! Sets order in which tiles are rendered
+    constexpr void SetTileOrder(TileOrder tileOrder) noexcept {
+        m_TileOrder = tileOrder;
+    }
+
+    //! Sets point in image coordinates around which tiles are rendered first. Negative values mean image center
+    constexpr void SetFocusPoint(int x, int y) noexcept {
+        m_FocusX = x;
+        m_FocusY = y;
+    }
+
+    //! Returns time in milliseconds that every thread spent waiting for others during last frame
+    inline std::span<const double> GetThreadIdleTimes() const noexcept {
+        return m_ThreadIdleTimes;
+    }
+
     //! Sets rule on which missing ray is lightened
     inline void OnRayMiss(std::function<Math::Vector3f(const Ray&)> onRayMiss) noexcept {
         m_OnRayMiss = onRayMiss;
     }
 
+    //! Returns integrator used for rendering
+    constexpr Integrator GetIntegrator() const noexcept {
+        return m_Integrator;
+    }
+
+    //! Sets integrator. Megakernel traces every path to the end, Wavefront advances all paths of a tile bounce by bounce
+    constexpr void SetIntegrator(Integrator integrator) noexcept {
+        m_Integrator = integrator;
+    }
+
+    //! Returns number of camera rays traced together as packet. 1 means packets are off
+    constexpr int GetPacketWidth() const noexcept {
+        return m_PacketWidth;
+    }
+
+    //! Sets packet width of camera rays. Only 1, 4 and 8 are supported, packets are used only with acceleration
+    constexpr void SetPacketWidth(int packetWidth) noexcept {
+        m_PacketWidth = packetWidth >= 8 ? 8 : (packetWidth >= 4 ? 4 : 1);
+    }
+
+    //! Returns reference to adaptive sampling flag. Works only with accumulation. GUI convinience
+    constexpr bool& Adaptive() noexcept {
+        return m_Adaptive;
+    }
+
+    //! Returns reference to relative error at which pixel is converged. GUI convinience
+    constexpr float& TargetNoise() noexcept {
+        return m_TargetNoise;
+    }
+
+    //! Returns reference to number of samples pixel gets before it can converge. GUI convinience
+    constexpr int& MinAdaptiveSamples() noexcept {
+        return m_MinAdaptiveSamples;
+    }
+
+    //! Returns reference to maximum number of samples pixel gets in one frame. GUI convinience
+    constexpr int& MaxSamplesPerFrame() noexcept {
+        return m_MaxSamplesPerFrame;
+    }
+
+    //! Returns average relative error of accumulated image. Infinity until every pixel has two samples
+    constexpr float GetNoiseLevel() const noexcept {
+        return m_NoiseLevel;
+    }
+
+    //! Returns number of pixels that stopped receiving samples
+    constexpr int GetConvergedPixelCount() const noexcept {
+        return m_ConvergedPixelCount;
+    }
+
+    //! Returns number of samples accumulated since last reset
+    constexpr std::uint64_t GetSampleCount() const noexcept {
+        return m_SampleCount;
+    }
+
+    //! Returns true if image noise reached target or all pixels converged
+    constexpr bool IsConverged() const noexcept {
+        return m_NoiseLevel <= m_TargetNoise || m_ConvergedPixelCount == m_Width * m_Height;
+    }
+
     //! Returns reference to ray depth. GUI convinience
     constexpr int& RayDepth() noexcept {
         return m_RayDepth;
@@ -89,14 +186,97 @@ public:
     }
 
 private:
-    Math::Vector4f PixelProgram(int u, int j) const noexcept;
+    struct AdaptiveStatistics {
+        double errorSum = 0.0;
+        double weightSum = 0.0;
+        int convergedCount = 0;
+        std::uint64_t sampleCount = 0;
+    };
+
+    //! Shadow ray with contribution it adds if not occluded
+    struct ShadowRay {
+        Ray ray;
+        float tMax;
+        Math::Vector3f contribution;
+    };
+
+    //! State of one path between wavefront stages
+    struct PathState {
+        Ray ray;
+        Math::Vector3f light;
+        Math::Vector3f throughput;
+        int pixelIndex;
+    };
+
+    //! Shadow ray queued by wavefront shading stage
+    struct QueuedShadowRay {
+        Ray ray;
+        float tMax;
+        Math::Vector3f contribution;
+        int pathIndex;
+    };
+
+    //! Per-thread storage reused between tiles
+    struct WavefrontQueues {
+        std::vector<int> sampleCounts;
+        std::vector<PathState> paths;
+        std::vector<HitPayload> payloads;
+        std::vector<int> activePaths;
+        std::vector<int> nextPaths;
+        std::vector<int> shadingPaths;
+        std::vector<QueuedShadowRay> shadowRays;
+    };
+
+    //! Camera rays are generated in batches of this size, so they can be traced as packets
+    constexpr static int PrimaryBatchSize = 8;
+
+    using TraceBatchFunction = void (Renderer::*)(std::span<const Ray>, std::span<HitPayload>) const noexcept;
+    using TraceFunction = HitPayload (Renderer::*)(const Ray&) const noexcept;
+    using OccludedFunction = bool (Renderer::*)(const Ray&, float) const noexcept;
+
+    void RenderFrame(TraceBatchFunction tracePrimaryRays, TraceFunction traceRay, OccludedFunction occluded) noexcept;
+
+    void RenderTile(const Tile &tile, TraceBatchFunction tracePrimaryRays, TraceFunction traceRay, OccludedFunction occluded, float inverseGamma, int threadIndex) noexcept;
+
+    void RenderTileWavefront(const Tile &tile, TraceBatchFunction tracePrimaryRays, TraceFunction traceRay, OccludedFunction occluded, WavefrontQueues &queues) noexcept;
+
+    void AccumulateSample(int index, const Math::Vector4f &sample) noexcept;
 
-    Math::Vector4f AcceleratedPixelProgram(int i, int j) const noexcept;
+    void ResetAccumulation() noexcept;
+
+    void UpdateAdaptiveStatistics() noexcept;
+
+    float ComputeRelativeError(int index) const noexcept;
+
+    Ray GetPrimaryRay(int index) const noexcept;
+
+    Math::Vector4f TracePath(Ray ray, HitPayload payload, TraceFunction traceRay, OccludedFunction occluded) const noexcept;
+
+    Math::Vector3f EstimateDirectLight(const HitPayload &payload, const Math::Vector3f &hitPoint, OccludedFunction occluded) const noexcept;
+
+    template<typename F>
+    void GenerateShadowRays(const HitPayload &payload, const Math::Vector3f &hitPoint, F &&onShadowRay) const noexcept;
+
+    bool SampleLight(const Light &lightSource, const HitPayload &payload, const Math::Vector3f &hitPoint, float selectionPdf, ShadowRay &shadowRay) const noexcept;
 
     HitPayload TraceRay(const Ray &ray) const noexcept;
 
+    void TraceRays(std::span<const Ray> rays, std::span<HitPayload> payloads) const noexcept;
+
+    bool Occluded(const Ray &ray, float tMax) const noexcept;
+
     HitPayload AcceleratedTraceRay(const Ray &ray) const noexcept;
 
+    void AcceleratedTraceRays(std::span<const Ray> rays, std::span<HitPayload> payloads) const noexcept;
+
+    template<int Width>
+    void AcceleratedTracePacket(const Ray *rays, HitPayload *payloads, int count) const noexcept;
+
+    bool AcceleratedOccluded(const Ray &ray, float tMax) const noexcept;
+
+    //! Fills surface data of closest hit of world space ```ray```. Hit instance shades in its local space, normal is returned in world space facing against the ray
+    void ComputeSurfaceInteraction(const Ray &ray, HitPayload &payload) const noexcept;
+
     HitPayload Miss(const Ray &ray) const noexcept;
 
 private:
@@ -105,22 +285,45 @@ private:
 
     int m_AvailableThreads;
     int m_UsedThreads;
-    int m_LinesPerThread;
+    ThreadPool *m_ThreadPool;
+
+    int m_TileSize = 32;
+    TileOrder m_TileOrder = TileOrder::Spiral;
+    int m_FocusX = -1, m_FocusY = -1;
+    TileScheduler m_TileScheduler;
+    std::vector<double> m_ThreadBusyTimes;
+    std::vector<double> m_ThreadIdleTimes;
 
     int m_RayDepth = 5;
+    int m_PacketWidth = 4;
 
     std::function<Math::Vector3f(const Ray&)> m_OnRayMiss = [](const Ray&){ return Math::Vector3f(0.f, 0.f, 0.f); };
 
     const Camera *m_Camera = nullptr;
     std::span<IHittable* const> m_Objects;
-    std::span<const Light> m_LightSources;
+    const LightSampler *m_LightSampler = nullptr;
     const TLAS *m_AccelerationStructure = nullptr;
     std::span<const Material> m_Materials;
 
     bool m_Accumulate = false;
     Math::Vector4f *m_AccumulationData = nullptr;
+    float *m_LuminanceSquaredData = nullptr;
+    std::uint8_t *m_ConvergedMask = nullptr;
     int m_FrameIndex = 1;
 
+    Integrator m_Integrator = Integrator::Megakernel;
+    std::vector<WavefrontQueues> m_WavefrontQueues;
+
+    bool m_Adaptive = false;
+    float m_TargetNoise = 0.02f;
+    int m_MinAdaptiveSamples = 16;
+    int m_MaxSamplesPerFrame = 4;
+    std::vector<AdaptiveStatistics> m_ThreadStatistics;
+    float m_NoiseLevel = Math::Constants::Infinity<float>;
+    int m_ConvergedPixelCount = 0;
+    float m_SampleScale = 1.f;
+    std::uint64_t m_SampleCount = 0;
+
     bool m_Accelerate = false;
 
     float m_Gamma = 2.f;
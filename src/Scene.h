@@ -237,6 +237,9 @@ private:
 
             printf("Time to load model %s is %fms\n", pathToFile.c_str(), loadTime);
 
+            const auto &buildStatistics = modelInstance->GetBLAS()->GetBVH()->GetBuildStatistics();
+            printf("BVH of model %s %s in %fms, SAH cost %f, depth %d, %d nodes, %d leaves, %zu bytes\n", pathToFile.c_str(), buildStatistics.loadedFromCache ? "loaded from cache" : "built", buildStatistics.buildTime, buildStatistics.sahCost, buildStatistics.depth, buildStatistics.nodeCount, buildStatistics.leafCount, buildStatistics.memoryFootprint);
+
             modelInstances.push_back(modelInstance);
         }
         modelInstances.shrink_to_fit();
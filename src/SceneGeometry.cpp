@@ -0,0 +1,174 @@
+#include "SceneGeometry.h"
+
+#include <array>
+
+SceneGeometry::SceneGeometry() noexcept :
+    m_AccelerationStructure(nullptr), m_ObjectsBVH(nullptr), m_ObjectsBLAS(nullptr) {
+    m_NonHittable = new NonHittable();
+    std::array<IHittable*, 1> nonHittableArray = {m_NonHittable};
+    m_NonHittableBLAS = new BLAS(new BVH(nonHittableArray));
+}
+
+SceneGeometry::~SceneGeometry() noexcept {
+    if (m_AccelerationStructure != nullptr) {
+        delete m_AccelerationStructure;
+    }
+
+    CancelObjectsRebuild();
+    DeleteObjectsBLAS();
+
+    if (m_NonHittable != nullptr) {
+        delete m_NonHittable;
+    }
+
+    if (m_NonHittableBLAS != nullptr) {
+        delete m_NonHittableBLAS->GetBVH();
+        delete m_NonHittableBLAS;
+    }
+}
+
+void SceneGeometry::UpdateObjects(Scene &scene) noexcept {
+    CancelObjectsRebuild();
+    m_Objects.clear();
+
+    for (auto &sphere : scene.spheres) {
+        m_Objects.push_back(&sphere);
+    }
+
+    for (auto &triangle : scene.triangles) {
+        m_Objects.push_back(&triangle);
+    }
+
+    for (auto &box : scene.boxes) {
+        m_Objects.push_back(&box);
+    }
+
+    DeleteObjectsBLAS();
+
+    if (m_Objects.empty()) {
+        return;
+    }
+
+    m_ObjectsBVH = new BVH(m_Objects);
+    m_ObjectsBLAS = new BLAS(m_ObjectsBVH);
+}
+
+void SceneGeometry::RefitObjects() noexcept {
+    if (m_ObjectsBVH == nullptr) {
+        return;
+    }
+
+    m_ObjectsBVH->Refit();
+    m_ObjectsBLAS->Refit();
+
+    std::array<const BLAS*, 1> objectsBLAS = {m_ObjectsBLAS};
+    UpdateInstances(objectsBLAS);
+
+    // Light BVH and power table were built over old positions and sizes
+    for (auto &light : m_Lights) {
+        light.UpdatePower();
+    }
+    m_LightSampler.Build(m_Lights);
+
+    if (m_ObjectsRebuild.valid() || m_ObjectsBVH->GetSAHDegradation() <= RebuildThreshold) {
+        return;
+    }
+
+    // Bounds are captured here, so primitives can be edited further while the tree builds
+    std::vector<AABB> bounds(m_Objects.size());
+    for (std::size_t i = 0; i < m_Objects.size(); ++i) {
+        bounds[i] = m_Objects[i]->GetBoundingBox();
+    }
+
+    // Single build thread leaves the cores to rendering
+    BVHBuildOptions options;
+    options.parallelBuild = false;
+
+    m_ObjectsRebuild = std::async(std::launch::async, [objects = m_Objects, bounds = std::move(bounds), options]() {
+        return new BVH(objects, bounds, options);
+    });
+}
+
+void SceneGeometry::UpdateInstances(std::span<const BLAS* const> instances) noexcept {
+    if (m_AccelerationStructure != nullptr) {
+        m_AccelerationStructure->Update(instances);
+    }
+}
+
+bool SceneGeometry::PollObjectsRebuild() noexcept {
+    if (!m_ObjectsRebuild.valid() || m_ObjectsRebuild.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return false;
+    }
+
+    BVH *bvh = m_ObjectsRebuild.get();
+
+    // Primitives may have moved since their bounds were captured
+    bvh->Refit();
+
+    DeleteObjectsBLAS();
+    m_ObjectsBVH = bvh;
+    m_ObjectsBLAS = new BLAS(m_ObjectsBVH);
+
+    return true;
+}
+
+void SceneGeometry::UpdateLights(Scene &scene) noexcept {
+    m_Lights.clear();
+
+    for (auto &sphere : scene.spheres) {
+        if (sphere.material->emissionPower > 0.f) {
+            m_Lights.emplace_back(&sphere, sphere.material);
+        }
+    }
+
+    for (auto &triangle : scene.triangles) {
+        if (triangle.material->emissionPower > 0.f) {
+            m_Lights.emplace_back(&triangle, triangle.material);
+        }
+    }
+
+    for (auto &box : scene.boxes) {
+        if (box.material->emissionPower > 0.f) {
+            m_Lights.emplace_back(&box, box.material);
+        }
+    }
+
+    m_LightSampler.Build(m_Lights);
+}
+
+void SceneGeometry::UpdateTLAS(const Scene &scene) noexcept {
+    if (m_AccelerationStructure != nullptr) {
+        delete m_AccelerationStructure;
+        m_AccelerationStructure = nullptr;
+    }
+
+    std::vector<BLAS*> blas;
+    if (m_ObjectsBLAS != nullptr) {
+        blas.push_back(m_ObjectsBLAS);
+    }
+
+    for (auto modelInstance : scene.modelInstances) {
+        blas.push_back(modelInstance->GetBLAS());
+    }
+
+    if (blas.empty()) {
+        blas.push_back(m_NonHittableBLAS);
+    }
+
+    m_AccelerationStructure = new TLAS(blas);
+}
+
+void SceneGeometry::CancelObjectsRebuild() noexcept {
+    if (m_ObjectsRebuild.valid()) {
+        delete m_ObjectsRebuild.get();
+    }
+}
+
+void SceneGeometry::DeleteObjectsBLAS() noexcept {
+    if (m_ObjectsBLAS != nullptr) {
+        delete m_ObjectsBVH;
+        delete m_ObjectsBLAS;
+        m_ObjectsBVH = nullptr;
+        m_ObjectsBLAS = nullptr;
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef _SCENE_GEOMETRY_H
+#define _SCENE_GEOMETRY_H
+
+#include "Scene.h"
+#include "Light.h"
+#include "sampling/LightSampler.h"
+#include "hittable/NonHittable.h"
+#include "acceleration/TLAS.h"
+
+#include <vector>
+#include <span>
+#include <future>
+
+//! Render-ready view of Scene: flat list of primitives, light sources and acceleration structures. Does not depend on GUI
+class SceneGeometry {
+public:
+    //! Creates empty geometry with placeholder BLAS used when scene has nothing to hit
+    SceneGeometry() noexcept;
+
+    SceneGeometry(const SceneGeometry&) = delete;
+    SceneGeometry& operator=(const SceneGeometry&) = delete;
+
+    ~SceneGeometry() noexcept;
+
+    //! Collects primitives of the scene and rebuilds their BVH. Lights still point at old primitives, so UpdateLights has to follow
+    void UpdateObjects(Scene &scene) noexcept;
+
+    //! Refits primitives BVH after they were moved and updates its TLAS leaf and light sampler. Starts background rebuild once refits make its SAH cost ```RebuildThreshold``` times worse
+    void RefitObjects() noexcept;
+
+    //! Updates TLAS leaves of ```instances``` after their transforms changed, without rebuilding it
+    void UpdateInstances(std::span<const BLAS* const> instances) noexcept;
+
+    //! Swaps in primitives BVH rebuilt in background once it is ready. Returns true if primitives BLAS changed, so TLAS has to be rebuilt
+    bool PollObjectsRebuild() noexcept;
+
+    //! Collects emissive primitives of the scene and rebuilds light sampler
+    void UpdateLights(Scene &scene) noexcept;
+
+    //! Rebuilds TLAS from primitives BLAS and model instances
+    void UpdateTLAS(const Scene &scene) noexcept;
+
+    //! Returns span of all primitives
+    inline std::span<IHittable* const> GetObjects() const noexcept {
+        return m_Objects;
+    }
+
+    //! Returns span of light sources
+    inline std::span<const Light> GetLights() const noexcept {
+        return m_Lights;
+    }
+
+    //! Returns light sampler built over light sources
+    constexpr const LightSampler& GetLightSampler() const noexcept {
+        return m_LightSampler;
+    }
+
+    //! Returns light sampler built over light sources. Used to change sampling strategy
+    constexpr LightSampler& GetLightSampler() noexcept {
+        return m_LightSampler;
+    }
+
+    //! Returns top-level acceleration structure
+    constexpr const TLAS* GetAccelerationStructure() const noexcept {
+        return m_AccelerationStructure;
+    }
+
+private:
+    //! Waits for background rebuild and drops its result
+    void CancelObjectsRebuild() noexcept;
+
+    //! Deletes primitives BVH and its BLAS
+    void DeleteObjectsBLAS() noexcept;
+
+private:
+    constexpr static float RebuildThreshold = 1.5f;
+
+    std::vector<IHittable*> m_Objects;
+    std::vector<Light> m_Lights;
+    LightSampler m_LightSampler;
+
+    TLAS *m_AccelerationStructure;
+    BVH *m_ObjectsBVH;
+    BLAS *m_ObjectsBLAS;
+    std::future<BVH*> m_ObjectsRebuild;
+
+    NonHittable *m_NonHittable;
+    BLAS *m_NonHittableBLAS;
+};
+
+#endif
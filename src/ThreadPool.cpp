@@ -0,0 +1,83 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int threadCount) noexcept {
+    Resize(threadCount);
+}
+
+ThreadPool::~ThreadPool() noexcept {
+    Resize(0);
+}
+
+void ThreadPool::Resize(int threadCount) noexcept {
+    Wait();
+
+    int currentCount = GetThreadCount();
+    if (threadCount == currentCount) {
+        return;
+    }
+
+    std::uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_ThreadCount = threadCount;
+        generation = m_Generation;
+    }
+
+    if (threadCount > currentCount) {
+        m_Workers.reserve(threadCount);
+        for (int i = currentCount; i < threadCount; ++i) {
+            m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, i, generation);
+        }
+        return;
+    }
+
+    m_WakeCondition.notify_all();
+    for (int i = threadCount; i < currentCount; ++i) {
+        m_Workers[i].join();
+    }
+
+    m_Workers.resize(threadCount);
+}
+
+void ThreadPool::Dispatch(std::function<void(int)> task) noexcept {
+    Wait();
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Task = std::move(task);
+        m_RunningCount = GetThreadCount();
+        ++m_Generation;
+    }
+
+    m_WakeCondition.notify_all();
+}
+
+void ThreadPool::Wait() noexcept {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_DoneCondition.wait(lock, [this]() {
+        return m_RunningCount == 0;
+    });
+}
+
+void ThreadPool::WorkerLoop(int threadIndex, std::uint64_t lastGeneration) noexcept {
+    while (true) {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_WakeCondition.wait(lock, [this, threadIndex, lastGeneration]() {
+            return threadIndex >= m_ThreadCount || m_Generation != lastGeneration;
+        });
+
+        if (threadIndex >= m_ThreadCount) {
+            return;
+        }
+
+        lastGeneration = m_Generation;
+        lock.unlock();
+
+        m_Task(threadIndex);
+
+        lock.lock();
+        if (--m_RunningCount == 0) {
+            m_DoneCondition.notify_all();
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+//! Long-lived worker threads. Workers sleep between dispatches and are woken for every task
+class ThreadPool {
+public:
+    ThreadPool() = delete;
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    //! Creates pool with given number of workers
+    ThreadPool(int threadCount) noexcept;
+
+    //! Stops and joins all workers
+    ~ThreadPool() noexcept;
+
+    //! Changes number of workers. Waits for dispatched task, then spawns or joins only the difference
+    void Resize(int threadCount) noexcept;
+
+    //! Wakes up workers, every worker calls ```task``` with its index. Does not wait for completion
+    void Dispatch(std::function<void(int)> task) noexcept;
+
+    //! Blocks until every worker has finished dispatched task
+    void Wait() noexcept;
+
+    //! Returns number of workers
+    inline int GetThreadCount() const noexcept {
+        return static_cast<int>(m_Workers.size());
+    }
+
+private:
+    void WorkerLoop(int threadIndex, std::uint64_t lastGeneration) noexcept;
+
+private:
+    std::vector<std::thread> m_Workers;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_WakeCondition;
+    std::condition_variable m_DoneCondition;
+
+    std::function<void(int)> m_Task;
+    std::uint64_t m_Generation = 0;
+    int m_ThreadCount = 0;
+    int m_RunningCount = 0;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "TileScheduler.h"
+#include "math/LAMath.h"
+
+#include <algorithm>
+#include <cmath>
+
+void TileScheduler::Prepare(int width, int height, int tileSize, int threadCount, TileOrder order, int focusX, int focusY) noexcept {
+    tileSize = Math::Max(tileSize, 1);
+    threadCount = Math::Max(threadCount, 1);
+
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+    m_TileCount = tilesX * tilesY;
+
+    int focusTileX = Math::Clamp(focusX, 0, Math::Max(width - 1, 0)) / tileSize;
+    int focusTileY = Math::Clamp(focusY, 0, Math::Max(height - 1, 0)) / tileSize;
+
+    m_SortedTiles.clear();
+    m_SortedTiles.reserve(m_TileCount);
+    for (int ty = 0; ty < tilesY; ++ty) {
+        for (int tx = 0; tx < tilesX; ++tx) {
+            Tile tile;
+            tile.x = tx * tileSize;
+            tile.y = ty * tileSize;
+            tile.width = Math::Min(tileSize, width - tile.x);
+            tile.height = Math::Min(tileSize, height - tile.y);
+
+            int dx = tx - focusTileX;
+            int dy = ty - focusTileY;
+
+            std::uint64_t key = 0;
+            switch (order) {
+            case TileOrder::Scanline:
+                key = static_cast<std::uint64_t>(ty) * tilesX + tx;
+                break;
+            case TileOrder::Morton:
+                key = InterleaveBits(Math::Abs(dx)) | (InterleaveBits(Math::Abs(dy)) << 1);
+                break;
+            case TileOrder::Spiral: {
+                std::uint64_t ring = Math::Max(Math::Abs(dx), Math::Abs(dy));
+                float turn = (std::atan2(static_cast<float>(dy), static_cast<float>(dx)) + Math::Constants::Pi<float>) * 0.5f * Math::Constants::InversePi<float>;
+                key = (ring << 32) | static_cast<std::uint32_t>(turn * 65535.f);
+                break;
+            }
+            }
+
+            m_SortedTiles.push_back({key, tile});
+        }
+    }
+
+    std::stable_sort(m_SortedTiles.begin(), m_SortedTiles.end(), [](const auto &a, const auto &b) {
+        return a.first < b.first;
+    });
+
+    while (static_cast<int>(m_Queues.size()) < threadCount) {
+        m_Queues.push_back(std::make_unique<WorkQueue>());
+    }
+    m_Queues.resize(threadCount);
+
+    for (auto &queue : m_Queues) {
+        queue->tiles.clear();
+    }
+
+    for (int i = 0; i < m_TileCount; ++i) {
+        m_Queues[i % threadCount]->tiles.push_back(m_SortedTiles[i].second);
+    }
+}
+
+bool TileScheduler::Next(int threadIndex, Tile &tile) noexcept {
+    int queueCount = static_cast<int>(m_Queues.size());
+
+    {
+        WorkQueue &own = *m_Queues[threadIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tiles.empty()) {
+            tile = own.tiles.front();
+            own.tiles.pop_front();
+            return true;
+        }
+    }
+
+    for (int offset = 1; offset < queueCount; ++offset) {
+        WorkQueue &victim = *m_Queues[(threadIndex + offset) % queueCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tiles.empty()) {
+            tile = victim.tiles.back();
+            victim.tiles.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::uint32_t TileScheduler::InterleaveBits(std::uint32_t value) noexcept {
+    value &= 0x0000ffff;
+    value = (value | (value << 8)) & 0x00ff00ff;
+    value = (value | (value << 4)) & 0x0f0f0f0f;
+    value = (value | (value << 2)) & 0x33333333;
+    value = (value | (value << 1)) & 0x55555555;
+    return value;
+}
@@ -0,0 +1,56 @@
+#ifndef _TILE_SCHEDULER_H
+#define _TILE_SCHEDULER_H
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <utility>
+#include <cstdint>
+
+//! Rectangular part of image in pixels. Covers rows [y, y + height) and columns [x, x + width)
+struct Tile {
+    int x, y;
+    int width, height;
+};
+
+//! Order in which tiles are issued to threads
+enum class TileOrder : int {
+    Scanline = 0,
+    Morton,
+    Spiral
+};
+
+//! Splits image into tiles and hands them out to threads. Every thread owns a deque and steals from others when its own is empty
+class TileScheduler {
+public:
+    TileScheduler() noexcept = default;
+    TileScheduler(const TileScheduler&) = delete;
+    TileScheduler& operator=(const TileScheduler&) = delete;
+
+    //! Splits image into tiles, sorts them by ```order``` relative to focus point and deals them to ```threadCount``` deques
+    void Prepare(int width, int height, int tileSize, int threadCount, TileOrder order, int focusX, int focusY) noexcept;
+
+    //! Takes next tile from front of own deque or steals one from back of other deque. Returns false if no tiles left
+    bool Next(int threadIndex, Tile &tile) noexcept;
+
+    //! Returns number of tiles prepared for current frame
+    inline int GetTileCount() const noexcept {
+        return m_TileCount;
+    }
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Tile> tiles;
+    };
+
+    static std::uint32_t InterleaveBits(std::uint32_t value) noexcept;
+
+private:
+    std::vector<std::unique_ptr<WorkQueue>> m_Queues;
+    std::vector<std::pair<std::uint64_t, Tile>> m_SortedTiles;
+    int m_TileCount = 0;
+};
+
+#endif
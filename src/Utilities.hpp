@@ -93,6 +93,10 @@ namespace Utilities {
 			color.a
 		};
 	}
+
+	constexpr float Luminance(const Math::Vector3f &color) noexcept {
+		return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+	}
 }
 
 #endif
@@ -29,6 +29,12 @@ struct AABB {
         return 2.f * (a * b + b * c + a * c);
     }
 
+    //! Returns true if ```other``` lies completely inside
+    constexpr bool Contains(const AABB &other) const noexcept {
+        return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z &&
+               max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+    }
+
     //! Returns multiplier ```t``` if ray intersects AABB on given interval, otherwise returns +inf
     constexpr float Intersect(const Ray &ray, float tMin, float tMax) const noexcept {
         auto inverseDirection = ray.inverseDirection;
@@ -18,32 +18,74 @@ public:
         m_Transform(Math::IdentityMatrix<float, 4>()),
         m_InverseTransform(Math::IdentityMatrix<float, 4>()) {}
 
-    //! Sets transformation matrix
+    //! Sets transformation matrix. Its last row is dropped, so it has to be affine
     constexpr void SetTransform(const Math::Matrix4f &transform) noexcept {
-        m_Transform = transform;
-        m_InverseTransform = Math::Inverse(transform);
-        m_LocalAABB = ComputeLocalAABB(transform);
+        m_Transform = Math::Matrix3x4f(transform);
+        m_InverseTransform = Math::Inverse(m_Transform);
+        m_LocalAABB = ComputeLocalAABB(m_Transform);
     }
 
-    //! Ray-BLAS intersection. Transforms ray into local space and saves it if hit
-    inline bool Hit(const Ray &worldRay, float tMin, float tMax, HitPayload &payload) const noexcept {
+    //! Recomputes local AABB after its BVH was refitted
+    constexpr void Refit() noexcept {
+        m_LocalAABB = ComputeLocalAABB(m_Transform);
+    }
+
+    //! Ray-BLAS intersection on top of traversal ```stack```. Traverses BVH with ray transformed into local space
+    inline bool Hit(const Ray &worldRay, float tMin, float tMax, HitPayload &payload, TraversalEntry *stack) const noexcept {
+        if (m_LocalAABB.Intersect(worldRay, tMin, tMax) == Math::Constants::Infinity<float>) {
+            return false;
+        }
+
+        return m_BVH->Hit(ToLocal(worldRay), tMin, tMax, payload, stack);
+    }
+
+    //! Packet-BLAS intersection of lanes in ```mask``` on top of traversal ```stack```. Traverses BVH with packet transformed into local space
+    template<int Width>
+    inline int Hit(const RayPacket<Width> &worldPacket, int mask, float tMin, float *tMax, HitPayload *payloads, TraversalEntry *stack) const noexcept {
+        float nearestT;
+        mask = worldPacket.Intersect(m_LocalAABB, tMin, tMax, mask, nearestT);
+        if (mask == 0) {
+            return 0;
+        }
+
+        RayPacket<Width> localPacket(worldPacket, m_InverseTransform);
+
+        return m_BVH->Hit(localPacket, mask, tMin, tMax, payloads, stack);
+    }
+
+    //! Ray-BLAS occlusion test on top of traversal ```stack```. Transforms ray into local space, but does not save it
+    inline bool Occluded(const Ray &worldRay, float tMin, float tMax, TraversalEntry *stack) const noexcept {
         if (m_LocalAABB.Intersect(worldRay, tMin, tMax) == Math::Constants::Infinity<float>) {
             return false;
         }
 
+        return m_BVH->Occluded(ToLocal(worldRay), tMin, tMax, stack);
+    }
+
+    //! Counts work of closest hit traversal of ```worldRay``` through binary nodes of BVH. Used to compare builders
+    inline BVH::TraversalStatistics MeasureTraversal(const Ray &worldRay, float tMin, float tMax) const noexcept {
+        return m_BVH->MeasureTraversal(ToLocal(worldRay), tMin, tMax);
+    }
+
+    //! Transforms ```worldRay``` into local space. Distances along it stay the same
+    inline Ray ToLocal(const Ray &worldRay) const noexcept {
         Ray localRay;
         localRay.origin = Math::TransformPoint(m_InverseTransform, worldRay.origin);
         localRay.direction = Math::TransformVector(m_InverseTransform, worldRay.direction);
         localRay.inverseDirection = 1.f / localRay.direction;
+        localRay.opticalDensity = worldRay.opticalDensity;
 
-        if (!m_BVH->Hit(localRay, tMin, tMax, payload)) {
-            return false;
-        }
-        
-        payload.localRay = localRay;
-        payload.transform = m_Transform;
+        return localRay;
+    }
+
+    //! Transforms ```localNormal``` into world space and normalizes it
+    inline Math::Vector3f ToWorldNormal(const Math::Vector3f &localNormal) const noexcept {
+        return Math::Normalize(Math::TransformNormal(m_InverseTransform, localNormal));
+    }
 
-        return true;
+    //! Returns transformation from local into world space
+    constexpr const Math::Matrix3x4f& GetTransform() const noexcept {
+        return m_Transform;
     }
 
     //! Returns AABB in local space
@@ -57,9 +99,9 @@ public:
     }
 
 private:
-    constexpr AABB ComputeLocalAABB(const Math::Matrix4f transform) const noexcept {
+    constexpr AABB ComputeLocalAABB(const Math::Matrix3x4f &transform) const noexcept {
         AABB aabb = m_BVH->GetBoundingBox();
-        Math::Vector3f min, max;
+        AABB transformed = AABB::Empty();
         for (int i = 0; i < 8; ++i) {
             Math::Vector3f corner;
             corner.x = i & 1 ? aabb.max.x : aabb.min.x;
@@ -67,18 +109,17 @@ private:
             corner.z = i & 4 ? aabb.max.z : aabb.min.z;
 
             Math::Vector3f point = Math::TransformPoint(transform, corner);
-            min = Math::Min(min, point);
-            max = Math::Max(max, point);
+            transformed = AABB(transformed, AABB(point, point));
         }
 
-        return AABB(min, max);
+        return transformed;
     }
 
 private:
     const BVH *m_BVH;
     AABB m_LocalAABB;
-    Math::Matrix4f m_Transform;
-    Math::Matrix4f m_InverseTransform;
+    Math::Matrix3x4f m_Transform;
+    Math::Matrix3x4f m_InverseTransform;
 };
 
 #endif
\ No newline at end of file
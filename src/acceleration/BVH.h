@@ -2,26 +2,76 @@
 #define _BVH_H
 
 #include "../hittable/IHittable.h"
+#include "RayPacket.h"
+#include "WideNode.h"
+#include "TraversalStack.h"
+#include "LeafPrimitives.h"
+#include "../Timer.h"
+#include "../ThreadPool.h"
 
 #include <vector>
 #include <span>
 #include <functional>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <tuple>
+#include <bit>
+#include <thread>
+#include <cstring>
+#include <ostream>
+#include <unordered_map>
+
+//! Algorithm used to split primitives while building BVH
+enum class BVHBuildMethod : int {
+    SweepSAH = 0,
+    BinnedSAH,
+    SpatialSAH,
+    LinearMorton
+};
+
+//! Parameters of BVH construction
+struct BVHBuildOptions {
+    BVHBuildMethod method = BVHBuildMethod::BinnedSAH;
+    //! Leaves hold at most this many hittables
+    int maxLeafSize = 4;
+    //! Cost of visiting node relative to testing one hittable
+    float traversalCost = 1.f;
+    //! Binned and linear builds of large arrays run in parallel on ```threadPool```
+    bool parallelBuild = true;
+    //! Pool of parallel builds, caller must not dispatch to it meanwhile. Null means pool shared by all builds with one worker per core, build that finds it busy runs serially
+    ThreadPool *threadPool = nullptr;
+    //! Spatial build tries plane splits where children of object split overlap by more than this fraction of root area
+    float spatialSplitOverlap = 1e-5f;
+    //! Spatial build duplicates at most this fraction of hittables into several leaves
+    float spatialSplitBudget = 0.3f;
+    //! Linear build restructures treelets of its tree to lower SAH cost, trading part of its speed for quality close to binned build
+    bool optimizeTreelets = true;
+    //! Collapses binary tree into 4-wide nodes that single rays traverse
+    bool wideNodes = true;
+    //! Stores bounds of wide node children as 8-bit offsets inside parent bounds
+    bool quantizedNodes = false;
+};
 
 //! Bounding volume hierarchy. Binary tree structure that improves ray-model in average O(logn)
 class BVH {
 private:
-    struct Node {
+    //! Leaf holds ```count``` hittables starting at ```-index```. Nodes are stored depth first, so internal node has children right after it and at ```index```
+    struct alignas(32) Node {
         int index;
+        int count;
         AABB aabb;
 
         constexpr Node() noexcept :
-            index(-1), aabb(AABB::Empty()) {}
+            index(-1), count(0), aabb(AABB::Empty()) {}
 
-        constexpr Node(int index, const AABB &aabb) noexcept :
-            index(index), aabb(aabb) {}
+        constexpr Node(int index, const AABB &aabb, int count = 0) noexcept :
+            index(index), count(count), aabb(aabb) {}
 
         constexpr Node(int index, const Node &left, const Node &right) noexcept :
-            index(index), aabb(left.aabb, right.aabb) {}
+            index(index), count(0), aabb(left.aabb, right.aabb) {}
 
         constexpr bool IsLeaf() const noexcept {
             return index <= 0;
@@ -29,38 +79,202 @@ private:
     };
     
 public:
+    //! Information about finished build
+    struct BuildStatistics {
+        double buildTime = 0.0;
+        float sahCost = 0.f;
+        int depth = 0;
+        int nodeCount = 0;
+        int leafCount = 0;
+        int wideNodeCount = 0;
+        int wideDepth = 0;
+        std::size_t memoryFootprint = 0;
+        double refitTime = 0.0;
+        //! Leaf entries, larger than number of hittables when spatial splits duplicate them
+        int referenceCount = 0;
+        //! Tree was read from cache instead of built, build time holds load time
+        bool loadedFromCache = false;
+    };
+
+    //! Work of closest hit traversal through binary nodes
+    struct TraversalStatistics {
+        int nodeCount = 0;
+        int hittableCount = 0;
+    };
+
     //! Constructs a binary tree with given array of hittables
-    inline BVH(std::span<IHittable* const> hittables) noexcept :
-        m_Hittables(hittables.begin(), hittables.end()) {
-        int n = static_cast<int>(hittables.size());
-        m_Nodes.resize(2 * n);
+    inline BVH(std::span<IHittable* const> hittables, const BVHBuildOptions &options = BVHBuildOptions()) noexcept :
+        m_Hittables(hittables.begin(), hittables.end()),
+        m_MaxLeafSize(Math::Clamp(options.maxLeafSize, 1, MaxLeafSize)),
+        m_TraversalCost(options.traversalCost) {
+        Build(options, {});
+    }
 
-        int usedNodes = 1;
-        MakeHierarchySAH(1, 0, n, usedNodes);
-        m_AABB = m_Nodes[1].aabb;
+    //! Constructs a binary tree from ```bounds``` of hittables captured beforehand, so hittables may be edited while it builds on another thread. Always uses binned builder. Shapes are gathered by first Refit
+    inline BVH(std::span<IHittable* const> hittables, std::span<const AABB> bounds, const BVHBuildOptions &options) noexcept :
+        m_Hittables(hittables.begin(), hittables.end()),
+        m_MaxLeafSize(Math::Clamp(options.maxLeafSize, 1, MaxLeafSize)),
+        m_TraversalCost(options.traversalCost) {
+        BVHBuildOptions binnedOptions = options;
+        binnedOptions.method = BVHBuildMethod::BinnedSAH;
+        Build(binnedOptions, bounds);
+    }
+
+    //! Recomputes bounds of all nodes bottom-up after hittables moved. Tree topology is kept, so it runs in O(n) while SAH cost may grow. Gathered shapes are updated, since they hold old positions
+    inline void Refit() noexcept {
+        m_BuildStatistics.refitTime = Timer::MeasureInMillis([this]() {
+            if (m_Primitives.IsEmpty()) {
+                GatherPrimitives();
+            } else {
+                for (int i = 0; i < static_cast<int>(m_Hittables.size()); ++i) {
+                    m_Primitives.Set(i, m_Hittables[i]->GetShapeData());
+                }
+            }
+
+            // Children are stored after their parent, so reverse order visits them first
+            for (int nodeIndex = static_cast<int>(m_Nodes.size()) - 1; nodeIndex >= 0; --nodeIndex) {
+                Node &node = m_Nodes[nodeIndex];
+                if (node.IsLeaf()) {
+                    node.aabb = AABB::Empty();
+                    int first = -node.index;
+                    for (int i = first; i < first + node.count; ++i) {
+                        node.aabb = AABB(node.aabb, m_Hittables[i]->GetBoundingBox());
+                    }
+                } else {
+                    node.aabb = AABB(m_Nodes[nodeIndex + 1].aabb, m_Nodes[node.index].aabb);
+                }
+            }
+
+            m_AABB = m_Nodes[0].aabb;
+            ComputeSAHCost();
+
+            // Wide nodes copy child bounds, so they are collapsed again from refitted binary nodes
+            bool quantize = !m_QuantizedNodes.empty();
+            if (quantize || !m_WideNodes.empty()) {
+                m_WideNodes.clear();
+                m_QuantizedNodes.clear();
+                MakeWideHierarchy(quantize);
+            }
+        });
     }
 
     //! Performs localray-bvh intersection
     inline bool Hit(const Ray &ray, float tMin, float tMax, HitPayload &payload) const noexcept {
-        const int TREE_DEPTH = 1024;
+        return Hit(ray, tMin, tMax, payload, TraversalStack::Get(m_StackSize));
+    }
+
+    //! Performs localray-bvh intersection using ```GetStackSize()``` entries of ```stack```
+    inline bool Hit(const Ray &ray, float tMin, float tMax, HitPayload &payload, TraversalEntry *stack) const noexcept {
+        if (!m_QuantizedNodes.empty()) {
+            return HitWide(m_QuantizedNodes, ray, tMin, tMax, payload, stack);
+        }
+
+        if (!m_WideNodes.empty()) {
+            return HitWide(m_WideNodes, ray, tMin, tMax, payload, stack);
+        }
+
+        return HitSubtree(0, ray, tMin, tMax, payload, stack);
+    }
 
-        int nodeIndex = 1;
-        int nodeIndices[TREE_DEPTH];
+    //! Performs packet-bvh intersection of lanes in ```mask``` using ```GetStackSize()``` entries of ```stack```. Lanes left alone in a subtree continue as single rays. Returns mask of lanes that hit
+    template<int Width>
+    inline int Hit(const RayPacket<Width> &packet, int mask, float tMin, float *tMax, HitPayload *payloads, TraversalEntry *stack) const noexcept {
+        int nodeIndex = 0;
+        int nodeMask = mask;
         int stackPointer = 1;
 
-        bool anyHit = false;
+        int hitMask = 0;
         while (stackPointer > 0) {
+            if (RayPacket<Width>::CountLanes(nodeMask) == 1) {
+                int lane = std::countr_zero(static_cast<unsigned>(nodeMask));
+                if (HitSubtree(nodeIndex, packet.rays[lane], tMin, tMax[lane], payloads[lane], stack + stackPointer)) {
+                    hitMask |= nodeMask;
+                    tMax[lane] = Math::Min(tMax[lane], payloads[lane].t);
+                }
+
+                --stackPointer;
+                nodeIndex = stack[stackPointer].index;
+                nodeMask = stack[stackPointer].count;
+                continue;
+            }
+
             if (m_Nodes[nodeIndex].IsLeaf()) {
-                int hittableIndex = -m_Nodes[nodeIndex].index;
-                anyHit |= m_Hittables[hittableIndex]->Hit(ray, tMin, tMax, payload);
-                tMax = Math::Min(tMax, payload.t);
-                
-                nodeIndex = nodeIndices[--stackPointer];
+                for (int lanes = nodeMask; lanes != 0; lanes &= lanes - 1) {
+                    int lane = std::countr_zero(static_cast<unsigned>(lanes));
+                    if (HitLeaf(-m_Nodes[nodeIndex].index, m_Nodes[nodeIndex].count, packet.rays[lane], tMin, tMax[lane], payloads[lane])) {
+                        hitMask |= 1 << lane;
+                        tMax[lane] = Math::Min(tMax[lane], payloads[lane].t);
+                    }
+                }
+
+                --stackPointer;
+                nodeIndex = stack[stackPointer].index;
+                nodeMask = stack[stackPointer].count;
+                continue;
+            }
+
+            int closestIndex = nodeIndex + 1;
+            int furthestIndex = m_Nodes[nodeIndex].index;
+
+            float closestT, furthestT;
+            int closestMask = packet.Intersect(m_Nodes[closestIndex].aabb, tMin, tMax, nodeMask, closestT);
+            int furthestMask = packet.Intersect(m_Nodes[furthestIndex].aabb, tMin, tMax, nodeMask, furthestT);
+
+            if (closestT > furthestT) {
+                std::swap(closestT, furthestT);
+                std::swap(closestIndex, furthestIndex);
+                std::swap(closestMask, furthestMask);
+            }
+
+            if (closestMask == 0) {
+                --stackPointer;
+                nodeIndex = stack[stackPointer].index;
+                nodeMask = stack[stackPointer].count;
+                continue;
+            }
+
+            nodeIndex = closestIndex;
+            nodeMask = closestMask;
+
+            if (furthestMask != 0) {
+                // Lane mask of packet entry is kept in its count
+                stack[stackPointer++] = {furthestIndex, furthestMask, furthestT};
+            }
+        }
+
+        return hitMask;
+    }
+
+    //! Performs localray-bvh occlusion test. Stops at first hit in [tMin, tMax]
+    inline bool Occluded(const Ray &ray, float tMin, float tMax) const noexcept {
+        return Occluded(ray, tMin, tMax, TraversalStack::Get(m_StackSize));
+    }
+
+    //! Performs localray-bvh occlusion test using ```GetStackSize()``` entries of ```stack```
+    inline bool Occluded(const Ray &ray, float tMin, float tMax, TraversalEntry *stack) const noexcept {
+        if (!m_QuantizedNodes.empty()) {
+            return OccludedWide(m_QuantizedNodes, ray, tMin, tMax, stack);
+        }
+
+        if (!m_WideNodes.empty()) {
+            return OccludedWide(m_WideNodes, ray, tMin, tMax, stack);
+        }
+
+        int nodeIndex = 0;
+        int stackPointer = 1;
+
+        while (stackPointer > 0) {
+            if (m_Nodes[nodeIndex].IsLeaf()) {
+                if (OccludedLeaf(-m_Nodes[nodeIndex].index, m_Nodes[nodeIndex].count, ray, tMin, tMax)) {
+                    return true;
+                }
+
+                nodeIndex = stack[--stackPointer].index;
                 continue;
             }
 
-            int closestIndex = m_Nodes[nodeIndex].index;
-            int furthestIndex = m_Nodes[nodeIndex].index | 1;
+            int closestIndex = nodeIndex + 1;
+            int furthestIndex = m_Nodes[nodeIndex].index;
 
             float closestT = m_Nodes[closestIndex].aabb.Intersect(ray, tMin, tMax);
             float furtherT = m_Nodes[furthestIndex].aabb.Intersect(ray, tMin, tMax);
@@ -71,18 +285,18 @@ public:
             }
 
             if (closestT == Math::Constants::Infinity<float>) {
-                nodeIndex = nodeIndices[--stackPointer];
+                nodeIndex = stack[--stackPointer].index;
                 continue;
             }
 
             nodeIndex = closestIndex;
 
             if (furtherT != Math::Constants::Infinity<float>) {
-                nodeIndices[stackPointer++] = furthestIndex;
+                stack[stackPointer++].index = furthestIndex;
             }
         }
 
-        return anyHit;
+        return false;
     }
 
     //! Returns AABB of all objects
@@ -90,71 +304,1829 @@ public:
         return m_AABB;
     }
 
+    //! Returns build time, SAH cost and depth of the tree
+    constexpr const BuildStatistics& GetBuildStatistics() const noexcept {
+        return m_BuildStatistics;
+    }
+
+    //! Returns ratio of current SAH cost to the cost right after build. Grows as refits stretch nodes over moved hittables
+    constexpr float GetSAHDegradation() const noexcept {
+        return m_BuiltSAHCost > 0.f ? m_BuildStatistics.sahCost / m_BuiltSAHCost : 1.f;
+    }
+
+    //! Traces ```ray``` through binary nodes like closest hit traversal and counts visited nodes and tested hittables. Used to compare builders
+    inline TraversalStatistics MeasureTraversal(const Ray &ray, float tMin, float tMax) const noexcept {
+        TraversalStatistics statistics;
+        HitPayload payload;
+        payload.t = Math::Constants::Infinity<float>;
+        HitSubtree<true>(0, ray, tMin, tMax, payload, TraversalStack::Get(m_StackSize), &statistics);
+        return statistics;
+    }
+
+    //! Returns number of stack entries traversal of this tree can use
+    constexpr int GetStackSize() const noexcept {
+        return m_StackSize;
+    }
+
+    //! Writes tree to ```os``` under ```key```. Hittables are stored as indices into ```hittables``` the tree was built over, so Deserialize can rebind them
+    inline void Serialize(std::ostream &os, std::uint64_t key, std::span<IHittable* const> hittables) const noexcept {
+        std::unordered_map<const IHittable*, std::int32_t> hittableIndices;
+        hittableIndices.reserve(hittables.size());
+        for (int i = 0; i < static_cast<int>(hittables.size()); ++i) {
+            hittableIndices[hittables[i]] = i;
+        }
+
+        std::vector<std::int32_t> references(m_Hittables.size());
+        for (int i = 0; i < static_cast<int>(m_Hittables.size()); ++i) {
+            references[i] = hittableIndices[m_Hittables[i]];
+        }
+
+        SerializedHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, SerializedMagic, sizeof(header.magic));
+        header.version = SerializedVersion;
+        header.key = key;
+        header.hittableCount = static_cast<std::int32_t>(hittables.size());
+        header.referenceCount = static_cast<std::int32_t>(references.size());
+        header.nodeCount = static_cast<std::int32_t>(m_Nodes.size());
+        header.maxLeafSize = m_MaxLeafSize;
+        header.traversalCost = m_TraversalCost;
+        header.builtSAHCost = m_BuiltSAHCost;
+        header.wideNodes = !m_WideNodes.empty() || !m_QuantizedNodes.empty();
+        header.quantizedNodes = !m_QuantizedNodes.empty();
+
+        os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        os.write(reinterpret_cast<const char*>(m_Nodes.data()), m_Nodes.size() * sizeof(Node));
+        os.write(reinterpret_cast<const char*>(references.data()), references.size() * sizeof(std::int32_t));
+    }
+
+    //! Restores tree written by Serialize over the same ```hittables```. Returns nullptr if ```data``` is malformed or was written under other key
+    inline static BVH* Deserialize(std::span<const std::byte> data, std::uint64_t key, std::span<IHittable* const> hittables) noexcept {
+        SerializedHeader header;
+        if (data.size() < sizeof(header)) {
+            return nullptr;
+        }
+
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (std::memcmp(header.magic, SerializedMagic, sizeof(header.magic)) != 0 || header.version != SerializedVersion || header.key != key) {
+            return nullptr;
+        }
+
+        if (header.hittableCount != static_cast<std::int32_t>(hittables.size()) || header.referenceCount < 0 || header.nodeCount <= 0) {
+            return nullptr;
+        }
+
+        std::size_t nodeBytes = static_cast<std::size_t>(header.nodeCount) * sizeof(Node);
+        std::size_t referenceBytes = static_cast<std::size_t>(header.referenceCount) * sizeof(std::int32_t);
+        if (data.size() != sizeof(header) + nodeBytes + referenceBytes) {
+            return nullptr;
+        }
+
+        BVH *bvh = new BVH();
+        bvh->m_MaxLeafSize = Math::Clamp(header.maxLeafSize, 1, MaxLeafSize);
+        bvh->m_TraversalCost = header.traversalCost;
+
+        bool valid = false;
+        double loadTime = Timer::MeasureInMillis([&]() {
+            const std::byte *source = data.data() + sizeof(header);
+            bvh->m_Nodes.resize(header.nodeCount);
+            std::memcpy(bvh->m_Nodes.data(), source, nodeBytes);
+            source += nodeBytes;
+
+            bvh->m_Hittables.resize(header.referenceCount);
+            for (int i = 0; i < header.referenceCount; ++i) {
+                std::int32_t index;
+                std::memcpy(&index, source + i * sizeof(index), sizeof(index));
+                bvh->m_Hittables[i] = index >= 0 && index < header.hittableCount ? hittables[index] : nullptr;
+            }
+
+            valid = bvh->HasValidNodes();
+            if (!valid) {
+                return;
+            }
+
+            bvh->GatherPrimitives();
+            bvh->m_AABB = bvh->m_Nodes[0].aabb;
+            bvh->ComputeSAHCost();
+            bvh->m_BuiltSAHCost = header.builtSAHCost;
+
+            if (header.wideNodes) {
+                bvh->MakeWideHierarchy(header.quantizedNodes);
+            }
+        });
+
+        if (!valid) {
+            delete bvh;
+            return nullptr;
+        }
+
+        bvh->m_BuildStatistics.buildTime = loadTime;
+        bvh->m_BuildStatistics.loadedFromCache = true;
+
+        return bvh;
+    }
+
 private:
-    inline void MakeHierarchySAH(int index, int low, int high, int &usedNodes) noexcept {
-        if (low + 1 == high) {
-            m_Nodes[index] = Node(-low, m_Hittables[low]->GetBoundingBox());
-            return;
+    constexpr static char SerializedMagic[4] = {'P', 'B', 'V', 'H'};
+    //! Bumped whenever layout of header or nodes changes, so stale cache files are rebuilt
+    constexpr static std::uint32_t SerializedVersion = 1;
+
+    //! Header of serialized tree, followed by binary nodes and indices of hittables in leaf order. Wide nodes are collapsed again on load
+    struct SerializedHeader {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t key;
+        std::int32_t hittableCount;
+        std::int32_t referenceCount;
+        std::int32_t nodeCount;
+        std::int32_t maxLeafSize;
+        float traversalCost;
+        float builtSAHCost;
+        std::uint8_t wideNodes;
+        std::uint8_t quantizedNodes;
+    };
+
+    //! Left empty for Deserialize
+    inline BVH() noexcept = default;
+
+    //! Checks that loaded children point forward and leaves stay inside hittables, so traversal of corrupted data can neither loop nor read out of arrays
+    inline bool HasValidNodes() const noexcept {
+        int nodeCount = static_cast<int>(m_Nodes.size());
+        int referenceCount = static_cast<int>(m_Hittables.size());
+
+        for (const IHittable *hittable : m_Hittables) {
+            if (hittable == nullptr) {
+                return false;
+            }
         }
-        
-        int n = high - low;
-        std::vector<AABB> pref(n + 1);
-        std::vector<AABB> suff(n + 1);
 
-        float minValue = Math::Constants::Infinity<float>;
-        int mid = -1;
-        int axis = -1;
+        for (int nodeIndex = 0; nodeIndex < nodeCount; ++nodeIndex) {
+            const Node &node = m_Nodes[nodeIndex];
+            if (node.IsLeaf()) {
+                if (node.count < 0 || node.count > MaxLeafSize || node.index < node.count - referenceCount) {
+                    return false;
+                }
+            } else if (node.index <= nodeIndex + 1 || node.index >= nodeCount) {
+                return false;
+            }
+        }
 
-        for (int d = 0; d < 3; ++d) {
-            std::sort(m_Hittables.begin() + low, m_Hittables.begin() + high, GetCentroidComparatorByAxis(d));
+        return true;
+    }
 
-            pref[0] = AABB::Empty();
-            for (int i = 0; i < n; ++i) {
-                pref[i + 1] = AABB(pref[i], m_Hittables[i + low]->GetBoundingBox());
+    inline void Build(const BVHBuildOptions &options, std::span<const AABB> bounds) noexcept {
+        int n = static_cast<int>(m_Hittables.size());
+        // Slot 1 holds the root even if there is nothing to build
+        m_Nodes.resize(Math::Max(2 * n, 2));
+
+        m_BuildStatistics.buildTime = Timer::MeasureInMillis([this, n, &options, bounds]() {
+            if (n == 0) {
+                m_Nodes[1] = Node(0, AABB::Empty());
+            } else if (options.method == BVHBuildMethod::SweepSAH) {
+                int usedNodes = 1;
+                MakeHierarchySAH(1, 0, n, usedNodes);
+            } else if (options.method == BVHBuildMethod::SpatialSAH) {
+                MakeHierarchySpatial(n, options);
+            } else if (options.method == BVHBuildMethod::LinearMorton) {
+                MakeHierarchyLinear(n, options, bounds);
+            } else {
+                MakeHierarchyBinned(n, options, bounds);
             }
 
-            suff[n] = AABB::Empty();
-            for (int i = n - 1; i >= 0; --i) {
-                suff[i] = AABB(m_Hittables[i + low]->GetBoundingBox(), suff[i + 1]);
+            ReorderDepthFirst();
+
+            // Hittables built from captured bounds may be edited right now
+            if (bounds.empty()) {
+                GatherPrimitives();
             }
+        });
 
-            float minValueAlongAxis = Math::Constants::Infinity<float>;
-            int index = -1;
-            for (int i = 0; i < n; ++i) {
-                float value = pref[i + 1].GetSurfaceArea() * (float)(i + 1) + suff[i + 1].GetSurfaceArea() * (float)(n - i - 1);
-                if (value < minValueAlongAxis) {
-                    minValueAlongAxis = value;
-                    index = i + low;
+        m_AABB = m_Nodes[0].aabb;
+        ComputeSAHCost();
+        m_BuiltSAHCost = m_BuildStatistics.sahCost;
+
+        if (options.wideNodes || options.quantizedNodes) {
+            MakeWideHierarchy(options.quantizedNodes);
+        }
+    }
+
+    //! Traversal of single ray starting at node ```rootIndex```. Visited nodes and tested hittables are counted to ```statistics``` if ```Measure``` is set
+    template<bool Measure = false>
+    inline bool HitSubtree(int rootIndex, const Ray &ray, float tMin, float tMax, HitPayload &payload, TraversalEntry *stack, TraversalStatistics *statistics = nullptr) const noexcept {
+        int nodeIndex = rootIndex;
+        int stackPointer = 1;
+
+        bool anyHit = false;
+        while (stackPointer > 0) {
+            if constexpr (Measure) {
+                ++statistics->nodeCount;
+            }
+
+            if (m_Nodes[nodeIndex].IsLeaf()) {
+                int first = -m_Nodes[nodeIndex].index;
+                if constexpr (Measure) {
+                    statistics->hittableCount += m_Nodes[nodeIndex].count;
+                }
+
+                if (HitLeaf(first, m_Nodes[nodeIndex].count, ray, tMin, tMax, payload)) {
+                    anyHit = true;
+                    tMax = Math::Min(tMax, payload.t);
                 }
+                
+                nodeIndex = stack[--stackPointer].index;
+                continue;
             }
 
-            if (minValueAlongAxis < minValue) {
-                minValue = minValueAlongAxis;
-                mid = index + 1;
-                axis = d;
+            int closestIndex = nodeIndex + 1;
+            int furthestIndex = m_Nodes[nodeIndex].index;
+
+            float closestT = m_Nodes[closestIndex].aabb.Intersect(ray, tMin, tMax);
+            float furtherT = m_Nodes[furthestIndex].aabb.Intersect(ray, tMin, tMax);
+
+            if (closestT > furtherT) {
+                std::swap(closestT, furtherT);
+                std::swap(closestIndex, furthestIndex);
+            }
+
+            if (closestT == Math::Constants::Infinity<float>) {
+                nodeIndex = stack[--stackPointer].index;
+                continue;
+            }
+
+            nodeIndex = closestIndex;
+
+            if (furtherT != Math::Constants::Infinity<float>) {
+                stack[stackPointer++].index = furthestIndex;
             }
         }
 
-        std::sort(m_Hittables.begin() + low, m_Hittables.begin() + high, GetCentroidComparatorByAxis(axis));
-        
-        int leftIndex = ++usedNodes;
-        int rightIndex = ++usedNodes;
-        MakeHierarchySAH(leftIndex, low, mid, usedNodes);
-        MakeHierarchySAH(rightIndex, mid, high, usedNodes);
+        return anyHit;
+    }
 
-        m_Nodes[index] = Node(leftIndex, m_Nodes[leftIndex], m_Nodes[rightIndex]);
+    //! Tests ```count``` hittables of leaf starting at ```first```. Runs of gathered triangles and spheres are tested without virtual calls, hittable is looked up for the closest one only
+    inline bool HitLeaf(int first, int count, const Ray &ray, float tMin, float tMax, HitPayload &payload) const noexcept {
+        if (m_Primitives.IsEmpty()) {
+            return HitHittables(first, first + count, ray, tMin, tMax, payload);
+        }
+
+        bool anyHit = false;
+        for (int runFirst = first, last = first + count; runFirst < last;) {
+            int runLast = m_Primitives.GetRunEnd(runFirst, last);
+
+            float t = 0.f, u = 0.f, v = 0.f;
+            int index = -1;
+            switch (m_Primitives.GetType(runFirst)) {
+                case ShapeType::Triangle:
+                    index = m_Primitives.HitTriangles(ray, runFirst, runLast, tMin, tMax, t, u, v);
+                    if (index >= 0) {
+                        payload.barycentrics = Math::Vector2f(u, v);
+                    }
+                    break;
+                case ShapeType::Sphere:
+                    index = m_Primitives.HitSpheres(ray, runFirst, runLast, tMin, tMax, t);
+                    break;
+                default:
+                    if (HitHittables(runFirst, runLast, ray, tMin, tMax, payload)) {
+                        anyHit = true;
+                        tMax = payload.t;
+                    }
+                    break;
+            }
+
+            if (index >= 0) {
+                payload.t = t;
+                payload.hittable = m_Hittables[index];
+                anyHit = true;
+                tMax = t;
+            }
+
+            runFirst = runLast;
+        }
+
+        return anyHit;
     }
 
-    inline std::function<bool(const IHittable*, const IHittable*)> GetCentroidComparatorByAxis(int axis) const noexcept {
-        return [axis](const IHittable * const a, const IHittable * const b) {
-            return a->GetCentroid()[axis] < b->GetCentroid()[axis];
-        };
+    //! Tests hittables in [first, last) through virtual calls
+    inline bool HitHittables(int first, int last, const Ray &ray, float tMin, float tMax, HitPayload &payload) const noexcept {
+        bool anyHit = false;
+        for (int i = first; i < last; ++i) {
+            if (m_Hittables[i]->Hit(ray, tMin, tMax, payload)) {
+                anyHit = true;
+                tMax = Math::Min(tMax, payload.t);
+            }
+        }
+
+        return anyHit;
+    }
+
+    //! Occlusion test of ```count``` hittables of leaf starting at ```first```
+    inline bool OccludedLeaf(int first, int count, const Ray &ray, float tMin, float tMax) const noexcept {
+        if (m_Primitives.IsEmpty()) {
+            return OccludedHittables(first, first + count, ray, tMin, tMax);
+        }
+
+        for (int runFirst = first, last = first + count; runFirst < last;) {
+            int runLast = m_Primitives.GetRunEnd(runFirst, last);
+
+            bool occluded;
+            switch (m_Primitives.GetType(runFirst)) {
+                case ShapeType::Triangle:
+                    occluded = m_Primitives.OccludedTriangles(ray, runFirst, runLast, tMin, tMax);
+                    break;
+                case ShapeType::Sphere:
+                    occluded = m_Primitives.OccludedSpheres(ray, runFirst, runLast, tMin, tMax);
+                    break;
+                default:
+                    occluded = OccludedHittables(runFirst, runLast, ray, tMin, tMax);
+                    break;
+            }
+
+            if (occluded) {
+                return true;
+            }
+
+            runFirst = runLast;
+        }
+
+        return false;
+    }
+
+    //! Occlusion test of hittables in [first, last) through virtual calls
+    inline bool OccludedHittables(int first, int last, const Ray &ray, float tMin, float tMax) const noexcept {
+        for (int i = first; i < last; ++i) {
+            if (m_Hittables[i]->Occluded(ray, tMin, tMax)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    //! Groups hittables of every leaf by shape type and copies geometry of triangles and spheres into ```m_Primitives```, so leaves test runs of one type in batches
+    inline void GatherPrimitives() noexcept {
+        int referenceCount = static_cast<int>(m_Hittables.size());
+        std::vector<std::pair<ShapeData, const IHittable*>> shapes(referenceCount);
+        for (int i = 0; i < referenceCount; ++i) {
+            shapes[i] = {m_Hittables[i]->GetShapeData(), m_Hittables[i]};
+        }
+
+        // Stable order keeps leaves of single type as they are, so regathering after refit moves nothing
+        for (const Node &node : m_Nodes) {
+            if (node.IsLeaf() && node.count > 1) {
+                auto leafBegin = shapes.begin() - node.index;
+                std::stable_sort(leafBegin, leafBegin + node.count, [](const auto &a, const auto &b) {
+                    return a.first.type < b.first.type;
+                });
+            }
+        }
+
+        std::vector<ShapeData> data(referenceCount);
+        for (int i = 0; i < referenceCount; ++i) {
+            m_Hittables[i] = shapes[i].second;
+            data[i] = shapes[i].first;
+        }
+
+        m_Primitives.Build(data);
+    }
+
+    //! Quantized wide nodes store leaf sizes in one byte
+    constexpr static int MaxLeafSize = 255;
+
+    //! Traversal of 4-wide tree. Hit children are visited in order of entry distance, entries behind closer hit are skipped
+    template<typename WideNodeType>
+    inline bool HitWide(const std::vector<WideNodeType> &wideNodes, const Ray &ray, float tMin, float tMax, HitPayload &payload, TraversalEntry *stack) const noexcept {
+        WideRay wideRay(ray);
+
+        stack[0] = {0, 0, tMin};
+        int stackPointer = 1;
+
+        bool anyHit = false;
+        while (stackPointer > 0) {
+            TraversalEntry entry = stack[--stackPointer];
+            if (entry.t > tMax) {
+                continue;
+            }
+
+            if (entry.count > 0) {
+                if (HitLeaf(-entry.index, entry.count, ray, tMin, tMax, payload)) {
+                    anyHit = true;
+                    tMax = Math::Min(tMax, payload.t);
+                }
+                continue;
+            }
+
+            const WideNodeType &node = wideNodes[entry.index];
+
+            alignas(16) float tNear[WideNode::Width];
+            int mask = node.Intersect(wideRay, tMin, tMax, tNear);
+
+            // Children are pushed from furthest to closest, so that closest one is popped first
+            int first = stackPointer;
+            for (; mask != 0; mask &= mask - 1) {
+                int slot = std::countr_zero(static_cast<unsigned>(mask));
+                TraversalEntry child = {node.children[slot], node.counts[slot], tNear[slot]};
+
+                int position = stackPointer++;
+                for (; position > first && stack[position - 1].t < child.t; --position) {
+                    stack[position] = stack[position - 1];
+                }
+                stack[position] = child;
+            }
+        }
+
+        return anyHit;
+    }
+
+    //! Occlusion test of 4-wide tree. Any hit ends traversal, so children are not ordered
+    template<typename WideNodeType>
+    inline bool OccludedWide(const std::vector<WideNodeType> &wideNodes, const Ray &ray, float tMin, float tMax, TraversalEntry *stack) const noexcept {
+        WideRay wideRay(ray);
+
+        stack[0].index = 0;
+        int stackPointer = 1;
+
+        while (stackPointer > 0) {
+            const WideNodeType &node = wideNodes[stack[--stackPointer].index];
+
+            alignas(16) float tNear[WideNode::Width];
+            for (int mask = node.Intersect(wideRay, tMin, tMax, tNear); mask != 0; mask &= mask - 1) {
+                int slot = std::countr_zero(static_cast<unsigned>(mask));
+                if (!node.IsLeaf(slot)) {
+                    stack[stackPointer++].index = node.children[slot];
+                    continue;
+                }
+
+                if (OccludedLeaf(-node.children[slot], node.counts[slot], ray, tMin, tMax)) {
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    //! Collapses binary tree into 4-wide nodes, quantized ones if ```quantize``` is set. Binary nodes stay for packet traversal
+    inline void MakeWideHierarchy(bool quantize) noexcept {
+        m_WideNodes.reserve(m_Nodes.size() / 2 + 1);
+
+        int depth = 0;
+        if (m_Nodes[0].IsLeaf()) {
+            m_WideNodes.emplace_back();
+            m_WideNodes[0].SetChild(0, m_Nodes[0].aabb, m_Nodes[0].index, m_Nodes[0].count);
+            depth = 1;
+        } else {
+            depth = CollapseNode(0);
+        }
+
+        if (quantize) {
+            m_QuantizedNodes.reserve(m_WideNodes.size());
+            for (const auto &node : m_WideNodes) {
+                m_QuantizedNodes.emplace_back(node);
+            }
+            m_WideNodes.clear();
+        }
+        m_WideNodes.shrink_to_fit();
+
+        int wideNodeCount = static_cast<int>(m_WideNodes.size() + m_QuantizedNodes.size());
+        m_BuildStatistics.wideNodeCount = wideNodeCount;
+        m_BuildStatistics.wideDepth = depth;
+
+        // Every visited wide node replaces its entry with up to ```WideNode::Width``` children
+        m_StackSize = Math::Max(m_StackSize, depth * (WideNode::Width - 1) + 1);
+        m_BuildStatistics.memoryFootprint += m_WideNodes.size() * sizeof(WideNode) + m_QuantizedNodes.size() * sizeof(QuantizedWideNode);
+    }
+
+    //! Makes wide node from internal binary node ```nodeIndex``` by opening child with largest area until all slots are used. Returns depth of wide subtree
+    inline int CollapseNode(int nodeIndex) noexcept {
+        int children[WideNode::Width] = {nodeIndex + 1, m_Nodes[nodeIndex].index};
+        int childCount = 2;
+
+        while (childCount < WideNode::Width) {
+            int largest = -1;
+            for (int i = 0; i < childCount; ++i) {
+                if (!m_Nodes[children[i]].IsLeaf() && (largest == -1 || m_Nodes[children[i]].aabb.GetSurfaceArea() > m_Nodes[children[largest]].aabb.GetSurfaceArea())) {
+                    largest = i;
+                }
+            }
+
+            if (largest == -1) {
+                break;
+            }
+
+            int opened = children[largest];
+            children[largest] = opened + 1;
+            children[childCount++] = m_Nodes[opened].index;
+        }
+
+        int wideIndex = static_cast<int>(m_WideNodes.size());
+        m_WideNodes.emplace_back();
+
+        int depth = 1;
+        for (int i = 0; i < childCount; ++i) {
+            const Node &child = m_Nodes[children[i]];
+            if (child.IsLeaf()) {
+                m_WideNodes[wideIndex].SetChild(i, child.aabb, child.index, child.count);
+            } else {
+                int childWideIndex = static_cast<int>(m_WideNodes.size());
+                depth = Math::Max(depth, CollapseNode(children[i]) + 1);
+                m_WideNodes[wideIndex].SetChild(i, child.aabb, childWideIndex, 0);
+            }
+        }
+
+        return depth;
+    }
+
+    inline void MakeHierarchySAH(int index, int low, int high, int &usedNodes) noexcept {
+        if (low + 1 == high) {
+            m_Nodes[index] = Node(-low, m_Hittables[low]->GetBoundingBox(), 1);
+            return;
+        }
+
+
+        int n = high - low;
+        std::vector<AABB> pref(n + 1);
+        std::vector<AABB> suff(n + 1);
+        std::vector<AABB> bounds(n);
+
+        float minValue = Math::Constants::Infinity<float>;
+        int mid = -1;
+        int axis = -1;
+
+        for (int d = 0; d < 3; ++d) {
+            SortByCentroid(low, high, d, bounds);
+
+            pref[0] = AABB::Empty();
+            for (int i = 0; i < n; ++i) {
+                pref[i + 1] = AABB(pref[i], bounds[i]);
+            }
+
+            suff[n] = AABB::Empty();
+            for (int i = n - 1; i >= 0; --i) {
+                suff[i] = AABB(bounds[i], suff[i + 1]);
+            }
+
+            float minValueAlongAxis = Math::Constants::Infinity<float>;
+            int index = -1;
+            for (int i = 0; i < n; ++i) {
+                float value = pref[i + 1].GetSurfaceArea() * (float)(i + 1) + suff[i + 1].GetSurfaceArea() * (float)(n - i - 1);
+                if (value < minValueAlongAxis) {
+                    minValueAlongAxis = value;
+                    index = i + low;
+                }
+            }
+
+            if (minValueAlongAxis < minValue) {
+                minValue = minValueAlongAxis;
+                mid = index + 1;
+                axis = d;
+            }
+        }
+
+        if (IsLeafCheaper(n, pref[n], minValue)) {
+            m_Nodes[index] = Node(-low, pref[n], n);
+            return;
+        }
+
+        SortByCentroid(low, high, axis, bounds);
+
+        int leftIndex = ++usedNodes;
+        int rightIndex = ++usedNodes;
+        MakeHierarchySAH(leftIndex, low, mid, usedNodes);
+        MakeHierarchySAH(rightIndex, mid, high, usedNodes);
+
+        m_Nodes[index] = Node(leftIndex, m_Nodes[leftIndex], m_Nodes[rightIndex]);
+    }
+
+    //! Sorts hittables of [low, high) by centroid along ```axis``` and writes their bounds in new order to ```bounds```. Each hittable is asked once, since polygons compute centroid and bounds from mesh
+    inline void SortByCentroid(int low, int high, int axis, std::vector<AABB> &bounds) noexcept {
+        int n = high - low;
+        std::vector<std::pair<float, const IHittable*>> keys(n);
+        for (int i = 0; i < n; ++i) {
+            keys[i] = {m_Hittables[low + i]->GetCentroid()[axis], m_Hittables[low + i]};
+        }
+
+        std::sort(keys.begin(), keys.end(), [](const auto &a, const auto &b) {
+            return a.first < b.first;
+        });
+
+        for (int i = 0; i < n; ++i) {
+            m_Hittables[low + i] = keys[i].second;
+            bounds[i] = keys[i].second->GetBoundingBox();
+        }
+    }
+
+    constexpr static int BinCount = 16;
+
+    //! Ranges larger than this are built by several threads
+    constexpr static int ParallelBuildThreshold = 4096;
+
+    //! Bounds of hittable cached for binned build
+    struct BuildPrimitive {
+        AABB aabb;
+        Math::Vector3f centroid;
+        int index;
+    };
+
+    //! Bounds and number of primitives which centroids fall into one bin
+    struct Bin {
+        AABB aabb = AABB::Empty();
+        int count = 0;
+    };
+
+    //! Bounds of primitives and of their centroids. Can be computed by parts and merged
+    struct RangeBounds {
+        AABB bounds = AABB::Empty();
+        AABB centroidBounds = AABB::Empty();
+
+        inline void Merge(const RangeBounds &other) noexcept {
+            bounds = AABB(bounds, other.bounds);
+            centroidBounds = AABB(centroidBounds, other.centroidBounds);
+        }
+    };
+
+    //! Bins of all three axes. Can be filled by parts and merged
+    struct Bins {
+        Bin bins[3][BinCount];
+
+        inline void Merge(const Bins &other) noexcept {
+            for (int axis = 0; axis < 3; ++axis) {
+                for (int b = 0; b < BinCount; ++b) {
+                    bins[axis][b].aabb = AABB(bins[axis][b].aabb, other.bins[axis][b].aabb);
+                    bins[axis][b].count += other.bins[axis][b].count;
+                }
+            }
+        }
+    };
+
+    //! Range of primitives that becomes subtree rooted at ```index```
+    struct BuildTask {
+        int index;
+        int low, high;
+    };
+
+    //! Shared state of workers building subtrees concurrently
+    struct BuildQueue {
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::vector<BuildTask> tasks;
+        int busyCount = 0;
+    };
+
+    //! Builds tree by evaluating SAH only at bin borders. Primitives are partitioned in place, so nodes do not allocate
+    inline void MakeHierarchyBinned(int n, const BVHBuildOptions &options, std::span<const AABB> bounds) noexcept {
+        std::vector<BuildPrimitive> primitives(n);
+        std::atomic<int> usedNodes = 2;
+
+        std::unique_lock<std::mutex> poolLock;
+        ThreadPool *threadPool = AcquireThreadPool(n, options, poolLock);
+        if (threadPool == nullptr) {
+            for (int i = 0; i < n; ++i) {
+                primitives[i] = MakeBuildPrimitive(i, bounds);
+            }
+
+            MakeHierarchyBinned(primitives.data(), {1, 0, n}, usedNodes);
+        } else {
+            int threadCount = threadPool->GetThreadCount();
+            threadPool->Dispatch([this, &primitives, n, threadCount, bounds](int threadIndex) {
+                for (int i = n * threadIndex / threadCount; i < n * (threadIndex + 1) / threadCount; ++i) {
+                    primitives[i] = MakeBuildPrimitive(i, bounds);
+                }
+            });
+            threadPool->Wait();
+
+            MakeHierarchyBinnedParallel(*threadPool, primitives, n, usedNodes);
+        }
+
+        std::vector<const IHittable*> hittables(n);
+        for (int i = 0; i < n; ++i) {
+            hittables[i] = m_Hittables[primitives[i].index];
+        }
+        m_Hittables = std::move(hittables);
+    }
+
+    //! Returns pool for parallel build of ```n``` hittables or nullptr if it runs serially. Shared pool stays locked by ```lock``` until build ends, so concurrent builds never share workers
+    inline static ThreadPool* AcquireThreadPool(int n, const BVHBuildOptions &options, std::unique_lock<std::mutex> &lock) noexcept {
+        if (n < ParallelBuildThreshold || !options.parallelBuild) {
+            return nullptr;
+        }
+
+        ThreadPool *threadPool = options.threadPool;
+        if (threadPool == nullptr) {
+            static std::mutex s_Mutex;
+            static ThreadPool s_ThreadPool(Math::Max(static_cast<int>(std::thread::hardware_concurrency()), 1));
+
+            lock = std::unique_lock<std::mutex>(s_Mutex, std::try_to_lock);
+            if (!lock.owns_lock()) {
+                return nullptr;
+            }
+            threadPool = &s_ThreadPool;
+        }
+
+        return threadPool->GetThreadCount() > 1 ? threadPool : nullptr;
+    }
+
+    //! Captured bounds stand for hittable ```i``` when given, their center is used as centroid
+    inline BuildPrimitive MakeBuildPrimitive(int i, std::span<const AABB> bounds) const noexcept {
+        if (bounds.empty()) {
+            return {m_Hittables[i]->GetBoundingBox(), m_Hittables[i]->GetCentroid(), i};
+        }
+
+        return {bounds[i], (bounds[i].min + bounds[i].max) * 0.5f, i};
+    }
+
+    inline void MakeHierarchyBinned(BuildPrimitive *primitives, const BuildTask &task, std::atomic<int> &usedNodes) noexcept {
+        int mid = SplitNode(primitives, task, usedNodes);
+        if (mid < 0) {
+            return;
+        }
+
+        int leftIndex = m_Nodes[task.index].index;
+        MakeHierarchyBinned(primitives, {leftIndex, task.low, mid}, usedNodes);
+        MakeHierarchyBinned(primitives, {leftIndex | 1, mid, task.high}, usedNodes);
+    }
+
+    //! Top levels split large ranges with all threads binning together. Once there are enough subtrees, threads take them from shared queue
+    inline void MakeHierarchyBinnedParallel(ThreadPool &threadPool, std::vector<BuildPrimitive> &primitives, int n, std::atomic<int> &usedNodes) noexcept {
+        int threadCount = threadPool.GetThreadCount();
+
+        BuildQueue queue;
+        queue.tasks.push_back({1, 0, n});
+
+        std::vector<BuildPrimitive> buffer(n);
+        while (static_cast<int>(queue.tasks.size()) < threadCount) {
+            auto largest = std::max_element(queue.tasks.begin(), queue.tasks.end(), [](const BuildTask &a, const BuildTask &b) {
+                return a.high - a.low < b.high - b.low;
+            });
+
+            BuildTask task = *largest;
+            if (task.high - task.low < ParallelBuildThreshold) {
+                break;
+            }
+            queue.tasks.erase(largest);
+
+            int mid = SplitNodeParallel(threadPool, primitives.data(), buffer.data(), task, usedNodes);
+            if (mid >= 0) {
+                int leftIndex = m_Nodes[task.index].index;
+                queue.tasks.push_back({leftIndex, task.low, mid});
+                queue.tasks.push_back({leftIndex | 1, mid, task.high});
+            }
+        }
+
+        // Largest subtrees first, so that small ones fill gaps at the end
+        std::sort(queue.tasks.begin(), queue.tasks.end(), [](const BuildTask &a, const BuildTask &b) {
+            return a.high - a.low < b.high - b.low;
+        });
+
+        threadPool.Dispatch([this, &queue, &primitives, &usedNodes](int) {
+            while (true) {
+                std::unique_lock<std::mutex> lock(queue.mutex);
+                queue.condition.wait(lock, [&queue]() {
+                    return !queue.tasks.empty() || queue.busyCount == 0;
+                });
+
+                if (queue.tasks.empty()) {
+                    return;
+                }
+
+                BuildTask task = queue.tasks.back();
+                queue.tasks.pop_back();
+                ++queue.busyCount;
+                lock.unlock();
+
+                // Large subtrees are split once more, so idle threads can steal their halves
+                if (task.high - task.low >= ParallelBuildThreshold) {
+                    int mid = SplitNode(primitives.data(), task, usedNodes);
+                    lock.lock();
+                    if (mid >= 0) {
+                        int leftIndex = m_Nodes[task.index].index;
+                        queue.tasks.push_back({leftIndex, task.low, mid});
+                        queue.tasks.push_back({leftIndex | 1, mid, task.high});
+                    }
+                } else {
+                    MakeHierarchyBinned(primitives.data(), task, usedNodes);
+                    lock.lock();
+                }
+
+                --queue.busyCount;
+                lock.unlock();
+                queue.condition.notify_all();
+            }
+        });
+        threadPool.Wait();
+    }
+
+    //! Writes node of ```task```. Returns index that separates children or -1 for leaf
+    inline int SplitNode(BuildPrimitive *primitives, const BuildTask &task, std::atomic<int> &usedNodes) noexcept {
+        if (task.low + 1 == task.high) {
+            m_Nodes[task.index] = Node(-task.low, primitives[task.low].aabb, 1);
+            return -1;
+        }
+
+        RangeBounds rangeBounds = ComputeRangeBounds(primitives, task.low, task.high);
+
+        Bins bins;
+        FillBins(primitives, task.low, task.high, rangeBounds.centroidBounds, bins);
+
+        auto [axis, split, splitCost] = FindBestSplit(bins);
+
+        if (IsLeafCheaper(task.high - task.low, rangeBounds.bounds, splitCost)) {
+            m_Nodes[task.index] = Node(-task.low, rangeBounds.bounds, task.high - task.low);
+            return -1;
+        }
+
+        int mid = (task.low + task.high) / 2;
+        if (axis != -1) {
+            float min = rangeBounds.centroidBounds.min[axis];
+            float scale = GetBinScale(rangeBounds.centroidBounds, axis);
+            auto it = std::partition(primitives + task.low, primitives + task.high, [axis, split, min, scale](const BuildPrimitive &primitive) {
+                return GetBinIndex(primitive.centroid[axis], min, scale) < split;
+            });
+            mid = static_cast<int>(it - primitives);
+        }
+
+        m_Nodes[task.index] = Node(usedNodes.fetch_add(2), rangeBounds.bounds);
+        return mid;
+    }
+
+    //! Same as SplitNode, but bounds, bins and partition are computed by all threads of ```threadPool```
+    inline int SplitNodeParallel(ThreadPool &threadPool, BuildPrimitive *primitives, BuildPrimitive *buffer, const BuildTask &task, std::atomic<int> &usedNodes) noexcept {
+        int threadCount = threadPool.GetThreadCount();
+        int count = task.high - task.low;
+        auto chunkBegin = [&task, count, threadCount](int threadIndex) {
+            return task.low + static_cast<int>(static_cast<std::int64_t>(count) * threadIndex / threadCount);
+        };
+
+        std::vector<RangeBounds> threadBounds(threadCount);
+        threadPool.Dispatch([this, primitives, &threadBounds, &chunkBegin](int threadIndex) {
+            threadBounds[threadIndex] = ComputeRangeBounds(primitives, chunkBegin(threadIndex), chunkBegin(threadIndex + 1));
+        });
+        threadPool.Wait();
+
+        RangeBounds rangeBounds;
+        for (const auto &bounds : threadBounds) {
+            rangeBounds.Merge(bounds);
+        }
+
+        std::vector<Bins> threadBins(threadCount);
+        threadPool.Dispatch([this, primitives, &threadBins, &chunkBegin, &rangeBounds](int threadIndex) {
+            FillBins(primitives, chunkBegin(threadIndex), chunkBegin(threadIndex + 1), rangeBounds.centroidBounds, threadBins[threadIndex]);
+        });
+        threadPool.Wait();
+
+        for (int i = 1; i < threadCount; ++i) {
+            threadBins[0].Merge(threadBins[i]);
+        }
+
+        auto [axis, split, splitCost] = FindBestSplit(threadBins[0]);
+
+        if (IsLeafCheaper(count, rangeBounds.bounds, splitCost)) {
+            m_Nodes[task.index] = Node(-task.low, rangeBounds.bounds, count);
+            return -1;
+        }
+
+        int mid = (task.low + task.high) / 2;
+        if (axis != -1) {
+            float min = rangeBounds.centroidBounds.min[axis];
+            float scale = GetBinScale(rangeBounds.centroidBounds, axis);
+            auto goesLeft = [axis, split, min, scale](const BuildPrimitive &primitive) {
+                return GetBinIndex(primitive.centroid[axis], min, scale) < split;
+            };
+
+            // Every thread counts its left primitives, then scatters its chunk to offsets given by prefix sums
+            std::vector<int> leftCounts(threadCount + 1, 0);
+            threadPool.Dispatch([primitives, &leftCounts, &chunkBegin, &goesLeft](int threadIndex) {
+                int leftCount = 0;
+                for (int i = chunkBegin(threadIndex); i < chunkBegin(threadIndex + 1); ++i) {
+                    leftCount += goesLeft(primitives[i]) ? 1 : 0;
+                }
+                leftCounts[threadIndex + 1] = leftCount;
+            });
+            threadPool.Wait();
+
+            for (int i = 0; i < threadCount; ++i) {
+                leftCounts[i + 1] += leftCounts[i];
+            }
+            mid = task.low + leftCounts[threadCount];
+
+            threadPool.Dispatch([primitives, buffer, &leftCounts, &chunkBegin, &goesLeft, &task, mid](int threadIndex) {
+                int left = task.low + leftCounts[threadIndex];
+                int right = mid + (chunkBegin(threadIndex) - task.low) - leftCounts[threadIndex];
+                for (int i = chunkBegin(threadIndex); i < chunkBegin(threadIndex + 1); ++i) {
+                    buffer[goesLeft(primitives[i]) ? left++ : right++] = primitives[i];
+                }
+            });
+            threadPool.Wait();
+
+            threadPool.Dispatch([primitives, buffer, &chunkBegin](int threadIndex) {
+                std::copy(buffer + chunkBegin(threadIndex), buffer + chunkBegin(threadIndex + 1), primitives + chunkBegin(threadIndex));
+            });
+            threadPool.Wait();
+        }
+
+        m_Nodes[task.index] = Node(usedNodes.fetch_add(2), rangeBounds.bounds);
+        return mid;
+    }
+
+    //! Bounds of reference parts that fall into one spatial bin, and number of references that start and end in it
+    struct SpatialBin {
+        AABB aabb = AABB::Empty();
+        int entryCount = 0;
+        int exitCount = 0;
+    };
+
+    //! Plane that cuts node bounds, with bounds and reference counts of children it makes
+    struct SpatialSplit {
+        int axis = -1;
+        float position = 0.f;
+        float cost = Math::Constants::Infinity<float>;
+        AABB left, right;
+        int leftCount = 0, rightCount = 0;
+    };
+
+    //! State shared by all nodes of spatial build
+    struct SpatialBuildState {
+        float minOverlapArea;
+        int referenceCount;
+        int maxReferenceCount;
+        std::vector<const IHittable*> hittables;
+    };
+
+    //! Builds tree where node may be cut by plane instead of partitioning its hittables. Hittables that cross the plane are referenced from both children, up to ```spatialSplitBudget``` extra references
+    inline void MakeHierarchySpatial(int n, const BVHBuildOptions &options) noexcept {
+        std::vector<BuildPrimitive> references(n);
+        AABB bounds = AABB::Empty();
+        for (int i = 0; i < n; ++i) {
+            references[i] = MakeBuildPrimitive(i, {});
+            bounds = AABB(bounds, references[i].aabb);
+        }
+
+        SpatialBuildState state;
+        state.minOverlapArea = options.spatialSplitOverlap * bounds.GetSurfaceArea();
+        state.referenceCount = n;
+        state.maxReferenceCount = n + static_cast<int>(static_cast<float>(n) * Math::Max(options.spatialSplitBudget, 0.f));
+        state.hittables.reserve(state.maxReferenceCount);
+
+        // Every leaf holds at least one reference, so the cap bounds number of nodes as well
+        m_Nodes.resize(2 * state.maxReferenceCount);
+
+        int usedNodes = 1;
+        MakeHierarchySpatial(1, references, state, usedNodes);
+
+        m_Hittables = std::move(state.hittables);
+    }
+
+    inline void MakeHierarchySpatial(int index, std::vector<BuildPrimitive> &references, SpatialBuildState &state, int &usedNodes) noexcept {
+        int count = static_cast<int>(references.size());
+        RangeBounds rangeBounds = ComputeRangeBounds(references.data(), 0, count);
+
+        Bins bins;
+        FillBins(references.data(), 0, count, rangeBounds.centroidBounds, bins);
+        auto [axis, split, splitCost] = FindBestSplit(bins);
+
+        SpatialSplit spatialSplit;
+        if (count > 1 && state.referenceCount < state.maxReferenceCount && GetSplitOverlapArea(bins, axis, split) > state.minOverlapArea) {
+            spatialSplit = FindBestSpatialSplit(references, rangeBounds.bounds);
+        }
+
+        if (count == 1 || IsLeafCheaper(count, rangeBounds.bounds, Math::Min(splitCost, spatialSplit.cost))) {
+            m_Nodes[index] = Node(-static_cast<int>(state.hittables.size()), rangeBounds.bounds, count);
+            for (const auto &reference : references) {
+                state.hittables.push_back(m_Hittables[reference.index]);
+            }
+            return;
+        }
+
+        std::vector<BuildPrimitive> left, right;
+        if (spatialSplit.cost < splitCost) {
+            SplitReferences(references, spatialSplit, state, left, right);
+        }
+
+        if (left.empty() || right.empty()) {
+            left.clear();
+            right.clear();
+
+            if (axis != -1) {
+                float min = rangeBounds.centroidBounds.min[axis];
+                float scale = GetBinScale(rangeBounds.centroidBounds, axis);
+                for (const auto &reference : references) {
+                    (GetBinIndex(reference.centroid[axis], min, scale) < split ? left : right).push_back(reference);
+                }
+            } else {
+                left.assign(references.begin(), references.begin() + count / 2);
+                right.assign(references.begin() + count / 2, references.end());
+            }
+        }
+
+        // Parent references are not needed anymore, so memory peaks at one path of the tree
+        std::vector<BuildPrimitive>().swap(references);
+
+        int leftIndex = ++usedNodes;
+        int rightIndex = ++usedNodes;
+        MakeHierarchySpatial(leftIndex, left, state, usedNodes);
+        MakeHierarchySpatial(rightIndex, right, state, usedNodes);
+
+        m_Nodes[index] = Node(leftIndex, m_Nodes[leftIndex], m_Nodes[rightIndex]);
+    }
+
+    //! Returns surface area of intersection of children bounds that object split at bin ```split``` of ```axis``` would make. Infinity if there is no object split
+    inline float GetSplitOverlapArea(const Bins &bins, int axis, int split) const noexcept {
+        if (axis == -1) {
+            return Math::Constants::Infinity<float>;
+        }
+
+        AABB left = AABB::Empty(), right = AABB::Empty();
+        for (int b = 0; b < BinCount; ++b) {
+            AABB &side = b < split ? left : right;
+            side = AABB(side, bins.bins[axis][b].aabb);
+        }
+
+        Math::Vector3f min = Math::Max(left.min, right.min);
+        Math::Vector3f max = Math::Min(left.max, right.max);
+        if (min.x > max.x || min.y > max.y || min.z > max.z) {
+            return 0.f;
+        }
+
+        return AABB(min, max).GetSurfaceArea();
+    }
+
+    //! Chops every reference by bin borders of each axis and sweeps bins for the plane with minimal SAH
+    inline SpatialSplit FindBestSpatialSplit(const std::vector<BuildPrimitive> &references, const AABB &bounds) const noexcept {
+        SpatialSplit best;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            float min = bounds.min[axis];
+            float binSize = (bounds.max[axis] - min) / static_cast<float>(BinCount);
+            if (binSize <= 0.f) {
+                continue;
+            }
+
+            SpatialBin bins[BinCount];
+            for (const auto &reference : references) {
+                int first = Math::Clamp(static_cast<int>((reference.aabb.min[axis] - min) / binSize), 0, BinCount - 1);
+                int last = Math::Clamp(static_cast<int>((reference.aabb.max[axis] - min) / binSize), first, BinCount - 1);
+
+                ++bins[first].entryCount;
+                ++bins[last].exitCount;
+
+                AABB remaining = reference.aabb;
+                for (int b = first; b < last; ++b) {
+                    auto [part, rest] = SplitReference(reference, remaining, axis, min + binSize * static_cast<float>(b + 1));
+                    bins[b].aabb = AABB(bins[b].aabb, part);
+                    remaining = rest;
+                }
+                bins[last].aabb = AABB(bins[last].aabb, remaining);
+            }
+
+            AABB rightBounds[BinCount];
+            int rightCounts[BinCount];
+            AABB right = AABB::Empty();
+            int rightCount = 0;
+            for (int b = BinCount - 1; b > 0; --b) {
+                right = AABB(right, bins[b].aabb);
+                rightCount += bins[b].exitCount;
+                rightBounds[b] = right;
+                rightCounts[b] = rightCount;
+            }
+
+            AABB left = AABB::Empty();
+            int leftCount = 0;
+            for (int b = 0; b < BinCount - 1; ++b) {
+                left = AABB(left, bins[b].aabb);
+                leftCount += bins[b].entryCount;
+                if (leftCount == 0 || rightCounts[b + 1] == 0) {
+                    continue;
+                }
+
+                float cost = left.GetSurfaceArea() * static_cast<float>(leftCount) + rightBounds[b + 1].GetSurfaceArea() * static_cast<float>(rightCounts[b + 1]);
+                if (cost < best.cost) {
+                    best = {axis, min + binSize * static_cast<float>(b + 1), cost, left, rightBounds[b + 1], leftCount, rightCounts[b + 1]};
+                }
+            }
+        }
+
+        return best;
+    }
+
+    //! Distributes references by plane of ```split```. Crossing reference is kept whole on one side when that is cheaper than duplicating it or budget is spent
+    inline void SplitReferences(const std::vector<BuildPrimitive> &references, const SpatialSplit &split, SpatialBuildState &state, std::vector<BuildPrimitive> &left, std::vector<BuildPrimitive> &right) const noexcept {
+        float leftArea = split.left.GetSurfaceArea();
+        float rightArea = split.right.GetSurfaceArea();
+        float leftCount = static_cast<float>(split.leftCount);
+        float rightCount = static_cast<float>(split.rightCount);
+
+        int referenceCount = state.referenceCount;
+        for (const auto &reference : references) {
+            if (reference.aabb.max[split.axis] <= split.position) {
+                left.push_back(reference);
+                continue;
+            }
+
+            if (reference.aabb.min[split.axis] >= split.position) {
+                right.push_back(reference);
+                continue;
+            }
+
+            float duplicateCost = leftArea * leftCount + rightArea * rightCount;
+            float leftOnlyCost = AABB(split.left, reference.aabb).GetSurfaceArea() * leftCount + rightArea * (rightCount - 1.f);
+            float rightOnlyCost = leftArea * (leftCount - 1.f) + AABB(split.right, reference.aabb).GetSurfaceArea() * rightCount;
+
+            bool canDuplicate = referenceCount < state.maxReferenceCount;
+            if ((!canDuplicate || leftOnlyCost < duplicateCost) && leftOnlyCost <= rightOnlyCost) {
+                left.push_back(reference);
+            } else if (!canDuplicate || rightOnlyCost < duplicateCost) {
+                right.push_back(reference);
+            } else {
+                auto [leftPart, rightPart] = SplitReference(reference, reference.aabb, split.axis, split.position);
+                left.push_back({leftPart, (leftPart.min + leftPart.max) * 0.5f, reference.index});
+                right.push_back({rightPart, (rightPart.min + rightPart.max) * 0.5f, reference.index});
+                ++referenceCount;
+            }
+        }
+
+        // Degenerate split is dropped by caller, so duplicates count only when both sides got references
+        if (!left.empty() && !right.empty()) {
+            state.referenceCount = referenceCount;
+        }
+    }
+
+    //! Returns parts of reference ```aabb``` on both sides of plane, clipped by shape of its hittable
+    inline std::pair<AABB, AABB> SplitReference(const BuildPrimitive &reference, const AABB &aabb, int axis, float position) const noexcept {
+        auto [left, right] = m_Hittables[reference.index]->SplitBoundingBox(axis, position);
+
+        AABB leftPart = aabb, rightPart = aabb;
+        leftPart.min = Math::Max(left.min, aabb.min);
+        leftPart.max = Math::Min(left.max, aabb.max);
+        leftPart.max[axis] = Math::Min(leftPart.max[axis], position);
+        rightPart.min = Math::Max(right.min, aabb.min);
+        rightPart.max = Math::Min(right.max, aabb.max);
+        rightPart.min[axis] = Math::Max(rightPart.min[axis], position);
+
+        return {leftPart, rightPart};
+    }
+
+    //! Internal node of linear build. Children below zero are primitives ```~child``` in Morton order. Cost is SAH cost of subtree without area of the node
+    struct LinearNode {
+        int children[2];
+        int parent;
+        int count;
+        AABB aabb;
+        float cost;
+    };
+
+    //! Leaves of treelet restructured by linear build. Best topology is searched over all leaf subsets, so work per treelet grows as 3^TreeletSize
+    constexpr static int TreeletSize = 7;
+
+    //! Rounds of treelet restructuring. Every round skips subtrees smaller than twice the limit of the previous one, as in TRBVH
+    constexpr static int TreeletPassCount = 3;
+
+    //! Morton ordered primitives and radix tree over them. Visit counters let the last thread that reaches node process it
+    struct LinearBuildState {
+        std::vector<BuildPrimitive> primitives;
+        std::vector<LinearNode> nodes;
+        std::vector<int> leafParents;
+        std::vector<std::atomic<int>> visits;
+        ThreadPool *threadPool = nullptr;
+        int chunkCount = 1;
+    };
+
+    //! Subsets of treelet leaves with their bounds, best cost and the first half of best partition
+    struct Treelet {
+        int leaves[TreeletSize];
+        int internals[TreeletSize - 1];
+        int leafCount = 0;
+        int usedInternals = 0;
+        AABB bounds[1 << TreeletSize];
+        float costs[1 << TreeletSize];
+        std::uint8_t partitions[1 << TreeletSize];
+    };
+
+    //! Builds tree in O(n) from Morton codes of centroids sorted by parallel radix sort. Treelets are restructured afterwards if ```optimizeTreelets``` is set to recover most of SAH quality
+    inline void MakeHierarchyLinear(int n, const BVHBuildOptions &options, std::span<const AABB> bounds) noexcept {
+        if (n == 1) {
+            m_Nodes[1] = Node(0, MakeBuildPrimitive(0, bounds).aabb, 1);
+            return;
+        }
+
+        std::unique_lock<std::mutex> poolLock;
+        LinearBuildState state;
+        state.threadPool = AcquireThreadPool(n, options, poolLock);
+        if (state.threadPool != nullptr) {
+            state.chunkCount = state.threadPool->GetThreadCount();
+        }
+
+        // 30-bit codes separate about a billion cells, more primitives get 63-bit codes so that fewer of them share one
+        if (n < (1 << 20)) {
+            MakeRadixTree<std::uint32_t>(n, bounds, state);
+        } else {
+            MakeRadixTree<std::uint64_t>(n, bounds, state);
+        }
+
+        RunBottomUp(state, [this, &state](int nodeIndex) {
+            UpdateLinearNode(state, nodeIndex);
+        });
+
+        if (options.optimizeTreelets) {
+            for (int pass = 0, minCount = TreeletSize; pass < TreeletPassCount; ++pass, minCount *= 2) {
+                RunBottomUp(state, [this, &state, minCount](int nodeIndex) {
+                    if (state.nodes[nodeIndex].count >= minCount) {
+                        RestructureTreelet(state, nodeIndex);
+                    }
+                });
+            }
+        }
+
+        EmitLinearNodes(state);
+    }
+
+    //! Runs ```task``` once per chunk, on all threads of ```state``` if it has them
+    inline static void RunChunks(const LinearBuildState &state, const std::function<void(int)> &task) noexcept {
+        if (state.threadPool == nullptr) {
+            task(0);
+            return;
+        }
+
+        state.threadPool->Dispatch(task);
+        state.threadPool->Wait();
+    }
+
+    constexpr static int GetChunkBegin(int n, int chunk, int chunkCount) noexcept {
+        return static_cast<int>(static_cast<std::int64_t>(n) * chunk / chunkCount);
+    }
+
+    //! Sorts primitives by Morton code of their centroid and links them with internal nodes of radix tree
+    template<typename Code>
+    inline void MakeRadixTree(int n, std::span<const AABB> bounds, LinearBuildState &state) const noexcept {
+        std::vector<BuildPrimitive> primitives(n);
+        std::vector<AABB> chunkCentroidBounds(state.chunkCount, AABB::Empty());
+        RunChunks(state, [this, n, bounds, &state, &primitives, &chunkCentroidBounds](int chunk) {
+            for (int i = GetChunkBegin(n, chunk, state.chunkCount); i < GetChunkBegin(n, chunk + 1, state.chunkCount); ++i) {
+                primitives[i] = MakeBuildPrimitive(i, bounds);
+                chunkCentroidBounds[chunk] = AABB(chunkCentroidBounds[chunk], AABB(primitives[i].centroid, primitives[i].centroid));
+            }
+        });
+
+        AABB centroidBounds = AABB::Empty();
+        for (const auto &chunkBounds : chunkCentroidBounds) {
+            centroidBounds = AABB(centroidBounds, chunkBounds);
+        }
+
+        constexpr int AxisBits = sizeof(Code) == 4 ? 10 : 21;
+        constexpr float CellCount = static_cast<float>(1 << AxisBits);
+        Math::Vector3f scale;
+        for (int axis = 0; axis < 3; ++axis) {
+            float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+            scale[axis] = extent > 0.f ? CellCount / extent : 0.f;
+        }
+
+        std::vector<Code> codes(n);
+        std::vector<int> order(n);
+        RunChunks(state, [n, &state, &primitives, &codes, &order, &centroidBounds, &scale](int chunk) {
+            for (int i = GetChunkBegin(n, chunk, state.chunkCount); i < GetChunkBegin(n, chunk + 1, state.chunkCount); ++i) {
+                std::uint32_t cells[3];
+                for (int axis = 0; axis < 3; ++axis) {
+                    float cell = (primitives[i].centroid[axis] - centroidBounds.min[axis]) * scale[axis];
+                    cells[axis] = static_cast<std::uint32_t>(Math::Clamp(cell, 0.f, CellCount - 1.f));
+                }
+
+                codes[i] = EncodeMorton<Code>(cells[0], cells[1], cells[2]);
+                order[i] = i;
+            }
+        });
+
+        RadixSort(state, codes, order);
+
+        state.primitives.resize(n);
+        RunChunks(state, [n, &state, &primitives, &order](int chunk) {
+            for (int i = GetChunkBegin(n, chunk, state.chunkCount); i < GetChunkBegin(n, chunk + 1, state.chunkCount); ++i) {
+                state.primitives[i] = primitives[order[i]];
+            }
+        });
+
+        state.nodes.resize(n - 1);
+        state.leafParents.resize(n);
+        state.visits = std::vector<std::atomic<int>>(n - 1);
+        state.nodes[0].parent = -1;
+
+        // Every internal node finds its range and split from codes alone (Karras 2012), so all of them are linked independently
+        RunChunks(state, [n, &state, &codes](int chunk) {
+            for (int i = GetChunkBegin(n - 1, chunk, state.chunkCount); i < GetChunkBegin(n - 1, chunk + 1, state.chunkCount); ++i) {
+                int direction = GetCommonPrefix(codes, i, i + 1) > GetCommonPrefix(codes, i, i - 1) ? 1 : -1;
+                int minPrefix = GetCommonPrefix(codes, i, i - direction);
+
+                int maxLength = 2;
+                while (GetCommonPrefix(codes, i, i + maxLength * direction) > minPrefix) {
+                    maxLength *= 2;
+                }
+
+                int length = 0;
+                for (int step = maxLength / 2; step >= 1; step /= 2) {
+                    if (GetCommonPrefix(codes, i, i + (length + step) * direction) > minPrefix) {
+                        length += step;
+                    }
+                }
+
+                int j = i + length * direction;
+                int nodePrefix = GetCommonPrefix(codes, i, j);
+
+                int split = 0;
+                int step = length;
+                do {
+                    step = (step + 1) / 2;
+                    if (GetCommonPrefix(codes, i, i + (split + step) * direction) > nodePrefix) {
+                        split += step;
+                    }
+                } while (step > 1);
+
+                int gamma = i + split * direction + Math::Min(direction, 0);
+                int children[2] = {Math::Min(i, j) == gamma ? ~gamma : gamma, Math::Max(i, j) == gamma + 1 ? ~(gamma + 1) : gamma + 1};
+                for (int side = 0; side < 2; ++side) {
+                    state.nodes[i].children[side] = children[side];
+                    if (children[side] < 0) {
+                        state.leafParents[~children[side]] = i;
+                    } else {
+                        state.nodes[children[side]].parent = i;
+                    }
+                }
+            }
+        });
+    }
+
+    //! Stable parallel LSD radix sort of ```codes``` by bytes. Every chunk counts its digits, then scatters to offsets given by prefix sums over digits and chunks
+    template<typename Code>
+    inline static void RadixSort(const LinearBuildState &state, std::vector<Code> &codes, std::vector<int> &values) noexcept {
+        constexpr int DigitBits = 8;
+        constexpr int DigitCount = 1 << DigitBits;
+
+        int n = static_cast<int>(codes.size());
+        std::vector<Code> codeBuffer(n);
+        std::vector<int> valueBuffer(n);
+        std::vector<int> offsets(state.chunkCount * DigitCount);
+
+        for (int shift = 0; shift < static_cast<int>(sizeof(Code)) * 8; shift += DigitBits) {
+            RunChunks(state, [n, shift, &state, &codes, &offsets](int chunk) {
+                int *histogram = offsets.data() + chunk * DigitCount;
+                std::fill(histogram, histogram + DigitCount, 0);
+                for (int i = GetChunkBegin(n, chunk, state.chunkCount); i < GetChunkBegin(n, chunk + 1, state.chunkCount); ++i) {
+                    ++histogram[(codes[i] >> shift) & (DigitCount - 1)];
+                }
+            });
+
+            // Pass is skipped when all codes share the digit, e.g. high bytes of codes that use fewer bits than their type
+            bool uniform = false;
+            int sum = 0;
+            for (int digit = 0; digit < DigitCount; ++digit) {
+                for (int chunk = 0; chunk < state.chunkCount; ++chunk) {
+                    int count = offsets[chunk * DigitCount + digit];
+                    uniform |= count == n;
+                    offsets[chunk * DigitCount + digit] = sum;
+                    sum += count;
+                }
+            }
+
+            if (uniform) {
+                continue;
+            }
+
+            RunChunks(state, [n, shift, &state, &codes, &values, &codeBuffer, &valueBuffer, &offsets](int chunk) {
+                int *chunkOffsets = offsets.data() + chunk * DigitCount;
+                for (int i = GetChunkBegin(n, chunk, state.chunkCount); i < GetChunkBegin(n, chunk + 1, state.chunkCount); ++i) {
+                    int &offset = chunkOffsets[(codes[i] >> shift) & (DigitCount - 1)];
+                    codeBuffer[offset] = codes[i];
+                    valueBuffer[offset] = values[i];
+                    ++offset;
+                }
+            });
+
+            std::swap(codes, codeBuffer);
+            std::swap(values, valueBuffer);
+        }
+    }
+
+    //! Interleaves bits of cell coordinates, 10 per axis into 32-bit code or 21 per axis into 64-bit one
+    template<typename Code>
+    constexpr static Code EncodeMorton(std::uint32_t x, std::uint32_t y, std::uint32_t z) noexcept {
+        return SpreadBits<Code>(x) | SpreadBits<Code>(y) << 1 | SpreadBits<Code>(z) << 2;
+    }
+
+    //! Inserts two zero bits after every bit of ```value```
+    template<typename Code>
+    constexpr static Code SpreadBits(std::uint32_t value) noexcept {
+        Code x = value;
+        if constexpr (sizeof(Code) == 4) {
+            x &= 0x3ffu;
+            x = (x | x << 16) & 0x030000ffu;
+            x = (x | x << 8) & 0x0300f00fu;
+            x = (x | x << 4) & 0x030c30c3u;
+            x = (x | x << 2) & 0x09249249u;
+        } else {
+            x &= 0x1fffffull;
+            x = (x | x << 32) & 0x001f00000000ffffull;
+            x = (x | x << 16) & 0x001f0000ff0000ffull;
+            x = (x | x << 8) & 0x100f00f00f00f00full;
+            x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+            x = (x | x << 2) & 0x1249249249249249ull;
+        }
+
+        return x;
+    }
+
+    //! Length of common prefix of codes at ```i``` and ```j```, -1 if ```j``` is out of range. Equal codes are told apart by their indices
+    template<typename Code>
+    inline static int GetCommonPrefix(const std::vector<Code> &codes, int i, int j) noexcept {
+        if (j < 0 || j >= static_cast<int>(codes.size())) {
+            return -1;
+        }
+
+        if (codes[i] == codes[j]) {
+            return static_cast<int>(sizeof(Code)) * 8 + std::countl_zero(static_cast<std::uint32_t>(i ^ j));
+        }
+
+        return std::countl_zero(codes[i] ^ codes[j]);
+    }
+
+    //! Walks from every primitive to the root. Second thread that reaches node calls ```visit```, so both subtrees are final when node is visited
+    inline static void RunBottomUp(LinearBuildState &state, const std::function<void(int)> &visit) noexcept {
+        int n = static_cast<int>(state.primitives.size());
+        RunChunks(state, [n, &state](int chunk) {
+            for (int i = GetChunkBegin(n - 1, chunk, state.chunkCount); i < GetChunkBegin(n - 1, chunk + 1, state.chunkCount); ++i) {
+                state.visits[i].store(0, std::memory_order_relaxed);
+            }
+        });
+
+        RunChunks(state, [n, &state, &visit](int chunk) {
+            for (int i = GetChunkBegin(n, chunk, state.chunkCount); i < GetChunkBegin(n, chunk + 1, state.chunkCount); ++i) {
+                int nodeIndex = state.leafParents[i];
+                while (nodeIndex >= 0 && state.visits[nodeIndex].fetch_add(1, std::memory_order_acq_rel) == 1) {
+                    visit(nodeIndex);
+                    nodeIndex = state.nodes[nodeIndex].parent;
+                }
+            }
+        });
+    }
+
+    inline AABB GetLinearBounds(const LinearBuildState &state, int child) const noexcept {
+        return child < 0 ? state.primitives[~child].aabb : state.nodes[child].aabb;
+    }
+
+    //! SAH cost of subtree including its root area, one unit per hittable
+    inline float GetLinearCost(const LinearBuildState &state, int child) const noexcept {
+        if (child < 0) {
+            return state.primitives[~child].aabb.GetSurfaceArea();
+        }
+
+        return m_TraversalCost * state.nodes[child].aabb.GetSurfaceArea() + state.nodes[child].cost;
+    }
+
+    inline void UpdateLinearNode(LinearBuildState &state, int nodeIndex) const noexcept {
+        LinearNode &node = state.nodes[nodeIndex];
+        node.aabb = AABB(GetLinearBounds(state, node.children[0]), GetLinearBounds(state, node.children[1]));
+        node.cost = GetLinearCost(state, node.children[0]) + GetLinearCost(state, node.children[1]);
+        node.count = 0;
+        for (int child : node.children) {
+            node.count += child < 0 ? 1 : state.nodes[child].count;
+        }
+    }
+
+    //! Grows treelet under ```rootIndex``` by opening its largest leaves, then rebuilds it with the topology of lowest SAH cost found over all leaf subsets
+    inline void RestructureTreelet(LinearBuildState &state, int rootIndex) const noexcept {
+        Treelet treelet;
+        treelet.leaves[0] = state.nodes[rootIndex].children[0];
+        treelet.leaves[1] = state.nodes[rootIndex].children[1];
+        treelet.leafCount = 2;
+        treelet.internals[0] = rootIndex;
+        int internalCount = 1;
+
+        while (treelet.leafCount < TreeletSize) {
+            int largest = -1;
+            float largestArea = -1.f;
+            for (int i = 0; i < treelet.leafCount; ++i) {
+                int leaf = treelet.leaves[i];
+                if (leaf >= 0 && state.nodes[leaf].aabb.GetSurfaceArea() > largestArea) {
+                    largest = i;
+                    largestArea = state.nodes[leaf].aabb.GetSurfaceArea();
+                }
+            }
+
+            if (largest < 0) {
+                break;
+            }
+
+            int opened = treelet.leaves[largest];
+            treelet.internals[internalCount++] = opened;
+            treelet.leaves[largest] = state.nodes[opened].children[0];
+            treelet.leaves[treelet.leafCount++] = state.nodes[opened].children[1];
+        }
+
+        // Two leaves can only be joined one way
+        if (treelet.leafCount < 3) {
+            return;
+        }
+
+        int fullSet = (1 << treelet.leafCount) - 1;
+        treelet.bounds[0] = AABB::Empty();
+        for (int subset = 1; subset <= fullSet; ++subset) {
+            int lowest = std::countr_zero(static_cast<unsigned>(subset));
+            treelet.bounds[subset] = AABB(treelet.bounds[subset & (subset - 1)], GetLinearBounds(state, treelet.leaves[lowest]));
+
+            if ((subset & (subset - 1)) == 0) {
+                treelet.costs[subset] = GetLinearCost(state, treelet.leaves[lowest]);
+                continue;
+            }
+
+            // Partitions are enumerated once by keeping lowest leaf on the first side. Subsets precede their supersets, so costs of both sides are known
+            int lowestBit = subset & -subset;
+            int rest = subset ^ lowestBit;
+            float bestCost = Math::Constants::Infinity<float>;
+            int bestPartition = lowestBit;
+            for (int part = (rest - 1) & rest; ; part = (part - 1) & rest) {
+                int first = part | lowestBit;
+                float cost = treelet.costs[first] + treelet.costs[subset ^ first];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestPartition = first;
+                }
+
+                if (part == 0) {
+                    break;
+                }
+            }
+
+            treelet.costs[subset] = m_TraversalCost * treelet.bounds[subset].GetSurfaceArea() + bestCost;
+            treelet.partitions[subset] = static_cast<std::uint8_t>(bestPartition);
+        }
+
+        const LinearNode &root = state.nodes[rootIndex];
+        float currentCost = m_TraversalCost * root.aabb.GetSurfaceArea() + root.cost;
+        if (treelet.costs[fullSet] >= currentCost * 0.999f) {
+            return;
+        }
+
+        treelet.usedInternals = 1;
+        AssignTreelet(state, treelet, rootIndex, fullSet);
+    }
+
+    //! Links node ```nodeIndex``` that covers treelet leaves in ```subset``` with children of its best partition
+    inline void AssignTreelet(LinearBuildState &state, Treelet &treelet, int nodeIndex, int subset) const noexcept {
+        int first = treelet.partitions[subset];
+        int sides[2] = {first, subset ^ first};
+
+        for (int side = 0; side < 2; ++side) {
+            int child;
+            if ((sides[side] & (sides[side] - 1)) == 0) {
+                child = treelet.leaves[std::countr_zero(static_cast<unsigned>(sides[side]))];
+            } else {
+                child = treelet.internals[treelet.usedInternals++];
+                AssignTreelet(state, treelet, child, sides[side]);
+            }
+
+            state.nodes[nodeIndex].children[side] = child;
+            if (child < 0) {
+                state.leafParents[~child] = nodeIndex;
+            } else {
+                state.nodes[child].parent = nodeIndex;
+            }
+        }
+
+        UpdateLinearNode(state, nodeIndex);
+    }
+
+    //! Moves radix tree to nodes with children at ```index``` and ```index | 1```. Subtrees that fit leaf and are cheaper as one are collapsed, hittables are ordered by leaves
+    inline void EmitLinearNodes(const LinearBuildState &state) noexcept {
+        int internalCount = static_cast<int>(state.nodes.size());
+
+        // Preorder lists parents before children, so reverse order decides children first
+        std::vector<int> preorder;
+        preorder.reserve(internalCount);
+        std::vector<int> stack = {0};
+        while (!stack.empty()) {
+            int nodeIndex = stack.back();
+            stack.pop_back();
+            preorder.push_back(nodeIndex);
+            for (int child : state.nodes[nodeIndex].children) {
+                if (child >= 0) {
+                    stack.push_back(child);
+                }
+            }
+        }
+
+        std::vector<float> costs(internalCount);
+        std::vector<char> collapsed(internalCount);
+        for (auto it = preorder.rbegin(); it != preorder.rend(); ++it) {
+            const LinearNode &node = state.nodes[*it];
+
+            float splitCost = 0.f;
+            for (int child : node.children) {
+                splitCost += child < 0 ? state.primitives[~child].aabb.GetSurfaceArea() : costs[child];
+            }
+
+            collapsed[*it] = IsLeafCheaper(node.count, node.aabb, splitCost);
+            costs[*it] = collapsed[*it] ? static_cast<float>(node.count) * node.aabb.GetSurfaceArea() : m_TraversalCost * node.aabb.GetSurfaceArea() + splitCost;
+        }
+
+        std::vector<const IHittable*> hittables;
+        hittables.reserve(state.primitives.size());
+        auto appendLeaf = [this, &state, &hittables, &stack](int index, int child, const AABB &aabb, int count) {
+            m_Nodes[index] = Node(-static_cast<int>(hittables.size()), aabb, count);
+
+            std::vector<int> &subtree = stack;
+            subtree.push_back(child);
+            while (!subtree.empty()) {
+                int current = subtree.back();
+                subtree.pop_back();
+                if (current < 0) {
+                    hittables.push_back(m_Hittables[state.primitives[~current].index]);
+                } else {
+                    subtree.push_back(state.nodes[current].children[1]);
+                    subtree.push_back(state.nodes[current].children[0]);
+                }
+            }
+        };
+
+        int usedNodes = 2;
+        std::vector<std::pair<int, int>> emitted = {{0, 1}};
+        while (!emitted.empty()) {
+            auto [child, index] = emitted.back();
+            emitted.pop_back();
+
+            if (child < 0) {
+                appendLeaf(index, child, state.primitives[~child].aabb, 1);
+            } else if (collapsed[child]) {
+                appendLeaf(index, child, state.nodes[child].aabb, state.nodes[child].count);
+            } else {
+                int leftIndex = usedNodes;
+                usedNodes += 2;
+                m_Nodes[index] = Node(leftIndex, state.nodes[child].aabb);
+                emitted.push_back({state.nodes[child].children[1], leftIndex | 1});
+                emitted.push_back({state.nodes[child].children[0], leftIndex});
+            }
+        }
+
+        m_Hittables = std::move(hittables);
+    }
+
+    inline RangeBounds ComputeRangeBounds(const BuildPrimitive *primitives, int low, int high) const noexcept {
+        RangeBounds rangeBounds;
+        for (int i = low; i < high; ++i) {
+            rangeBounds.bounds = AABB(rangeBounds.bounds, primitives[i].aabb);
+            rangeBounds.centroidBounds = AABB(rangeBounds.centroidBounds, AABB(primitives[i].centroid, primitives[i].centroid));
+        }
+
+        return rangeBounds;
+    }
+
+    inline void FillBins(const BuildPrimitive *primitives, int low, int high, const AABB &centroidBounds, Bins &bins) const noexcept {
+        for (int axis = 0; axis < 3; ++axis) {
+            if (centroidBounds.max[axis] - centroidBounds.min[axis] <= 0.f) {
+                continue;
+            }
+
+            float min = centroidBounds.min[axis];
+            float scale = GetBinScale(centroidBounds, axis);
+            for (int i = low; i < high; ++i) {
+                Bin &bin = bins.bins[axis][GetBinIndex(primitives[i].centroid[axis], min, scale)];
+                bin.aabb = AABB(bin.aabb, primitives[i].aabb);
+                ++bin.count;
+            }
+        }
+    }
+
+    //! Returns axis, first bin of right child and cost of split with minimal SAH. Axis is -1 if no split separates primitives
+    inline std::tuple<int, int, float> FindBestSplit(const Bins &bins) const noexcept {
+        float minCost = Math::Constants::Infinity<float>;
+        int bestAxis = -1;
+        int bestSplit = -1;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            const Bin *axisBins = bins.bins[axis];
+
+            float rightAreas[BinCount];
+            int rightCounts[BinCount];
+            AABB rightBounds = AABB::Empty();
+            int rightCount = 0;
+            for (int b = BinCount - 1; b > 0; --b) {
+                rightBounds = AABB(rightBounds, axisBins[b].aabb);
+                rightCount += axisBins[b].count;
+                rightAreas[b] = rightBounds.GetSurfaceArea();
+                rightCounts[b] = rightCount;
+            }
+
+            AABB leftBounds = AABB::Empty();
+            int leftCount = 0;
+            for (int b = 0; b < BinCount - 1; ++b) {
+                leftBounds = AABB(leftBounds, axisBins[b].aabb);
+                leftCount += axisBins[b].count;
+                if (leftCount == 0 || rightCounts[b + 1] == 0) {
+                    continue;
+                }
+
+                float cost = leftBounds.GetSurfaceArea() * static_cast<float>(leftCount) + rightAreas[b + 1] * static_cast<float>(rightCounts[b + 1]);
+                if (cost < minCost) {
+                    minCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b + 1;
+                }
+            }
+        }
+
+        return {bestAxis, bestSplit, minCost};
+    }
+
+    //! Leaf is made if it fits and testing all ```count``` hittables is cheaper than visiting children, whose SAH is ```splitCost```
+    inline bool IsLeafCheaper(int count, const AABB &bounds, float splitCost) const noexcept {
+        if (count > m_MaxLeafSize) {
+            return false;
+        }
+
+        float area = bounds.GetSurfaceArea();
+        return static_cast<float>(count) * area <= m_TraversalCost * area + splitCost;
+    }
+
+    constexpr static float GetBinScale(const AABB &centroidBounds, int axis) noexcept {
+        return static_cast<float>(BinCount) / (centroidBounds.max[axis] - centroidBounds.min[axis]);
+    }
+
+    constexpr static int GetBinIndex(float centroid, float min, float scale) noexcept {
+        return Math::Min(static_cast<int>((centroid - min) * scale), BinCount - 1);
+    }
+
+    //! Builders place children of node at ```index``` and ```index | 1```. Tree is moved to depth first order, where first child follows its parent, so that traversal walks memory forward
+    inline void ReorderDepthFirst() noexcept {
+        std::vector<Node> nodes;
+        nodes.reserve(m_Nodes.size());
+
+        // Every entry holds old index of node and new index of parent that references it, -1 for first child
+        std::vector<std::pair<int, int>> stack = {{1, -1}};
+        while (!stack.empty()) {
+            auto [nodeIndex, parentIndex] = stack.back();
+            stack.pop_back();
+
+            int newIndex = static_cast<int>(nodes.size());
+            if (parentIndex >= 0) {
+                nodes[parentIndex].index = newIndex;
+            }
+            nodes.push_back(m_Nodes[nodeIndex]);
+
+            if (!m_Nodes[nodeIndex].IsLeaf()) {
+                stack.push_back({m_Nodes[nodeIndex].index | 1, newIndex});
+                stack.push_back({m_Nodes[nodeIndex].index, -1});
+            }
+        }
+
+        m_Nodes = std::move(nodes);
+    }
+
+    //! Expected cost of random ray relative to root, ```m_TraversalCost``` per visited node and one unit per tested hittable
+    inline void ComputeSAHCost() noexcept {
+        float rootArea = m_Nodes[0].aabb.GetSurfaceArea();
+
+        float cost = 0.f;
+        int depth = 0;
+        int nodeCount = 0;
+        int leafCount = 0;
+
+        std::vector<std::pair<int, int>> nodes = {{0, 1}};
+        while (!nodes.empty()) {
+            auto [nodeIndex, nodeDepth] = nodes.back();
+            nodes.pop_back();
+
+            depth = Math::Max(depth, nodeDepth);
+            ++nodeCount;
+
+            float area = m_Nodes[nodeIndex].aabb.GetSurfaceArea();
+            if (m_Nodes[nodeIndex].IsLeaf()) {
+                cost += area * static_cast<float>(m_Nodes[nodeIndex].count);
+                ++leafCount;
+            } else {
+                cost += area * m_TraversalCost;
+                nodes.push_back({nodeIndex + 1, nodeDepth + 1});
+                nodes.push_back({m_Nodes[nodeIndex].index, nodeDepth + 1});
+            }
+        }
+
+        // Empty root has infinite area
+        m_BuildStatistics.sahCost = rootArea > 0.f && rootArea < Math::Constants::Infinity<float> ? cost / rootArea : 0.f;
+        m_BuildStatistics.depth = depth;
+
+        // Binary traversal keeps at most one entry per level. Packet traversal may start single ray subtree on top of its own entries
+        m_StackSize = 2 * depth;
+        m_BuildStatistics.nodeCount = nodeCount;
+        m_BuildStatistics.leafCount = leafCount;
+        m_BuildStatistics.memoryFootprint = m_Nodes.size() * sizeof(Node) + m_Hittables.size() * sizeof(const IHittable*) + m_Primitives.GetMemoryFootprint();
+        m_BuildStatistics.referenceCount = static_cast<int>(m_Hittables.size());
     }
 
 private:
     std::vector<Node> m_Nodes;
+    std::vector<WideNode> m_WideNodes;
+    std::vector<QuantizedWideNode> m_QuantizedNodes;
     std::vector<const IHittable*> m_Hittables;
+    LeafPrimitives m_Primitives;
     AABB m_AABB;
+    int m_MaxLeafSize;
+    float m_TraversalCost;
+    int m_StackSize;
+    float m_BuiltSAHCost;
+    BuildStatistics m_BuildStatistics;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,117 @@
+#ifndef _BVH_CACHE_H
+#define _BVH_CACHE_H
+
+#include "BVH.h"
+#include "../assets/MappedFile.h"
+
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <system_error>
+
+//! On-disk storage of built BVHs. Files are keyed by hash of hittable data and build options and are memory-mapped on load, so trees seen before skip construction
+class BVHCache {
+public:
+    constexpr BVHCache() noexcept = delete;
+    constexpr BVHCache(const BVHCache&) = delete;
+    constexpr BVHCache(BVHCache&&) = delete;
+
+    //! Seed of Hash
+    constexpr static std::uint64_t HashSeed = 0xcbf29ce484222325ull;
+
+    //! Hash of ```bytes``` continued from ```hash```. Four independent lanes consume 32 bytes per step, so hashing meshes stays well below loading their trees
+    inline static std::uint64_t Hash(std::span<const std::byte> bytes, std::uint64_t hash = HashSeed) noexcept {
+        constexpr std::size_t LaneCount = 4;
+        constexpr std::size_t BlockSize = LaneCount * sizeof(std::uint64_t);
+
+        std::uint64_t lanes[LaneCount] = {hash, hash + 1, hash + 2, hash + 3};
+        std::size_t blockCount = bytes.size() / BlockSize;
+        for (std::size_t block = 0; block < blockCount; ++block) {
+            std::uint64_t words[LaneCount];
+            std::memcpy(words, bytes.data() + block * BlockSize, BlockSize);
+            for (std::size_t lane = 0; lane < LaneCount; ++lane) {
+                lanes[lane] = Mix(lanes[lane] ^ words[lane]);
+            }
+        }
+
+        hash = Mix(lanes[0] ^ Mix(lanes[1] ^ Mix(lanes[2] ^ Mix(lanes[3] ^ bytes.size()))));
+        for (std::size_t i = blockCount * BlockSize; i < bytes.size(); ++i) {
+            hash = Mix(hash ^ static_cast<std::uint64_t>(bytes[i]));
+        }
+
+        return hash;
+    }
+
+    //! Hashes trivially copyable ```value``` into ```hash```
+    template<typename T>
+    inline static std::uint64_t Hash(const T &value, std::uint64_t hash) noexcept {
+        return Hash(std::as_bytes(std::span<const T>(&value, 1)), hash);
+    }
+
+    //! Key of tree built with ```options``` over data that hashed to ```dataHash```. Thread count is left out, it does not change which tree is built
+    inline static std::uint64_t ComputeKey(std::uint64_t dataHash, const BVHBuildOptions &options) noexcept {
+        std::uint64_t key = Hash(dataHash, HashSeed);
+        key = Hash(options.method, key);
+        key = Hash(options.maxLeafSize, key);
+        key = Hash(options.traversalCost, key);
+        key = Hash(options.spatialSplitOverlap, key);
+        key = Hash(options.spatialSplitBudget, key);
+        key = Hash(options.optimizeTreelets, key);
+        key = Hash(options.wideNodes, key);
+        return Hash(options.quantizedNodes, key);
+    }
+
+    //! Maps file at ```path``` and restores tree stored there under ```key``` over ```hittables```. Returns nullptr if file is missing, stale or malformed
+    inline static BVH* Load(const std::filesystem::path &path, std::uint64_t key, std::span<IHittable* const> hittables) noexcept {
+        MappedFile file(path);
+        if (!file.IsOpen()) {
+            return nullptr;
+        }
+
+        return BVH::Deserialize(file.GetData(), key, hittables);
+    }
+
+    //! Writes ```bvh``` to ```path``` through temporary file that is renamed once complete, so loads never see partial file. Returns false on failure
+    inline static bool Store(const std::filesystem::path &path, std::uint64_t key, const BVH &bvh, std::span<IHittable* const> hittables) noexcept {
+        std::error_code error;
+        if (path.has_parent_path()) {
+            std::filesystem::create_directories(path.parent_path(), error);
+        }
+
+        std::filesystem::path temporaryPath = path;
+        temporaryPath += ".tmp";
+
+        {
+            std::ofstream os(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!os) {
+                return false;
+            }
+
+            bvh.Serialize(os, key, hittables);
+            if (!os.flush()) {
+                os.close();
+                std::filesystem::remove(temporaryPath, error);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error) {
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+    constexpr static std::uint64_t Mix(std::uint64_t hash) noexcept {
+        hash *= 0x9e3779b97f4a7c15ull;
+        return hash ^ (hash >> 32);
+    }
+};
+
+#endif
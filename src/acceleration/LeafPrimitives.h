@@ -0,0 +1,313 @@
+#ifndef _LEAF_PRIMITIVES_H
+#define _LEAF_PRIMITIVES_H
+
+#include "../hittable/IHittable.h"
+
+#include <array>
+#include <vector>
+#include <span>
+#include <bit>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define PTRACE_USE_SSE
+#include <emmintrin.h>
+#endif
+
+//! Geometry of triangles and spheres gathered in BVH leaf order. Each type is stored per component in its own arrays, so runs of one type inside a leaf are tested four at a time without virtual calls
+class LeafPrimitives {
+public:
+    constexpr static int Width = 4;
+
+    //! Copies ```shapes``` given in leaf order. Shapes of one type have to be grouped inside leaves. Stays empty if none is triangle or sphere
+    inline void Build(std::span<const ShapeData> shapes) noexcept {
+        int count = static_cast<int>(shapes.size());
+        m_Types.resize(count);
+        m_Slots.resize(count);
+
+        int triangleCount = 0, sphereCount = 0;
+        for (int i = 0; i < count; ++i) {
+            m_Types[i] = shapes[i].type;
+            m_Slots[i] = shapes[i].type == ShapeType::Triangle ? triangleCount++ : shapes[i].type == ShapeType::Sphere ? sphereCount++ : -1;
+        }
+
+        if (triangleCount + sphereCount == 0) {
+            Clear();
+            return;
+        }
+
+        // Trailing slots are degenerate, so loads of last group stay inside arrays and never hit
+        for (int axis = 0; axis < 3; ++axis) {
+            m_Vertex[axis].assign(triangleCount + Width - 1, 0.f);
+            m_FirstEdge[axis].assign(triangleCount + Width - 1, 0.f);
+            m_SecondEdge[axis].assign(triangleCount + Width - 1, 0.f);
+            m_Center[axis].assign(sphereCount + Width - 1, 0.f);
+        }
+        m_RadiusSquared.assign(sphereCount + Width - 1, 0.f);
+
+        for (int i = 0; i < count; ++i) {
+            Set(i, shapes[i]);
+        }
+    }
+
+    //! Overwrites geometry of shape at leaf order position ```reference```. Type of shape has to stay the same
+    inline void Set(int reference, const ShapeData &shape) noexcept {
+        int slot = m_Slots[reference];
+
+        if (shape.type == ShapeType::Triangle) {
+            for (int axis = 0; axis < 3; ++axis) {
+                m_Vertex[axis][slot] = shape.points[0][axis];
+                m_FirstEdge[axis][slot] = shape.points[1][axis] - shape.points[0][axis];
+                m_SecondEdge[axis][slot] = shape.points[2][axis] - shape.points[0][axis];
+            }
+        } else if (shape.type == ShapeType::Sphere) {
+            for (int axis = 0; axis < 3; ++axis) {
+                m_Center[axis][slot] = shape.points[0][axis];
+            }
+            m_RadiusSquared[slot] = shape.radius * shape.radius;
+        }
+    }
+
+    //! Releases all shapes
+    inline void Clear() noexcept {
+        m_Types = {};
+        m_Slots = {};
+        for (int axis = 0; axis < 3; ++axis) {
+            m_Vertex[axis] = {};
+            m_FirstEdge[axis] = {};
+            m_SecondEdge[axis] = {};
+            m_Center[axis] = {};
+        }
+        m_RadiusSquared = {};
+    }
+
+    //! Returns true if no shapes are stored
+    inline bool IsEmpty() const noexcept {
+        return m_Types.empty();
+    }
+
+    //! Returns size of all arrays in bytes
+    inline std::size_t GetMemoryFootprint() const noexcept {
+        return m_Types.size() * (sizeof(ShapeType) + sizeof(int)) + 9 * m_Vertex[0].size() * sizeof(float) + 4 * m_RadiusSquared.size() * sizeof(float);
+    }
+
+    //! Returns type of shape at leaf order position ```reference```
+    inline ShapeType GetType(int reference) const noexcept {
+        return m_Types[reference];
+    }
+
+    //! Returns end of run of shapes of one type that starts at ```first```, not past ```last```
+    inline int GetRunEnd(int first, int last) const noexcept {
+        int end = first + 1;
+        while (end < last && m_Types[end] == m_Types[first]) {
+            ++end;
+        }
+
+        return end;
+    }
+
+    //! Returns reference of closest triangle of run [first, last) hit in [tMin, tMax] or -1. Writes its distance and barycentrics
+    inline int HitTriangles(const Ray &ray, int first, int last, float tMin, float tMax, float &t, float &u, float &v) const noexcept {
+        int slot = m_Slots[first];
+        int closest = -1;
+        for (int group = 0; group < last - first; group += Width) {
+            alignas(16) float groupT[Width], groupU[Width], groupV[Width];
+            int mask = IntersectTriangles(ray, slot + group, last - first - group, tMin, tMax, groupT, groupU, groupV);
+
+            // Later shape wins ties, like sequential tests that shrink tMax
+            for (; mask != 0; mask &= mask - 1) {
+                int lane = std::countr_zero(static_cast<unsigned>(mask));
+                if (groupT[lane] <= tMax) {
+                    tMax = groupT[lane];
+                    t = groupT[lane];
+                    u = groupU[lane];
+                    v = groupV[lane];
+                    closest = first + group + lane;
+                }
+            }
+        }
+
+        return closest;
+    }
+
+    //! Returns reference of closest sphere of run [first, last) hit in [tMin, tMax] or -1. Writes its distance
+    inline int HitSpheres(const Ray &ray, int first, int last, float tMin, float tMax, float &t) const noexcept {
+        int slot = m_Slots[first];
+        int closest = -1;
+        for (int group = 0; group < last - first; group += Width) {
+            alignas(16) float groupT[Width];
+            int mask = IntersectSpheres(ray, slot + group, last - first - group, tMin, tMax, groupT);
+
+            for (; mask != 0; mask &= mask - 1) {
+                int lane = std::countr_zero(static_cast<unsigned>(mask));
+                if (groupT[lane] <= tMax) {
+                    tMax = groupT[lane];
+                    t = groupT[lane];
+                    closest = first + group + lane;
+                }
+            }
+        }
+
+        return closest;
+    }
+
+    //! Checks if any triangle of run [first, last) is hit in [tMin, tMax]
+    inline bool OccludedTriangles(const Ray &ray, int first, int last, float tMin, float tMax) const noexcept {
+        int slot = m_Slots[first];
+        for (int group = 0; group < last - first; group += Width) {
+            alignas(16) float groupT[Width], groupU[Width], groupV[Width];
+            if (IntersectTriangles(ray, slot + group, last - first - group, tMin, tMax, groupT, groupU, groupV) != 0) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    //! Checks if any sphere of run [first, last) is hit in [tMin, tMax]
+    inline bool OccludedSpheres(const Ray &ray, int first, int last, float tMin, float tMax) const noexcept {
+        int slot = m_Slots[first];
+        for (int group = 0; group < last - first; group += Width) {
+            alignas(16) float groupT[Width];
+            if (IntersectSpheres(ray, slot + group, last - first - group, tMin, tMax, groupT) != 0) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    constexpr static int GetLaneMask(int remaining) noexcept {
+        return remaining < Width ? (1 << remaining) - 1 : (1 << Width) - 1;
+    }
+
+    //! Moller-Trumbore test of ```Width``` triangles starting at slot ```first```, lanes past ```remaining``` are masked out. Returns mask of hits
+    inline int IntersectTriangles(const Ray &ray, int first, int remaining, float tMin, float tMax, float *t, float *u, float *v) const noexcept {
+#ifdef PTRACE_USE_SSE
+        __m128 dx = _mm_set1_ps(ray.direction.x), dy = _mm_set1_ps(ray.direction.y), dz = _mm_set1_ps(ray.direction.z);
+
+        __m128 e1x = _mm_loadu_ps(&m_FirstEdge[0][first]), e1y = _mm_loadu_ps(&m_FirstEdge[1][first]), e1z = _mm_loadu_ps(&m_FirstEdge[2][first]);
+        __m128 e2x = _mm_loadu_ps(&m_SecondEdge[0][first]), e2y = _mm_loadu_ps(&m_SecondEdge[1][first]), e2z = _mm_loadu_ps(&m_SecondEdge[2][first]);
+
+        __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+        __m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.f), determinant);
+
+        __m128 sx = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_loadu_ps(&m_Vertex[0][first]));
+        __m128 sy = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_loadu_ps(&m_Vertex[1][first]));
+        __m128 sz = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_loadu_ps(&m_Vertex[2][first]));
+        __m128 laneU = _mm_mul_ps(inverseDeterminant, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)));
+
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+        __m128 laneV = _mm_mul_ps(inverseDeterminant, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)));
+        __m128 laneT = _mm_mul_ps(inverseDeterminant, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)));
+
+        // Comparisons with NaN of degenerate triangles fail, so they drop out with parallel rays
+        __m128 absoluteDeterminant = _mm_andnot_ps(_mm_set1_ps(-0.f), determinant);
+        __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f);
+        __m128 valid = _mm_cmpge_ps(absoluteDeterminant, _mm_set1_ps(Math::Constants::Epsilon<float>));
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(laneU, zero), _mm_cmple_ps(laneU, one)));
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(laneV, zero), _mm_cmple_ps(_mm_add_ps(laneU, laneV), one)));
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(laneT, _mm_set1_ps(tMin)), _mm_cmple_ps(laneT, _mm_set1_ps(tMax))));
+
+        _mm_store_ps(t, laneT);
+        _mm_store_ps(u, laneU);
+        _mm_store_ps(v, laneV);
+        return _mm_movemask_ps(valid) & GetLaneMask(remaining);
+#else
+        int mask = 0;
+        for (int lane = 0; lane < Width; ++lane) {
+            int i = first + lane;
+            Math::Vector3f firstEdge(m_FirstEdge[0][i], m_FirstEdge[1][i], m_FirstEdge[2][i]);
+            Math::Vector3f secondEdge(m_SecondEdge[0][i], m_SecondEdge[1][i], m_SecondEdge[2][i]);
+
+            Math::Vector3f rayCrossEdge2 = Math::Cross(ray.direction, secondEdge);
+            float determinant = Math::Dot(firstEdge, rayCrossEdge2);
+            float inverseDeterminant = 1.f / determinant;
+
+            Math::Vector3f s = ray.origin - Math::Vector3f(m_Vertex[0][i], m_Vertex[1][i], m_Vertex[2][i]);
+            u[lane] = inverseDeterminant * Math::Dot(s, rayCrossEdge2);
+
+            Math::Vector3f sCrossEdge1 = Math::Cross(s, firstEdge);
+            v[lane] = inverseDeterminant * Math::Dot(ray.direction, sCrossEdge1);
+            t[lane] = inverseDeterminant * Math::Dot(secondEdge, sCrossEdge1);
+
+            bool valid = Math::Abs(determinant) >= Math::Constants::Epsilon<float> && u[lane] >= 0.f && u[lane] <= 1.f && v[lane] >= 0.f && u[lane] + v[lane] <= 1.f && t[lane] >= tMin && t[lane] <= tMax;
+            mask |= (valid ? 1 : 0) << lane;
+        }
+
+        return mask & GetLaneMask(remaining);
+#endif
+    }
+
+    //! Ray-sphere test of ```Width``` spheres starting at slot ```first```. Nearer root is taken if it lies in [tMin, tMax], otherwise further one. Returns mask of hits
+    inline int IntersectSpheres(const Ray &ray, int first, int remaining, float tMin, float tMax, float *t) const noexcept {
+        float a = Math::Dot(ray.direction, ray.direction);
+
+#ifdef PTRACE_USE_SSE
+        __m128 ox = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_loadu_ps(&m_Center[0][first]));
+        __m128 oy = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_loadu_ps(&m_Center[1][first]));
+        __m128 oz = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_loadu_ps(&m_Center[2][first]));
+
+        __m128 k = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, _mm_set1_ps(ray.direction.x)), _mm_mul_ps(oy, _mm_set1_ps(ray.direction.y))), _mm_mul_ps(oz, _mm_set1_ps(ray.direction.z)));
+        __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_mul_ps(oz, oz)), _mm_loadu_ps(&m_RadiusSquared[first]));
+        __m128 discriminant = _mm_sub_ps(_mm_mul_ps(k, k), _mm_mul_ps(_mm_set1_ps(a), c));
+
+        // Square root of negative discriminant is NaN, such lanes are dropped by its own test
+        __m128 root = _mm_sqrt_ps(discriminant);
+        __m128 negativeK = _mm_sub_ps(_mm_setzero_ps(), k);
+        __m128 t0 = _mm_div_ps(_mm_sub_ps(negativeK, root), _mm_set1_ps(a));
+        __m128 t1 = _mm_div_ps(_mm_add_ps(negativeK, root), _mm_set1_ps(a));
+
+        __m128 minimum = _mm_set1_ps(tMin), maximum = _mm_set1_ps(tMax);
+        __m128 valid0 = _mm_and_ps(_mm_cmpge_ps(t0, minimum), _mm_cmple_ps(t0, maximum));
+        __m128 valid1 = _mm_and_ps(_mm_cmpge_ps(t1, minimum), _mm_cmple_ps(t1, maximum));
+        __m128 valid = _mm_and_ps(_mm_cmpge_ps(discriminant, _mm_setzero_ps()), _mm_or_ps(valid0, valid1));
+
+        _mm_store_ps(t, _mm_or_ps(_mm_and_ps(valid0, t0), _mm_andnot_ps(valid0, t1)));
+        return _mm_movemask_ps(valid) & GetLaneMask(remaining);
+#else
+        int mask = 0;
+        for (int lane = 0; lane < Width; ++lane) {
+            int i = first + lane;
+            Math::Vector3f centerToOrigin = ray.origin - Math::Vector3f(m_Center[0][i], m_Center[1][i], m_Center[2][i]);
+
+            float k = Math::Dot(centerToOrigin, ray.direction);
+            float c = Math::Dot(centerToOrigin, centerToOrigin) - m_RadiusSquared[i];
+            float discriminant = k * k - a * c;
+            if (discriminant < 0.f) {
+                continue;
+            }
+
+            float t0 = (-k - Math::Sqrt(discriminant)) / a;
+            float t1 = (-k + Math::Sqrt(discriminant)) / a;
+
+            bool valid0 = t0 >= tMin && t0 <= tMax;
+            bool valid1 = t1 >= tMin && t1 <= tMax;
+            t[lane] = valid0 ? t0 : t1;
+            mask |= (valid0 || valid1 ? 1 : 0) << lane;
+        }
+
+        return mask & GetLaneMask(remaining);
+#endif
+    }
+
+private:
+    std::vector<ShapeType> m_Types;
+    //! Position of shape in arrays of its type
+    std::vector<int> m_Slots;
+
+    std::vector<float> m_Vertex[3];
+    std::vector<float> m_FirstEdge[3];
+    std::vector<float> m_SecondEdge[3];
+
+    std::vector<float> m_Center[3];
+    std::vector<float> m_RadiusSquared;
+};
+
+#endif
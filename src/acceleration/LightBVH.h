@@ -0,0 +1,131 @@
+#ifndef _LIGHT_BVH_H
+#define _LIGHT_BVH_H
+
+#include "../Light.h"
+
+#include <vector>
+#include <span>
+#include <algorithm>
+
+//! Binary tree over light sources. Every node stores bounds and total power, so lights can be picked by estimated contribution at shading point
+class LightBVH {
+private:
+    struct Node {
+        int index;
+        AABB aabb;
+        float power;
+
+        constexpr Node() noexcept :
+            index(-1), aabb(AABB::Empty()), power(0.f) {}
+
+        constexpr Node(int index, const AABB &aabb, float power) noexcept :
+            index(index), aabb(aabb), power(power) {}
+
+        constexpr Node(int index, const Node &left, const Node &right) noexcept :
+            index(index), aabb(left.aabb, right.aabb), power(left.power + right.power) {}
+
+        constexpr bool IsLeaf() const noexcept {
+            return index <= 0;
+        }
+    };
+
+public:
+    //! Constructs tree over given lights. Leaves store indices into ```lights```
+    inline LightBVH(std::span<const Light> lights) noexcept {
+        int n = static_cast<int>(lights.size());
+        if (n == 0) {
+            return;
+        }
+
+        std::vector<int> lightIndices(n);
+        for (int i = 0; i < n; ++i) {
+            lightIndices[i] = i;
+        }
+
+        m_Nodes.resize(2 * n);
+
+        int usedNodes = 1;
+        MakeHierarchy(lights, lightIndices, 1, 0, n, usedNodes);
+    }
+
+    //! Picks light by traversing the tree and choosing child proportionally to its importance at ```point```. Writes probability to ```pdf```
+    inline int Sample(const Math::Vector3f &point, float sample, float &pdf) const noexcept {
+        int nodeIndex = 1;
+        pdf = 1.f;
+
+        while (!m_Nodes[nodeIndex].IsLeaf()) {
+            int leftIndex = m_Nodes[nodeIndex].index;
+            int rightIndex = m_Nodes[nodeIndex].index | 1;
+
+            float leftImportance = GetImportance(m_Nodes[leftIndex], point);
+            float rightImportance = GetImportance(m_Nodes[rightIndex], point);
+            float totalImportance = leftImportance + rightImportance;
+
+            float leftProbability = totalImportance > 0.f ? leftImportance / totalImportance : 0.5f;
+
+            if (sample < leftProbability) {
+                sample = Math::Min(sample / leftProbability, OneMinusEpsilon);
+                pdf *= leftProbability;
+                nodeIndex = leftIndex;
+            } else {
+                sample = Math::Min((sample - leftProbability) / (1.f - leftProbability), OneMinusEpsilon);
+                pdf *= 1.f - leftProbability;
+                nodeIndex = rightIndex;
+            }
+        }
+
+        return -m_Nodes[nodeIndex].index;
+    }
+
+    //! Returns true if tree has no lights
+    inline bool Empty() const noexcept {
+        return m_Nodes.empty();
+    }
+
+private:
+    constexpr static float OneMinusEpsilon = 0x1.fffffep-1f;
+
+    //! Power divided by squared distance to node center, clamped by node size so that point inside node does not blow up
+    constexpr static float GetImportance(const Node &node, const Math::Vector3f &point) noexcept {
+        Math::Vector3f center = (node.aabb.min + node.aabb.max) * 0.5f;
+        Math::Vector3f halfDiagonal = (node.aabb.max - node.aabb.min) * 0.5f;
+        Math::Vector3f toCenter = center - point;
+
+        float distanceSquared = Math::Max(Math::Dot(toCenter, toCenter), Math::Dot(halfDiagonal, halfDiagonal));
+        return node.power / Math::Max(distanceSquared, Math::Constants::Epsilon<float>);
+    }
+
+    inline void MakeHierarchy(std::span<const Light> lights, std::vector<int> &lightIndices, int index, int low, int high, int &usedNodes) noexcept {
+        if (low + 1 == high) {
+            const Light &light = lights[lightIndices[low]];
+            m_Nodes[index] = Node(-lightIndices[low], light.GetObject()->GetBoundingBox(), light.GetPower());
+            return;
+        }
+
+        AABB centroidBounds = AABB::Empty();
+        for (int i = low; i < high; ++i) {
+            Math::Vector3f centroid = lights[lightIndices[i]].GetObject()->GetCentroid();
+            centroidBounds = AABB(centroidBounds, AABB(centroid, centroid));
+        }
+
+        Math::Vector3f extent = centroidBounds.max - centroidBounds.min;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+        int mid = (low + high) / 2;
+        std::nth_element(lightIndices.begin() + low, lightIndices.begin() + mid, lightIndices.begin() + high, [&lights, axis](int a, int b) {
+            return lights[a].GetObject()->GetCentroid()[axis] < lights[b].GetObject()->GetCentroid()[axis];
+        });
+
+        int leftIndex = ++usedNodes;
+        int rightIndex = ++usedNodes;
+        MakeHierarchy(lights, lightIndices, leftIndex, low, mid, usedNodes);
+        MakeHierarchy(lights, lightIndices, rightIndex, mid, high, usedNodes);
+
+        m_Nodes[index] = Node(leftIndex, m_Nodes[leftIndex], m_Nodes[rightIndex]);
+    }
+
+private:
+    std::vector<Node> m_Nodes;
+};
+
+#endif
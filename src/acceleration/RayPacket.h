@@ -0,0 +1,140 @@
+#ifndef _RAY_PACKET_H
+#define _RAY_PACKET_H
+
+#include "AABB.h"
+
+#include <bit>
+
+//! Group of ```Width``` rays traced together. Components are stored per lane, so box tests run on all lanes at once
+template<int Width>
+struct RayPacket {
+    static_assert(Width == 4 || Width == 8, "Packet width must be 4 or 8");
+
+    Ray rays[Width];
+    alignas(32) float originX[Width], originY[Width], originZ[Width];
+    alignas(32) float inverseDirectionX[Width], inverseDirectionY[Width], inverseDirectionZ[Width];
+
+    //! Bit per lane that holds valid ray
+    int activeMask;
+
+    //! True if all rays share origin and direction signs, so packet can be culled as a whole
+    bool coherent;
+    Math::Vector3f minInverseDirection, maxInverseDirection;
+
+    //! Constructs packet from first ```count``` rays, remaining lanes are inactive
+    inline RayPacket(const Ray *source, int count) noexcept :
+        activeMask((1 << count) - 1) {
+        for (int lane = 0; lane < Width; ++lane) {
+            rays[lane] = source[lane < count ? lane : 0];
+        }
+
+        Update();
+    }
+
+    //! Constructs packet of active lanes of ```other``` moved by ```transform```
+    inline RayPacket(const RayPacket &other, const Math::Matrix3x4f &transform) noexcept :
+        activeMask(other.activeMask) {
+        for (int lane = 0; lane < Width; ++lane) {
+            rays[lane] = other.rays[lane];
+            rays[lane].origin = Math::TransformPoint(transform, other.rays[lane].origin);
+            rays[lane].direction = Math::TransformVector(transform, other.rays[lane].direction);
+            rays[lane].inverseDirection = 1.f / rays[lane].direction;
+        }
+
+        Update();
+    }
+
+    //! Returns mask of lanes in ```mask``` that intersect ```aabb``` on [tMin, tMax[lane]]. Writes closest entry distance to ```nearestT```
+    inline int Intersect(const AABB &aabb, float tMin, const float *tMax, int mask, float &nearestT) const noexcept {
+        nearestT = Math::Constants::Infinity<float>;
+
+        // Whole coherent packet is culled first with single interval test
+        if (coherent) {
+            float packetTMax = tMax[0];
+            for (int lane = 1; lane < Width; ++lane) {
+                packetTMax = Math::Max(packetTMax, tMax[lane]);
+            }
+
+            if (Misses(aabb, tMin, packetTMax)) {
+                return 0;
+            }
+        }
+
+        alignas(32) float tNear[Width], tFar[Width];
+
+        for (int lane = 0; lane < Width; ++lane) {
+            float t0x = (aabb.min.x - originX[lane]) * inverseDirectionX[lane];
+            float t1x = (aabb.max.x - originX[lane]) * inverseDirectionX[lane];
+            float t0y = (aabb.min.y - originY[lane]) * inverseDirectionY[lane];
+            float t1y = (aabb.max.y - originY[lane]) * inverseDirectionY[lane];
+            float t0z = (aabb.min.z - originZ[lane]) * inverseDirectionZ[lane];
+            float t1z = (aabb.max.z - originZ[lane]) * inverseDirectionZ[lane];
+
+            tNear[lane] = Math::Max(Math::Max(tMin, Math::Min(t0x, t1x)), Math::Max(Math::Min(t0y, t1y), Math::Min(t0z, t1z)));
+            tFar[lane] = Math::Min(Math::Min(tMax[lane], Math::Max(t0x, t1x)), Math::Min(Math::Max(t0y, t1y), Math::Max(t0z, t1z)));
+        }
+
+        int result = 0;
+        for (int lane = 0; lane < Width; ++lane) {
+            if ((mask >> lane & 1) && tNear[lane] <= tFar[lane]) {
+                result |= 1 << lane;
+                nearestT = Math::Min(nearestT, tNear[lane]);
+            }
+        }
+
+        return result;
+    }
+
+    //! Interval arithmetic test of coherent packet. Returns true if no ray can intersect ```aabb``` on [tMin, tMax]
+    inline bool Misses(const AABB &aabb, float tMin, float tMax) const noexcept {
+        const Math::Vector3f &origin = rays[0].origin;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            bool positive = minInverseDirection[axis] > 0.f;
+            float nearDistance = (positive ? aabb.min[axis] : aabb.max[axis]) - origin[axis];
+            float farDistance = (positive ? aabb.max[axis] : aabb.min[axis]) - origin[axis];
+
+            tMin = Math::Max(tMin, Math::Min(nearDistance * minInverseDirection[axis], nearDistance * maxInverseDirection[axis]));
+            tMax = Math::Min(tMax, Math::Max(farDistance * minInverseDirection[axis], farDistance * maxInverseDirection[axis]));
+        }
+
+        return tMin > tMax;
+    }
+
+    //! Returns number of active lanes in ```mask```
+    constexpr static int CountLanes(int mask) noexcept {
+        return std::popcount(static_cast<unsigned>(mask));
+    }
+
+private:
+    inline void Update() noexcept {
+        for (int lane = 0; lane < Width; ++lane) {
+            originX[lane] = rays[lane].origin.x;
+            originY[lane] = rays[lane].origin.y;
+            originZ[lane] = rays[lane].origin.z;
+            inverseDirectionX[lane] = rays[lane].inverseDirection.x;
+            inverseDirectionY[lane] = rays[lane].inverseDirection.y;
+            inverseDirectionZ[lane] = rays[lane].inverseDirection.z;
+        }
+
+        // Inactive lanes repeat first ray, so they do not widen the interval
+        minInverseDirection = rays[0].inverseDirection;
+        maxInverseDirection = rays[0].inverseDirection;
+        coherent = true;
+        for (int lane = 0; lane < Width; ++lane) {
+            const Ray &ray = rays[lane];
+            coherent &= ray.origin.x == rays[0].origin.x && ray.origin.y == rays[0].origin.y && ray.origin.z == rays[0].origin.z;
+
+            minInverseDirection = Math::Min(minInverseDirection, ray.inverseDirection);
+            maxInverseDirection = Math::Max(maxInverseDirection, ray.inverseDirection);
+        }
+
+        // Interval bounds are valid only when every axis keeps its sign and stays finite
+        for (int axis = 0; axis < 3; ++axis) {
+            coherent &= minInverseDirection[axis] > 0.f || maxInverseDirection[axis] < 0.f;
+            coherent &= Math::Abs(minInverseDirection[axis]) < Math::Constants::Infinity<float> && Math::Abs(maxInverseDirection[axis]) < Math::Constants::Infinity<float>;
+        }
+    }
+};
+
+#endif
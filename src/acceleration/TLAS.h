@@ -2,9 +2,10 @@
 #define _TLAS_H
 
 #include <vector>
+#include <algorithm>
+#include <unordered_map>
 
 #include "BLAS.h"
-#include "../Utilities.hpp"
 
 //! Top-level acceleration structure. Used to combine multiple BLAS in one structure, also binary tree structured.
 class TLAS {
@@ -33,32 +34,223 @@ public:
         m_BLAS(blas.begin(), blas.end()) {
         int n = static_cast<int>(blas.size());
         m_Nodes.resize(2 * n);
+        m_Parents.resize(2 * n);
 
         int usedNodes = 1;
-        MakeHierarchyNaive(1, 0, n, usedNodes);
+        m_Parents[1] = 0;
+        MakeHierarchySAH(1, 0, n, usedNodes);
+
+        ComputeStackSize();
+    }
+
+    //! Brings leaves of ```blas``` up to date after their transforms or BVHs changed. Instances that stay inside their parent are refitted, others are reinserted. Unknown BLAS are ignored
+    inline void Update(std::span<const BLAS* const> blas) noexcept {
+        bool reinserted = false;
+        for (const BLAS *instance : blas) {
+            auto leaf = m_Leaves.find(instance);
+            if (leaf == m_Leaves.end()) {
+                continue;
+            }
+
+            // Refitted BVH may need deeper stack than it had when TLAS was built
+            m_BLASStackSize = Math::Max(m_BLASStackSize, instance->GetBVH()->GetStackSize());
+            m_StackSize = 2 * m_Depth + m_BLASStackSize;
+
+            int parentIndex = m_Parents[leaf->second];
+            if (parentIndex == 0 || m_Nodes[parentIndex].aabb.Contains(instance->GetLocalBoundingBox())) {
+                Refit(leaf->second);
+            } else {
+                Reinsert(leaf->second);
+                reinserted = true;
+            }
+        }
+
+        // Reinsertion next to internal node pushes its whole subtree one level down, so depth is measured again
+        if (reinserted) {
+            ComputeStackSize();
+        }
+    }
+
+    //! Returns expected number of nodes and BLAS bounds visited by random ray that hits root bounds. Walks the whole tree
+    inline float ComputeSAHCost() const noexcept {
+        float rootArea = m_Nodes[1].aabb.GetSurfaceArea();
+
+        float area = 0.f;
+        std::vector<int> nodes = {1};
+        while (!nodes.empty()) {
+            int nodeIndex = nodes.back();
+            nodes.pop_back();
+
+            area += m_Nodes[nodeIndex].aabb.GetSurfaceArea();
+            if (!m_Nodes[nodeIndex].IsLeaf()) {
+                nodes.push_back(m_Nodes[nodeIndex].index);
+                nodes.push_back(m_Nodes[nodeIndex].index | 1);
+            }
+        }
+
+        return rootArea > 0.f ? area / rootArea : 0.f;
     }
 
-    //! Performs worldray-TLAS intersection
+    //! Returns BLAS that ```HitPayload::instanceId``` refers to
+    constexpr const BLAS* GetInstance(int instanceId) const noexcept {
+        return m_BLAS[instanceId];
+    }
+
+    //! Performs worldray-TLAS intersection. Records index of hit BLAS as instance id
     inline bool Hit(const Ray &ray, float tMin, float tMax, HitPayload &payload) const noexcept {
         if (m_Nodes[1].aabb.Intersect(ray, tMin, tMax) == Math::Constants::Infinity<float>) {
             return false;
         }
 
-        const int TREE_DEPTH = 1024;
+        return HitSubtree(1, ray, tMin, tMax, payload, TraversalStack::Get(m_StackSize));
+    }
+
+    //! Performs packet-TLAS intersection of active lanes. Lanes left alone in a subtree continue as single rays. Returns mask of lanes that hit
+    template<int Width>
+    inline int Hit(const RayPacket<Width> &packet, float tMin, HitPayload *payloads) const noexcept {
+        alignas(32) float tMax[Width];
+        for (int lane = 0; lane < Width; ++lane) {
+            tMax[lane] = payloads[lane].t;
+        }
+
+        float rootT;
+        int rootMask = packet.Intersect(m_Nodes[1].aabb, tMin, tMax, packet.activeMask, rootT);
+        if (rootMask == 0) {
+            return 0;
+        }
+
+        TraversalEntry *stack = TraversalStack::Get(m_StackSize);
 
         int nodeIndex = 1;
-        int nodeIndices[TREE_DEPTH];
+        int nodeMask = rootMask;
+        int stackPointer = 1;
+
+        int hitMask = 0;
+        while (stackPointer > 0) {
+            if (RayPacket<Width>::CountLanes(nodeMask) == 1) {
+                int lane = std::countr_zero(static_cast<unsigned>(nodeMask));
+                if (HitSubtree(nodeIndex, packet.rays[lane], tMin, tMax[lane], payloads[lane], stack + stackPointer)) {
+                    hitMask |= nodeMask;
+                    tMax[lane] = Math::Min(tMax[lane], payloads[lane].t);
+                }
+
+                --stackPointer;
+                nodeIndex = stack[stackPointer].index;
+                nodeMask = stack[stackPointer].count;
+                continue;
+            }
+
+            if (m_Nodes[nodeIndex].IsLeaf()) {
+                int blasIndex = -m_Nodes[nodeIndex].index;
+                int leafHitMask = m_BLAS[blasIndex]->Hit(packet, nodeMask, tMin, tMax, payloads, stack + stackPointer);
+                for (int mask = leafHitMask; mask != 0; mask &= mask - 1) {
+                    payloads[std::countr_zero(static_cast<unsigned>(mask))].instanceId = blasIndex;
+                }
+                hitMask |= leafHitMask;
+
+                --stackPointer;
+                nodeIndex = stack[stackPointer].index;
+                nodeMask = stack[stackPointer].count;
+                continue;
+            }
+
+            int closestIndex = m_Nodes[nodeIndex].index;
+            int furthestIndex = m_Nodes[nodeIndex].index | 1;
+
+            float closestT, furthestT;
+            int closestMask = packet.Intersect(m_Nodes[closestIndex].aabb, tMin, tMax, nodeMask, closestT);
+            int furthestMask = packet.Intersect(m_Nodes[furthestIndex].aabb, tMin, tMax, nodeMask, furthestT);
+
+            if (closestT > furthestT) {
+                std::swap(closestT, furthestT);
+                std::swap(closestIndex, furthestIndex);
+                std::swap(closestMask, furthestMask);
+            }
+
+            if (closestMask == 0) {
+                --stackPointer;
+                nodeIndex = stack[stackPointer].index;
+                nodeMask = stack[stackPointer].count;
+                continue;
+            }
+
+            nodeIndex = closestIndex;
+            nodeMask = closestMask;
+
+            if (furthestMask != 0) {
+                // Lane mask of packet entry is kept in its count
+                stack[stackPointer++] = {furthestIndex, furthestMask, furthestT};
+            }
+        }
+
+        return hitMask;
+    }
+
+    //! Performs worldray-TLAS occlusion test. Stops at first hit in [tMin, tMax]
+    inline bool Occluded(const Ray &ray, float tMin, float tMax) const noexcept {
+        if (m_Nodes[1].aabb.Intersect(ray, tMin, tMax) == Math::Constants::Infinity<float>) {
+            return false;
+        }
+
+        TraversalEntry *stack = TraversalStack::Get(m_StackSize);
+
+        int nodeIndex = 1;
+        int stackPointer = 1;
+
+        while (stackPointer > 0) {
+            if (m_Nodes[nodeIndex].IsLeaf()) {
+                int blasIndex = -m_Nodes[nodeIndex].index;
+                if (m_BLAS[blasIndex]->Occluded(ray, tMin, tMax, stack + stackPointer)) {
+                    return true;
+                }
+
+                nodeIndex = stack[--stackPointer].index;
+                continue;
+            }
+
+            int closestIndex = m_Nodes[nodeIndex].index;
+            int furthestIndex = m_Nodes[nodeIndex].index | 1;
+
+            float closestT = m_Nodes[closestIndex].aabb.Intersect(ray, tMin, tMax);
+            float furthestT = m_Nodes[furthestIndex].aabb.Intersect(ray, tMin, tMax);
+
+            if (closestT > furthestT) {
+                std::swap(closestT, furthestT);
+                std::swap(closestIndex, furthestIndex);
+            }
+
+            if (closestT == Math::Constants::Infinity<float>) {
+                nodeIndex = stack[--stackPointer].index;
+                continue;
+            }
+
+            nodeIndex = closestIndex;
 
+            if (furthestT != Math::Constants::Infinity<float>) {
+                stack[stackPointer++].index = furthestIndex;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    //! Traversal of single ray starting at node ```rootIndex```
+    inline bool HitSubtree(int rootIndex, const Ray &ray, float tMin, float tMax, HitPayload &payload, TraversalEntry *stack) const noexcept {
+        int nodeIndex = rootIndex;
         int stackPointer = 1;
 
         bool anyHit = false;
         while (stackPointer > 0) {
             if (m_Nodes[nodeIndex].IsLeaf()) {
                 int blasIndex = -m_Nodes[nodeIndex].index;
-                anyHit |= m_BLAS[blasIndex]->Hit(ray, tMin, tMax, payload);
+                if (m_BLAS[blasIndex]->Hit(ray, tMin, tMax, payload, stack + stackPointer)) {
+                    payload.instanceId = blasIndex;
+                    anyHit = true;
+                }
                 tMax = Math::Min(tMax, payload.t);
                 
-                nodeIndex = nodeIndices[--stackPointer];
+                nodeIndex = stack[--stackPointer].index;
                 continue;
             }
 
@@ -74,41 +266,192 @@ public:
             }
 
             if (closestT == Math::Constants::Infinity<float>) {
-                nodeIndex = nodeIndices[--stackPointer];
+                nodeIndex = stack[--stackPointer].index;
                 continue;
             }
 
             nodeIndex = closestIndex;
 
             if (furthestT != Math::Constants::Infinity<float>) {
-                nodeIndices[stackPointer++] = furthestIndex;
+                stack[stackPointer++].index = furthestIndex;
             }
         }
 
         return anyHit;
     }
 
-private:
-    inline void MakeHierarchyNaive(int index, int low, int high, int &usedNodes) noexcept {
+    //! TLAS entries, packet entries plus single ray subtree, are followed by entries of the deepest BLAS
+    inline void ComputeStackSize() noexcept {
+        int depth = 0;
+        int blasStackSize = 0;
+
+        std::vector<std::pair<int, int>> nodes = {{1, 1}};
+        while (!nodes.empty()) {
+            auto [nodeIndex, nodeDepth] = nodes.back();
+            nodes.pop_back();
+
+            depth = Math::Max(depth, nodeDepth);
+            if (m_Nodes[nodeIndex].IsLeaf()) {
+                blasStackSize = Math::Max(blasStackSize, m_BLAS[-m_Nodes[nodeIndex].index]->GetBVH()->GetStackSize());
+            } else {
+                nodes.push_back({m_Nodes[nodeIndex].index, nodeDepth + 1});
+                nodes.push_back({m_Nodes[nodeIndex].index | 1, nodeDepth + 1});
+            }
+        }
+
+        m_Depth = depth;
+        m_BLASStackSize = blasStackSize;
+        m_StackSize = 2 * depth + blasStackSize;
+    }
+
+    //! Sets bounds of leaf ```leafIndex``` from its BLAS and unites children of its ancestors up to root
+    inline void Refit(int leafIndex) noexcept {
+        m_Nodes[leafIndex].aabb = m_BLAS[-m_Nodes[leafIndex].index]->GetLocalBoundingBox();
+        RefitAncestors(leafIndex);
+    }
+
+    inline void RefitAncestors(int nodeIndex) noexcept {
+        for (int parentIndex = m_Parents[nodeIndex]; parentIndex != 0; parentIndex = m_Parents[parentIndex]) {
+            int childIndex = m_Nodes[parentIndex].index;
+            m_Nodes[parentIndex].aabb = AABB(m_Nodes[childIndex].aabb, m_Nodes[childIndex | 1].aabb);
+        }
+    }
+
+    //! Removes leaf ```leafIndex``` with its sibling taking place of their parent, then inserts it next to the node where it adds least area. Freed pair of slots holds the new children, so node array does not grow. Stack size has to be computed again afterwards
+    inline void Reinsert(int leafIndex) noexcept {
+        int blasIndex = -m_Nodes[leafIndex].index;
+        int pairIndex = leafIndex & ~1;
+        int parentIndex = m_Parents[leafIndex];
+
+        MoveNode(leafIndex ^ 1, parentIndex);
+        RefitAncestors(parentIndex);
+
+        AABB aabb = m_BLAS[blasIndex]->GetLocalBoundingBox();
+        int siblingIndex = FindBestSibling(aabb);
+
+        MoveNode(siblingIndex, pairIndex);
+        m_Nodes[pairIndex | 1] = Node(-blasIndex, aabb);
+        m_Parents[pairIndex] = siblingIndex;
+        m_Parents[pairIndex | 1] = siblingIndex;
+        m_Leaves[m_BLAS[blasIndex]] = pairIndex | 1;
+
+        m_Nodes[siblingIndex] = Node(pairIndex, m_Nodes[pairIndex], m_Nodes[pairIndex | 1]);
+        RefitAncestors(siblingIndex);
+    }
+
+    //! Copies node ```from``` into slot ```to``` and points its children or BLAS back at it. Parent of slot ```to``` stays
+    inline void MoveNode(int from, int to) noexcept {
+        m_Nodes[to] = m_Nodes[from];
+        if (m_Nodes[to].IsLeaf()) {
+            m_Leaves[m_BLAS[-m_Nodes[to].index]] = to;
+        } else {
+            m_Parents[m_Nodes[to].index] = to;
+            m_Parents[m_Nodes[to].index | 1] = to;
+        }
+    }
+
+    //! Descends from root towards child whose growth costs least, stops where pairing with the node itself is cheaper
+    inline int FindBestSibling(const AABB &aabb) const noexcept {
+        int nodeIndex = 1;
+        while (!m_Nodes[nodeIndex].IsLeaf()) {
+            float area = m_Nodes[nodeIndex].aabb.GetSurfaceArea();
+            float combinedArea = AABB(m_Nodes[nodeIndex].aabb, aabb).GetSurfaceArea();
+
+            // New parent here costs its whole area, going deeper makes this node grow
+            float cost = 2.f * combinedArea;
+            float inheritedCost = 2.f * (combinedArea - area);
+
+            int bestChild = -1;
+            float bestCost = cost;
+            for (int childIndex : {m_Nodes[nodeIndex].index, m_Nodes[nodeIndex].index | 1}) {
+                const Node &child = m_Nodes[childIndex];
+                float childCost = AABB(child.aabb, aabb).GetSurfaceArea() + inheritedCost;
+                if (!child.IsLeaf()) {
+                    childCost -= child.aabb.GetSurfaceArea();
+                }
+
+                if (childCost < bestCost) {
+                    bestCost = childCost;
+                    bestChild = childIndex;
+                }
+            }
+
+            if (bestChild < 0) {
+                break;
+            }
+
+            nodeIndex = bestChild;
+        }
+
+        return nodeIndex;
+    }
+
+    //! Sweeps instances sorted by centroid of their world bounds along every axis and splits where children have lowest SAH cost. Stable sort keeps the tree the same between runs
+    inline void MakeHierarchySAH(int index, int low, int high, int &usedNodes) noexcept {
         if (low + 1 == high) {
             m_Nodes[index] = Node(-low, m_BLAS[low]->GetLocalBoundingBox());
+            m_Leaves[m_BLAS[low]] = index;
             return;
         }
 
-        std::shuffle(m_BLAS.begin() + low, m_BLAS.begin() + high, Utilities::s_RandomNumberGenerator);
+        int n = high - low;
+        std::vector<float> suffixAreas(n);
+
+        float minCost = Math::Constants::Infinity<float>;
+        int mid = -1;
+        int axis = -1;
+
+        for (int d = 0; d < 3; ++d) {
+            SortByCentroid(low, high, d);
+
+            AABB suffix = AABB::Empty();
+            for (int i = n - 1; i > 0; --i) {
+                suffix = AABB(m_BLAS[low + i]->GetLocalBoundingBox(), suffix);
+                suffixAreas[i] = suffix.GetSurfaceArea();
+            }
+
+            AABB prefix = AABB::Empty();
+            for (int i = 1; i < n; ++i) {
+                prefix = AABB(prefix, m_BLAS[low + i - 1]->GetLocalBoundingBox());
+                float cost = prefix.GetSurfaceArea() * static_cast<float>(i) + suffixAreas[i] * static_cast<float>(n - i);
+                if (cost < minCost) {
+                    minCost = cost;
+                    mid = low + i;
+                    axis = d;
+                }
+            }
+        }
+
+        if (axis != 2) {
+            SortByCentroid(low, high, axis);
+        }
 
         int leftIndex = ++usedNodes;
         int rightIndex = ++usedNodes;
-        int mid = (low + high) / 2;
-        MakeHierarchyNaive(leftIndex, low, mid, usedNodes);
-        MakeHierarchyNaive(rightIndex, mid, high, usedNodes);
+        m_Parents[leftIndex] = index;
+        m_Parents[rightIndex] = index;
+        MakeHierarchySAH(leftIndex, low, mid, usedNodes);
+        MakeHierarchySAH(rightIndex, mid, high, usedNodes);
 
         m_Nodes[index] = Node(leftIndex, m_Nodes[leftIndex], m_Nodes[rightIndex]);
     }
 
+    inline void SortByCentroid(int low, int high, int axis) noexcept {
+        std::stable_sort(m_BLAS.begin() + low, m_BLAS.begin() + high, [axis](const BLAS *a, const BLAS *b) {
+            AABB aabbA = a->GetLocalBoundingBox(), aabbB = b->GetLocalBoundingBox();
+            return aabbA.min[axis] + aabbA.max[axis] < aabbB.min[axis] + aabbB.max[axis];
+        });
+    }
+
 private:
     std::vector<Node> m_Nodes;
+    //! Parent of every node, 0 for root
+    std::vector<int> m_Parents;
     std::vector<const BLAS*> m_BLAS;
+    std::unordered_map<const BLAS*, int> m_Leaves;
+    int m_Depth;
+    int m_BLASStackSize;
+    int m_StackSize;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef _TRAVERSAL_STACK_H
+#define _TRAVERSAL_STACK_H
+
+#include <vector>
+
+//! Entry of traversal stack. Node to visit, hittable count of wide leaf or lane mask of packet, and entry distance
+struct TraversalEntry {
+    int index;
+    int count;
+    float t;
+};
+
+//! Per thread storage of traversal stacks. TLAS traversal passes its top to BLAS and BVH, so nested traversals continue on the same stack
+class TraversalStack {
+public:
+    constexpr TraversalStack() noexcept = delete;
+    constexpr TraversalStack(const TraversalStack&) = delete;
+    constexpr TraversalStack(TraversalStack&&) = delete;
+
+    //! Returns stack of calling thread with room for ```size``` entries. Storage only grows, so it settles at depth of the deepest tree
+    inline static TraversalEntry* Get(int size) noexcept {
+        thread_local std::vector<TraversalEntry> s_Entries;
+        if (static_cast<int>(s_Entries.size()) < size) {
+            s_Entries.resize(size);
+        }
+
+        return s_Entries.data();
+    }
+};
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef _WIDE_NODE_H
+#define _WIDE_NODE_H
+
+#include "AABB.h"
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define PTRACE_USE_SSE
+#include <emmintrin.h>
+#endif
+
+//! Ray prepared for slab tests against all children of wide node at once
+struct WideRay {
+    alignas(16) float originX[4], originY[4], originZ[4];
+    alignas(16) float inverseDirectionX[4], inverseDirectionY[4], inverseDirectionZ[4];
+    //! True if ray enters boxes through max plane of axis
+    bool negativeX, negativeY, negativeZ;
+
+    inline WideRay(const Ray &ray) noexcept :
+        negativeX(ray.inverseDirection.x < 0.f), negativeY(ray.inverseDirection.y < 0.f), negativeZ(ray.inverseDirection.z < 0.f) {
+        for (int i = 0; i < 4; ++i) {
+            originX[i] = ray.origin.x;
+            originY[i] = ray.origin.y;
+            originZ[i] = ray.origin.z;
+            inverseDirectionX[i] = ray.inverseDirection.x;
+            inverseDirectionY[i] = ray.inverseDirection.y;
+            inverseDirectionZ[i] = ray.inverseDirection.z;
+        }
+    }
+
+    //! Returns mask of boxes given per axis that are intersected on [tMin, tMax]. Writes entry distances to ```tNear```
+    inline int Intersect(const float *minX, const float *minY, const float *minZ, const float *maxX, const float *maxY, const float *maxZ, float tMin, float tMax, float *tNear) const noexcept {
+        const float *nearX = negativeX ? maxX : minX, *farX = negativeX ? minX : maxX;
+        const float *nearY = negativeY ? maxY : minY, *farY = negativeY ? minY : maxY;
+        const float *nearZ = negativeZ ? maxZ : minZ, *farZ = negativeZ ? minZ : maxZ;
+
+#ifdef PTRACE_USE_SSE
+        __m128 ox = _mm_load_ps(originX), ix = _mm_load_ps(inverseDirectionX);
+        __m128 oy = _mm_load_ps(originY), iy = _mm_load_ps(inverseDirectionY);
+        __m128 oz = _mm_load_ps(originZ), iz = _mm_load_ps(inverseDirectionZ);
+
+        __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearX), ox), ix);
+        __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearY), oy), iy);
+        __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearZ), oz), iz);
+        __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(farX), ox), ix);
+        __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(farY), oy), iy);
+        __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(farZ), oz), iz);
+
+        // Interval bound goes last, so NaN of degenerate slab is replaced by it
+        __m128 entry = _mm_max_ps(t0x, _mm_max_ps(t0y, _mm_max_ps(t0z, _mm_set1_ps(tMin))));
+        __m128 exit = _mm_min_ps(t1x, _mm_min_ps(t1y, _mm_min_ps(t1z, _mm_set1_ps(tMax))));
+
+        _mm_storeu_ps(tNear, entry);
+        return _mm_movemask_ps(_mm_cmple_ps(entry, exit));
+#else
+        int mask = 0;
+        for (int i = 0; i < 4; ++i) {
+            float entry = Math::Max(Math::Max(tMin, (nearZ[i] - originZ[i]) * inverseDirectionZ[i]), Math::Max((nearX[i] - originX[i]) * inverseDirectionX[i], (nearY[i] - originY[i]) * inverseDirectionY[i]));
+            float exit = Math::Min(Math::Min(tMax, (farZ[i] - originZ[i]) * inverseDirectionZ[i]), Math::Min((farX[i] - originX[i]) * inverseDirectionX[i], (farY[i] - originY[i]) * inverseDirectionY[i]));
+
+            tNear[i] = entry;
+            mask |= (entry <= exit ? 1 : 0) << i;
+        }
+
+        return mask;
+#endif
+    }
+};
+
+//! Node of 4-wide BVH. Child bounds are stored per axis, so one slab test covers all children. Unused slots hold empty boxes that never intersect
+struct alignas(16) WideNode {
+    constexpr static int Width = 4;
+
+    float minX[Width], minY[Width], minZ[Width];
+    float maxX[Width], maxY[Width], maxZ[Width];
+    //! Leaf child holds ```counts[i]``` hittables starting at ```-children[i]```, internal child with zero count is wide node ```children[i]```
+    int children[Width];
+    int counts[Width];
+
+    inline WideNode() noexcept {
+        for (int i = 0; i < Width; ++i) {
+            SetChild(i, AABB::Empty(), 0, 0);
+        }
+    }
+
+    inline void SetChild(int slot, const AABB &aabb, int child, int count) noexcept {
+        minX[slot] = aabb.min.x;
+        minY[slot] = aabb.min.y;
+        minZ[slot] = aabb.min.z;
+        maxX[slot] = aabb.max.x;
+        maxY[slot] = aabb.max.y;
+        maxZ[slot] = aabb.max.z;
+        children[slot] = child;
+        counts[slot] = count;
+    }
+
+    constexpr bool IsLeaf(int slot) const noexcept {
+        return counts[slot] > 0;
+    }
+
+    //! Returns mask of children intersected on [tMin, tMax]. Writes entry distances to ```tNear```
+    inline int Intersect(const WideRay &ray, float tMin, float tMax, float *tNear) const noexcept {
+        return ray.Intersect(minX, minY, minZ, maxX, maxY, maxZ, tMin, tMax, tNear);
+    }
+};
+
+//! Wide node that stores child bounds as 8-bit offsets inside node bounds. Offsets are scaled by power of two and rounded outwards, so boxes only grow. Fits one cache line
+struct alignas(64) QuantizedWideNode {
+    constexpr static int Width = WideNode::Width;
+
+    int children[Width];
+    float origin[3];
+    std::uint8_t minX[Width], minY[Width], minZ[Width];
+    std::uint8_t maxX[Width], maxY[Width], maxZ[Width];
+    //! Leaf sizes are limited to one byte
+    std::uint8_t counts[Width];
+    std::int8_t exponents[3];
+
+    //! Quantizes bounds of ```node``` children. Unused slots get inverted boxes that never intersect
+    inline QuantizedWideNode(const WideNode &node) noexcept {
+        const float *mins[3] = {node.minX, node.minY, node.minZ};
+        const float *maxs[3] = {node.maxX, node.maxY, node.maxZ};
+        std::uint8_t *quantizedMins[3] = {minX, minY, minZ};
+        std::uint8_t *quantizedMaxs[3] = {maxX, maxY, maxZ};
+
+        for (int axis = 0; axis < 3; ++axis) {
+            float low = Math::Constants::Infinity<float>, high = -Math::Constants::Infinity<float>;
+            for (int i = 0; i < Width; ++i) {
+                if (mins[axis][i] <= maxs[axis][i]) {
+                    low = Math::Min(low, mins[axis][i]);
+                    high = Math::Max(high, maxs[axis][i]);
+                }
+            }
+
+            int exponent = high > low ? Math::Clamp(std::ilogb((high - low) / 255.f), -126, 127) : -126;
+            while (exponent < 127 && low + 255.f * GetScale(exponent) < high) {
+                ++exponent;
+            }
+
+            origin[axis] = low;
+            exponents[axis] = static_cast<std::int8_t>(exponent);
+
+            float scale = GetScale(exponent);
+            for (int i = 0; i < Width; ++i) {
+                if (mins[axis][i] > maxs[axis][i]) {
+                    quantizedMins[axis][i] = 255;
+                    quantizedMaxs[axis][i] = 0;
+                    continue;
+                }
+
+                int quantizedMin = Math::Clamp(static_cast<int>(std::floor((mins[axis][i] - low) / scale)), 0, 255);
+                while (quantizedMin > 0 && low + static_cast<float>(quantizedMin) * scale > mins[axis][i]) {
+                    --quantizedMin;
+                }
+
+                int quantizedMax = Math::Clamp(static_cast<int>(std::ceil((maxs[axis][i] - low) / scale)), 0, 255);
+                while (quantizedMax < 255 && low + static_cast<float>(quantizedMax) * scale < maxs[axis][i]) {
+                    ++quantizedMax;
+                }
+
+                quantizedMins[axis][i] = static_cast<std::uint8_t>(quantizedMin);
+                quantizedMaxs[axis][i] = static_cast<std::uint8_t>(quantizedMax);
+            }
+        }
+
+        for (int i = 0; i < Width; ++i) {
+            children[i] = node.children[i];
+            counts[i] = static_cast<std::uint8_t>(node.counts[i]);
+        }
+    }
+
+    constexpr bool IsLeaf(int slot) const noexcept {
+        return counts[slot] > 0;
+    }
+
+    //! Returns mask of children intersected on [tMin, tMax]. Writes entry distances to ```tNear```
+    inline int Intersect(const WideRay &ray, float tMin, float tMax, float *tNear) const noexcept {
+        alignas(16) float bounds[6][Width];
+        Decode(minX, 0, bounds[0]);
+        Decode(minY, 1, bounds[1]);
+        Decode(minZ, 2, bounds[2]);
+        Decode(maxX, 0, bounds[3]);
+        Decode(maxY, 1, bounds[4]);
+        Decode(maxZ, 2, bounds[5]);
+
+        return ray.Intersect(bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5], tMin, tMax, tNear);
+    }
+
+private:
+    constexpr static float GetScale(int exponent) noexcept {
+        return std::bit_cast<float>(static_cast<std::uint32_t>(exponent + 127) << 23);
+    }
+
+    inline void Decode(const std::uint8_t *quantized, int axis, float *values) const noexcept {
+        float scale = GetScale(exponents[axis]);
+
+#ifdef PTRACE_USE_SSE
+        int packed;
+        std::memcpy(&packed, quantized, sizeof(packed));
+
+        __m128i zero = _mm_setzero_si128();
+        __m128i offsets = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+        _mm_store_ps(values, _mm_add_ps(_mm_set1_ps(origin[axis]), _mm_mul_ps(_mm_cvtepi32_ps(offsets), _mm_set1_ps(scale))));
+#else
+        for (int i = 0; i < Width; ++i) {
+            values[i] = origin[axis] + static_cast<float>(quantized[i]) * scale;
+        }
+#endif
+    }
+};
+
+#endif
@@ -2,11 +2,14 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "AssetLoader.h"
 
+#define STB_IMAGE_IMPLEMENTATION
 #include "../../stb-master/stb_image.h"
 
 AssetLoader::AssetLoader() noexcept {
     m_LoadingProperties.generateSmoothNormals = true;
     m_LoadingProperties.surfaceAreaWeighting = true;
+    m_LoadingProperties.bvhBuildOptions = BVHBuildOptions();
+    m_LoadingProperties.cacheBVH = true;
 }
 
 AssetLoader::~AssetLoader() noexcept {
@@ -49,7 +52,15 @@ std::pair<ModelInstance*, AssetLoader::Result> AssetLoader::LoadOBJ(const std::f
         meshes.push_back(ProcessMesh(attrib, mesh));
     }
 
-    Model *model = new Model(pathToFile, materialDirectory, std::move(meshes), std::move(pbrMaterials), totalFaceCount);
+    // Models of the same name in shared directory evict each other, cache key in file tells them apart
+    std::filesystem::path bvhCachePath;
+    if (m_LoadingProperties.cacheBVH) {
+        std::filesystem::path fileName = pathToFile.filename();
+        fileName += ".bvh";
+        bvhCachePath = m_LoadingProperties.bvhCacheDirectory.empty() ? pathToFile.parent_path() / fileName : m_LoadingProperties.bvhCacheDirectory / fileName;
+    }
+
+    Model *model = new Model(pathToFile, materialDirectory, std::move(meshes), std::move(pbrMaterials), totalFaceCount, m_LoadingProperties.bvhBuildOptions, bvhCachePath);
 
     int modelIndex = static_cast<int>(m_Models.size());
 
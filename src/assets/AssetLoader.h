@@ -30,6 +30,11 @@ public:
     struct LoadingProperties {
         bool generateSmoothNormals;
         bool surfaceAreaWeighting;
+        BVHBuildOptions bvhBuildOptions;
+        //! Stores built BVHs on disk and maps them on later loads of the same model
+        bool cacheBVH;
+        //! Cache files go here, next to model file if empty
+        std::filesystem::path bvhCacheDirectory;
     };
 
 public:
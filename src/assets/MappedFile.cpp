@@ -0,0 +1,70 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::filesystem::path &path) noexcept {
+#ifdef _WIN32
+    m_File = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_File == INVALID_HANDLE_VALUE) {
+        m_File = nullptr;
+        return;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0) {
+        return;
+    }
+
+    m_Mapping = CreateFileMappingW(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_Mapping == nullptr) {
+        return;
+    }
+
+    m_Data = static_cast<const std::byte*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+    m_Size = m_Data != nullptr ? static_cast<std::size_t>(size.QuadPart) : 0;
+#else
+    int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        return;
+    }
+
+    // Mapping stays valid after descriptor is closed
+    struct stat status;
+    if (fstat(descriptor, &status) == 0 && status.st_size > 0) {
+        void *data = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (data != MAP_FAILED) {
+            m_Data = static_cast<const std::byte*>(data);
+            m_Size = static_cast<std::size_t>(status.st_size);
+        }
+    }
+
+    close(descriptor);
+#endif
+}
+
+MappedFile::~MappedFile() noexcept {
+#ifdef _WIN32
+    if (m_Data != nullptr) {
+        UnmapViewOfFile(m_Data);
+    }
+    if (m_Mapping != nullptr) {
+        CloseHandle(m_Mapping);
+    }
+    if (m_File != nullptr) {
+        CloseHandle(m_File);
+    }
+#else
+    if (m_Data != nullptr) {
+        munmap(const_cast<std::byte*>(m_Data), m_Size);
+    }
+#endif
+}
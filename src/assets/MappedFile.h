@@ -0,0 +1,40 @@
+#ifndef _MAPPED_FILE_H
+#define _MAPPED_FILE_H
+
+#include <filesystem>
+#include <span>
+#include <cstddef>
+
+//! Read-only view of whole file mapped into memory. Pages are loaded by the OS on first access, so nothing is copied up front
+class MappedFile {
+public:
+    //! Maps file at ```path```. IsOpen returns false if it does not exist or can not be mapped
+    MappedFile(const std::filesystem::path &path) noexcept;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    ~MappedFile() noexcept;
+
+    //! Returns true if file is mapped
+    constexpr bool IsOpen() const noexcept {
+        return m_Data != nullptr;
+    }
+
+    //! Returns mapped bytes of file
+    constexpr std::span<const std::byte> GetData() const noexcept {
+        return {m_Data, m_Size};
+    }
+
+private:
+    const std::byte *m_Data = nullptr;
+    std::size_t m_Size = 0;
+#ifdef _WIN32
+    void *m_File = nullptr;
+    void *m_Mapping = nullptr;
+#endif
+};
+
+#endif
@@ -1,7 +1,8 @@
 #include "Model.h"
 #include "../hittable/Polygon.h"
+#include "../acceleration/BVHCache.h"
 
-Model::Model(const std::filesystem::path &pathToFile, const std::filesystem::path &materialDirectory, std::vector<Mesh*> &&meshes, std::vector<Material> &&materials, int totalFaceCount) noexcept : 
+Model::Model(const std::filesystem::path &pathToFile, const std::filesystem::path &materialDirectory, std::vector<Mesh*> &&meshes, std::vector<Material> &&materials, int totalFaceCount, const BVHBuildOptions &buildOptions, const std::filesystem::path &bvhCachePath) noexcept :
     m_PathToFile(pathToFile), m_MaterialDirectory(materialDirectory), m_Meshes(std::move(meshes)), m_Materials(std::move(materials)) {
     m_Polygons.reserve(totalFaceCount);
     for (int meshIndex = 0; meshIndex < static_cast<int>(m_Meshes.size()); ++meshIndex) {
@@ -20,7 +21,24 @@ Model::Model(const std::filesystem::path &pathToFile, const std::filesystem::pat
         hittables.push_back(&polygon);
     }
 
-    m_BVH = new BVH(hittables);
+    if (bvhCachePath.empty()) {
+        m_BVH = new BVH(hittables, buildOptions);
+        return;
+    }
+
+    // Polygons follow meshes face by face, so vertices and indices determine hittables and their order
+    std::uint64_t dataHash = BVHCache::HashSeed;
+    for (const auto mesh : m_Meshes) {
+        dataHash = BVHCache::Hash(std::as_bytes(mesh->GetVertices()), dataHash);
+        dataHash = BVHCache::Hash(std::as_bytes(mesh->GetIndices()), dataHash);
+    }
+    std::uint64_t key = BVHCache::ComputeKey(dataHash, buildOptions);
+
+    m_BVH = BVHCache::Load(bvhCachePath, key, hittables);
+    if (m_BVH == nullptr) {
+        m_BVH = new BVH(hittables, buildOptions);
+        BVHCache::Store(bvhCachePath, key, *m_BVH, hittables);
+    }
 }
 
 Model::~Model() noexcept {
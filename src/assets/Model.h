@@ -14,8 +14,8 @@ class Polygon;
 //! Class that holds information about .obj model
 class Model {
 public:
-    //! Constructs model with given parameters
-    Model(const std::filesystem::path &pathToFile, const std::filesystem::path &materialDirectory, std::vector<Mesh*> &&meshes, std::vector<Material> &&materials, int totalFaceCount) noexcept;
+    //! Constructs model with given parameters. BVH is loaded from ```bvhCachePath``` if it holds tree of the same meshes and options, otherwise built and stored there. Empty path disables cache
+    Model(const std::filesystem::path &pathToFile, const std::filesystem::path &materialDirectory, std::vector<Mesh*> &&meshes, std::vector<Material> &&materials, int totalFaceCount, const BVHBuildOptions &buildOptions, const std::filesystem::path &bvhCachePath = {}) noexcept;
 
     ~Model() noexcept;
 
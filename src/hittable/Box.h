@@ -43,6 +43,24 @@ namespace Shapes {
             return anyHit;
         }
 
+        //! Is never called, Hit records the hit triangle, which finishes the interaction itself
+        constexpr void ComputeSurfaceInteraction(const Ray &ray, HitPayload &payload) const noexcept override {}
+
+        //! Checks if ray hits any of Box triangles in [tMin, tMax]
+        constexpr bool Occluded(const Ray &ray, float tMin, float tMax) const noexcept override {
+            if (aabb.Intersect(ray, tMin, tMax) == Math::Constants::Infinity<float>) {
+                return false;
+            }
+
+            for (int i = 0; i < 12; ++i) {
+                if (triangles[i].Occluded(ray, tMin, tMax)) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
         //! Returns centroid of Box, i.e. average of ```min``` and ```max```
         constexpr Math::Vector3f GetCentroid() const noexcept override {
             return (aabb.min + aabb.max) * 0.5f;
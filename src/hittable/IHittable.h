@@ -4,6 +4,24 @@
 #include "../HitPayload.h"
 #include "../acceleration/AABB.h"
 
+#include <array>
+#include <cstdint>
+#include <utility>
+
+//! Type of built-in shape, BVH leaves test known types in batches without virtual calls
+enum class ShapeType : std::uint8_t {
+    Other = 0,
+    Triangle,
+    Sphere
+};
+
+//! Geometry of built-in shape. Triangle uses all three points, Sphere uses first point as center and ```radius```
+struct ShapeData {
+    ShapeType type = ShapeType::Other;
+    std::array<Math::Vector3f, 3> points;
+    float radius = 0.f;
+};
+
 //! Abstraction for hittable object
 class IHittable {
 public:
@@ -14,20 +32,68 @@ public:
     constexpr IHittable(IHittable&&) = default;
     constexpr IHittable& operator=(const IHittable&) = default;
 
-    //! Performs Ray-IHittable intersection. Should return true if hit
+    //! Performs Ray-IHittable intersection. Should return true if hit and record only distance, itself and data that ComputeSurfaceInteraction needs
     virtual bool Hit(const Ray &ray, float tMin, float tMax, HitPayload &payload) const noexcept = 0;
 
+    //! Fills normal, texture coordinates and material of hit recorded by Hit. Called once for the closest hit with ```ray``` that was passed to Hit
+    virtual void ComputeSurfaceInteraction(const Ray &ray, HitPayload &payload) const noexcept = 0;
+
+    //! Checks if ray hits anything in [tMin, tMax]. Computes no surface data, so should be cheaper than Hit
+    virtual bool Occluded(const Ray &ray, float tMin, float tMax) const noexcept = 0;
+
     //! Returns centroid of geometric shape. Centroid is mass center
     virtual Math::Vector3f GetCentroid() const noexcept = 0;
 
     //! Returns AABB of the shape. It must contain entire shape
     virtual AABB GetBoundingBox() const noexcept = 0;
 
+    //! Returns bounds of parts of the shape on both sides of plane at ```position``` along ```axis```. Default cuts AABB of the shape
+    virtual std::pair<AABB, AABB> SplitBoundingBox(int axis, float position) const noexcept {
+        AABB left = GetBoundingBox(), right = left;
+        left.max[axis] = Math::Min(left.max[axis], position);
+        right.min[axis] = Math::Max(right.min[axis], position);
+        return {left, right};
+    }
+
     //! Returns point on surface. Should uniformly sample surface
     virtual Math::Vector3f SampleUniform(const Math::Vector2f &sample) const noexcept = 0;
 
     //! Returns surface area of shape
     virtual float GetSurfaceArea() const noexcept = 0;
+
+    //! Returns geometry of built-in shape. Hit of such shape must record only distance, itself and barycentrics for triangles. Default is Other, which is always tested through Hit
+    virtual ShapeData GetShapeData() const noexcept {
+        return {};
+    }
+
+protected:
+    //! Clips triangle by plane. Bounds of both parts hold vertices on their side and points where edges cross the plane
+    constexpr static std::pair<AABB, AABB> SplitTriangleBoundingBox(const Math::Vector3f &a, const Math::Vector3f &b, const Math::Vector3f &c, int axis, float position) noexcept {
+        const Math::Vector3f *vertices[3] = {&a, &b, &c};
+        AABB left = AABB::Empty(), right = AABB::Empty();
+
+        for (int i = 0; i < 3; ++i) {
+            const Math::Vector3f &from = *vertices[i];
+            const Math::Vector3f &to = *vertices[(i + 1) % 3];
+
+            if (from[axis] <= position) {
+                left = AABB(left, AABB(from, from));
+            }
+
+            if (from[axis] >= position) {
+                right = AABB(right, AABB(from, from));
+            }
+
+            if ((from[axis] < position && to[axis] > position) || (from[axis] > position && to[axis] < position)) {
+                Math::Vector3f point = from + (to - from) * ((position - from[axis]) / (to[axis] - from[axis]));
+                point[axis] = position;
+                left = AABB(left, AABB(point, point));
+                right = AABB(right, AABB(point, point));
+            }
+        }
+
+        return {left, right};
+    }
 };
 
 #endif
@@ -13,6 +13,14 @@ public:
         return false;
     }
 
+    //! Is never called, Hit records nothing
+    constexpr void ComputeSurfaceInteraction(const Ray &ray, HitPayload &payload) const noexcept override {}
+
+    //! Performs no hit. Returns false
+    constexpr bool Occluded(const Ray &ray, float tMin, float tMax) const noexcept override {
+        return false;
+    }
+
     //! Returns zero Vector3f
     constexpr Math::Vector3f GetCentroid() const noexcept override {
         return Math::Vector3f(0.f);
@@ -1,45 +1,25 @@
 #include "Polygon.h"
 
 bool Polygon::Hit(const Ray &ray, float tMin, float tMax, HitPayload &payload) const noexcept {
-    auto vertices = m_Mesh->GetVertices();
-    auto indices = m_Mesh->GetIndices();
-
-    const auto &p0 = vertices[indices[3 * m_FaceIndex + 0]].position;
-    const auto &p1 = vertices[indices[3 * m_FaceIndex + 1]].position;
-    const auto &p2 = vertices[indices[3 * m_FaceIndex + 2]].position;
-
-    Math::Vector3f rayCrossEdge2 = Math::Cross(ray.direction, m_Edges[1]);
-    float determinant = Math::Dot(m_Edges[0], rayCrossEdge2);
-
-    if (Math::Abs(determinant) < Math::Constants::Epsilon<float>) {
-        return false;
-    }
-
-    float inverseDeterminant = 1.f / determinant;
-    Math::Vector3f s = ray.origin - p0;
-    float u = inverseDeterminant * Math::Dot(s, rayCrossEdge2);
-
-    if (u < 0.f || u > 1.f) {
+    float t, u, v;
+    if (!Intersect(ray, tMin, tMax, t, u, v)) {
         return false;
     }
 
-    Math::Vector3f sCrossEdge1 = Math::Cross(s, m_Edges[0]);
-    float v = inverseDeterminant * Math::Dot(ray.direction, sCrossEdge1);
-
-    if (v < 0.f || u + v > 1.f) {
-        return false;
-    }
-
-    float t = inverseDeterminant * Math::Dot(m_Edges[1], sCrossEdge1);
+    payload.t = t;
+    payload.hittable = this;
+    payload.barycentrics = Math::Vector2f(u, v);
 
-    if (t < tMin || tMax < t) {
-        return false;
-    }    
+    return true;
+}
 
-    Math::Vector3f p = ray.origin + ray.direction * t;
+void Polygon::ComputeSurfaceInteraction(const Ray &ray, HitPayload &payload) const noexcept {
+    auto vertices = m_Mesh->GetVertices();
+    auto indices = m_Mesh->GetIndices();
 
-    std::array<Math::Vector3f, 3> pointToVertices = {p0 - p, p1 - p, p2 - p};
-    auto [u0, u1, u2] = ComputeBarycentrics(std::span{pointToVertices});
+    float u1 = payload.barycentrics.x;
+    float u2 = payload.barycentrics.y;
+    float u0 = 1.f - u1 - u2;
 
     auto n0 = vertices[indices[3 * m_FaceIndex + 0]].normal;
     auto n1 = vertices[indices[3 * m_FaceIndex + 1]].normal;
@@ -78,8 +58,46 @@ bool Polygon::Hit(const Ray &ray, float tMin, float tMax, HitPayload &payload) c
         payload.normal = normal;
     }
 
-    payload.t = t;
     payload.material = &materials[materialIndices[m_FaceIndex]];
+}
+
+bool Polygon::Occluded(const Ray &ray, float tMin, float tMax) const noexcept {
+    float t, u, v;
+    return Intersect(ray, tMin, tMax, t, u, v);
+}
+
+bool Polygon::Intersect(const Ray &ray, float tMin, float tMax, float &t, float &u, float &v) const noexcept {
+    auto [p0, p1, p2] = GetPositions();
+    Math::Vector3f edge1 = p1 - p0;
+    Math::Vector3f edge2 = p2 - p0;
+
+    Math::Vector3f rayCrossEdge2 = Math::Cross(ray.direction, edge2);
+    float determinant = Math::Dot(edge1, rayCrossEdge2);
+
+    if (Math::Abs(determinant) < Math::Constants::Epsilon<float>) {
+        return false;
+    }
+
+    float inverseDeterminant = 1.f / determinant;
+    Math::Vector3f s = ray.origin - p0;
+    u = inverseDeterminant * Math::Dot(s, rayCrossEdge2);
+
+    if (u < 0.f || u > 1.f) {
+        return false;
+    }
+
+    Math::Vector3f sCrossEdge1 = Math::Cross(s, edge1);
+    v = inverseDeterminant * Math::Dot(ray.direction, sCrossEdge1);
+
+    if (v < 0.f || u + v > 1.f) {
+        return false;
+    }
+
+    t = inverseDeterminant * Math::Dot(edge2, sCrossEdge1);
+
+    if (t < tMin || tMax < t) {
+        return false;
+    }
 
     return true;
 }
\ No newline at end of file
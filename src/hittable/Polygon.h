@@ -4,37 +4,42 @@
 #include "../assets/Model.h"
 #include "Triangle.h"
 
-//! Primitive element of Mesh
+#include <array>
+
+//! Primitive element of Mesh. Holds only references to its face, geometry is read from mesh. Model BVH traverses gathered vertex positions instead
 class Polygon final : public IHittable {
 public:
     constexpr Polygon(const Model *model, const Mesh *mesh, int faceIndex) noexcept :
         m_Model(model), m_Mesh(mesh), m_FaceIndex(faceIndex) {
-        auto vertices = mesh->GetVertices();
-        auto indices = mesh->GetIndices();
-
-        const auto &p0 = vertices[indices[3 * m_FaceIndex + 0]].position;
-        const auto &p1 = vertices[indices[3 * m_FaceIndex + 1]].position;
-        const auto &p2 = vertices[indices[3 * m_FaceIndex + 2]].position;
-
-        m_Centroid = (p0 + p1 + p2) * Math::Constants::OneThird<float>;
-        m_AABB = AABB(Math::Min(p0, Math::Min(p1, p2)), Math::Max(p0, Math::Max(p1, p2)));
-        m_TwiceSurfaceArea = Math::Length(Math::Cross(p1 - p0, p2 - p0));
-        m_SurfaceArea = m_TwiceSurfaceArea * 0.5f;
-        m_Edges[0] = p1 - p0;
-        m_Edges[1] = p2 - p0;
+        auto [p0, p1, p2] = GetPositions();
+        m_SurfaceArea = Math::Length(Math::Cross(p1 - p0, p2 - p0)) * 0.5f;
     }
 
-    //! Performs Ray-Triangle intersection with all model stuff like tangents, texture coordinates and weighted normals
+    //! Performs Ray-Triangle intersection. Records distance and barycentrics only, most candidates are replaced by closer hits
     bool Hit(const Ray &ray, float tMin, float tMax, HitPayload &payload) const noexcept override;
 
+    //! Interpolates weighted normals and texture coordinates at recorded barycentrics and applies bump map
+    void ComputeSurfaceInteraction(const Ray &ray, HitPayload &payload) const noexcept override;
+
+    //! Checks if ray hits Triangle in [tMin, tMax]. Skips normals, texture coordinates and bump mapping
+    bool Occluded(const Ray &ray, float tMin, float tMax) const noexcept override;
+
     //! Returns centroid of Triangle
     constexpr Math::Vector3f GetCentroid() const noexcept override {
-        return m_Centroid;
+        auto [p0, p1, p2] = GetPositions();
+        return (p0 + p1 + p2) * Math::Constants::OneThird<float>;
     }
 
     //! Returns AABB of Triangle
     constexpr AABB GetBoundingBox() const noexcept override {
-        return m_AABB;
+        auto [p0, p1, p2] = GetPositions();
+        return AABB(Math::Min(p0, Math::Min(p1, p2)), Math::Max(p0, Math::Max(p1, p2)));
+    }
+
+    //! Returns bounds of Triangle parts on both sides of plane
+    constexpr std::pair<AABB, AABB> SplitBoundingBox(int axis, float position) const noexcept override {
+        auto [p0, p1, p2] = GetPositions();
+        return SplitTriangleBoundingBox(p0, p1, p2, axis, position);
     }
 
     //! Returns point on surface of Triangle
@@ -43,13 +48,7 @@ public:
         float b0 = 1.f - sqrt;
         float b1 = sample.y * sqrt;
 
-        auto vertices = m_Mesh->GetVertices();
-        auto indices = m_Mesh->GetIndices();
-
-        const auto &p0 = vertices[indices[3 * m_FaceIndex + 0]].position;
-        const auto &p1 = vertices[indices[3 * m_FaceIndex + 1]].position;
-        const auto &p2 = vertices[indices[3 * m_FaceIndex + 2]].position;
-
+        auto [p0, p1, p2] = GetPositions();
         return b0 * p0 + b1 * p1 + (1.f - b0 - b1) * p2;
     }
 
@@ -58,23 +57,27 @@ public:
         return m_SurfaceArea;
     }
 
-private:
-    constexpr std::tuple<float, float, float> ComputeBarycentrics(std::span<const Math::Vector3f> pointToVertices) const noexcept {
-        float u0 = Math::Length(Math::Cross(pointToVertices[1], pointToVertices[2])) / m_TwiceSurfaceArea;
-        float u1 = Math::Length(Math::Cross(pointToVertices[0], pointToVertices[2])) / m_TwiceSurfaceArea;
-        return {u0, u1, 1.f - u0 - u1};
+    //! Returns vertex positions of Polygon
+    constexpr ShapeData GetShapeData() const noexcept override {
+        return {ShapeType::Triangle, GetPositions()};
     }
 
+    //! Returns vertex positions in order of face indices, barycentrics of hits weight second and third one
+    constexpr std::array<Math::Vector3f, 3> GetPositions() const noexcept {
+        auto vertices = m_Mesh->GetVertices();
+        auto indices = m_Mesh->GetIndices();
+
+        return {vertices[indices[3 * m_FaceIndex + 0]].position, vertices[indices[3 * m_FaceIndex + 1]].position, vertices[indices[3 * m_FaceIndex + 2]].position};
+    }
+
+private:
+    bool Intersect(const Ray &ray, float tMin, float tMax, float &t, float &u, float &v) const noexcept;
+
 private:
     const Model *m_Model;
     const Mesh *m_Mesh;
     int m_FaceIndex;
-
-    Math::Vector3f m_Centroid;
-    AABB m_AABB;
-    float m_TwiceSurfaceArea;
     float m_SurfaceArea;
-    Math::Vector3f m_Edges[2];
 };
 
 #endif
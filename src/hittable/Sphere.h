@@ -21,33 +21,27 @@ namespace Shapes {
 
         //! Performs Ray-Sphere intersection. Returns true if hit
         constexpr bool Hit(const Ray &ray, float tMin, float tMax, HitPayload &payload) const noexcept override {
-            Math::Vector3f centerToOrigin = ray.origin - center;
-
-            float a = Math::Dot(ray.direction, ray.direction);
-            float k = Math::Dot(centerToOrigin, ray.direction);
-            float c = Math::Dot(centerToOrigin, centerToOrigin) - radiusSquared;
-            float discriminant = k * k - a * c;
-
-            if (discriminant < 0.f) {
+            float t;
+            if (!Intersect(ray, tMin, tMax, t)) {
                 return false;
             }
 
-            float t0 = (-k - Math::Sqrt(discriminant)) / a;
-            float t1 = (-k + Math::Sqrt(discriminant)) / a;
+            payload.t = t;
+            payload.hittable = this;
 
-            float t = t0;
-            if (t < tMin || tMax < t) {
-                t = t1;
-                if (t < tMin || tMax < t) {
-                    return false;
-                }
-            }
+            return true;
+        }
 
-            payload.t = t;
-            payload.normal = (ray.origin + ray.direction * t - center) * inverseRadius;
+        //! Computes outward normal at hit point
+        constexpr void ComputeSurfaceInteraction(const Ray &ray, HitPayload &payload) const noexcept override {
+            payload.normal = (ray.origin + ray.direction * payload.t - center) * inverseRadius;
             payload.material = material;
+        }
 
-            return true;
+        //! Checks if ray hits Sphere in [tMin, tMax]
+        constexpr bool Occluded(const Ray &ray, float tMin, float tMax) const noexcept override {
+            float t;
+            return Intersect(ray, tMin, tMax, t);
         }
 
         //! Returns center of Sphere
@@ -72,6 +66,38 @@ namespace Shapes {
         constexpr float GetSurfaceArea() const noexcept override {
             return 4.f * Math::Constants::Pi<float> * radiusSquared;
         }
+
+        //! Returns center and radius of Sphere
+        constexpr ShapeData GetShapeData() const noexcept override {
+            return {ShapeType::Sphere, {center, center, center}, radius};
+        }
+
+    private:
+        constexpr bool Intersect(const Ray &ray, float tMin, float tMax, float &t) const noexcept {
+            Math::Vector3f centerToOrigin = ray.origin - center;
+
+            float a = Math::Dot(ray.direction, ray.direction);
+            float k = Math::Dot(centerToOrigin, ray.direction);
+            float c = Math::Dot(centerToOrigin, centerToOrigin) - radiusSquared;
+            float discriminant = k * k - a * c;
+
+            if (discriminant < 0.f) {
+                return false;
+            }
+
+            float t0 = (-k - Math::Sqrt(discriminant)) / a;
+            float t1 = (-k + Math::Sqrt(discriminant)) / a;
+
+            t = t0;
+            if (t < tMin || tMax < t) {
+                t = t1;
+                if (t < tMin || tMax < t) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
     };
 }
 
@@ -28,39 +28,27 @@ namespace Shapes {
 
         //! Performs Ray-Triangle intersection using Moller-Trumbore algorithm. Returns true if hit
         constexpr bool Hit(const Ray &ray, float tMin, float tMax, HitPayload &payload) const noexcept override {
-            Math::Vector3f rayCrossEdge2 = Math::Cross(ray.direction, edges[1]);
-            float determinant = Math::Dot(edges[0], rayCrossEdge2);
-
-            if (Math::Abs(determinant) < Math::Constants::Epsilon<float>) {
-                return false;
-            }
-
-            float inverseDeterminant = 1.f / determinant;
-            Math::Vector3f s = ray.origin - vertices[0];
-            float u = inverseDeterminant * Math::Dot(s, rayCrossEdge2);
-
-            if (u < 0.f || u > 1.f) {
+            float t;
+            if (!Intersect(ray, tMin, tMax, t)) {
                 return false;
             }
 
-            Math::Vector3f sCrossEdge1 = Math::Cross(s, edges[0]);
-            float v = inverseDeterminant * Math::Dot(ray.direction, sCrossEdge1);
-
-            if (v < 0.f || u + v > 1.f) {
-                return false;
-            }
-
-            float t = inverseDeterminant * Math::Dot(edges[1], sCrossEdge1);
+            payload.t = t;
+            payload.hittable = this;
 
-            if (t < tMin || tMax < t) {
-                return false;
-            }
+            return true;
+        }
 
-            payload.t = t;
+        //! Sets flat normal of Triangle
+        constexpr void ComputeSurfaceInteraction(const Ray &ray, HitPayload &payload) const noexcept override {
             payload.normal = normal;
             payload.material = material;
+        }
 
-            return true;
+        //! Checks if ray hits Triangle in [tMin, tMax]
+        constexpr bool Occluded(const Ray &ray, float tMin, float tMax) const noexcept override {
+            float t;
+            return Intersect(ray, tMin, tMax, t);
         }
 
         //! Returns center of Triangle
@@ -74,6 +62,11 @@ namespace Shapes {
                         Math::Max(vertices[0], Math::Max(vertices[1], vertices[2])));
         }
 
+        //! Returns bounds of Triangle parts on both sides of plane
+        constexpr std::pair<AABB, AABB> SplitBoundingBox(int axis, float position) const noexcept override {
+            return SplitTriangleBoundingBox(vertices[0], vertices[1], vertices[2], axis, position);
+        }
+
         //! Samples Triangle surface uniformly
         constexpr Math::Vector3f SampleUniform(const Math::Vector2f &sample) const noexcept override {
             float sqrt = Math::Sqrt(sample.x);
@@ -87,6 +80,44 @@ namespace Shapes {
         constexpr float GetSurfaceArea() const noexcept override {
             return Math::Length(Math::Cross(edges[0], edges[1])) * 0.5f;
         }
+
+        //! Returns vertices of Triangle
+        constexpr ShapeData GetShapeData() const noexcept override {
+            return {ShapeType::Triangle, {vertices[0], vertices[1], vertices[2]}};
+        }
+
+    private:
+        constexpr bool Intersect(const Ray &ray, float tMin, float tMax, float &t) const noexcept {
+            Math::Vector3f rayCrossEdge2 = Math::Cross(ray.direction, edges[1]);
+            float determinant = Math::Dot(edges[0], rayCrossEdge2);
+
+            if (Math::Abs(determinant) < Math::Constants::Epsilon<float>) {
+                return false;
+            }
+
+            float inverseDeterminant = 1.f / determinant;
+            Math::Vector3f s = ray.origin - vertices[0];
+            float u = inverseDeterminant * Math::Dot(s, rayCrossEdge2);
+
+            if (u < 0.f || u > 1.f) {
+                return false;
+            }
+
+            Math::Vector3f sCrossEdge1 = Math::Cross(s, edges[0]);
+            float v = inverseDeterminant * Math::Dot(ray.direction, sCrossEdge1);
+
+            if (v < 0.f || u + v > 1.f) {
+                return false;
+            }
+
+            t = inverseDeterminant * Math::Dot(edges[1], sCrossEdge1);
+
+            if (t < tMin || tMax < t) {
+                return false;
+            }
+
+            return true;
+        }
     };
 }
 
@@ -4,7 +4,7 @@
 #include <vector>
 #include <cstdint>
 
-//! RGBA image
+//! RGBA image stored in CPU memory. Use ImageTexture to show it on screen
 class Image {
 public:
     Image() = delete;
@@ -17,14 +17,6 @@ public:
     //! Sets RGBA value at element with given  ```index```
     void SetPixel(int index, std::uint32_t value) noexcept;
 
-    //! Updates image information in GPU
-    void Update() noexcept;
-
-    //! Returns descriptor to texture
-    constexpr unsigned int GetDescriptor() const noexcept {
-        return m_Descriptor;
-    }
-
     //! Returns width of Image
     constexpr int GetWidth() const noexcept {
         return m_Width;
@@ -53,7 +45,6 @@ public:
 private:
     std::uint32_t *m_Data; 
     int m_Width, m_Height;
-    unsigned int m_Descriptor;
 };
 
 #endif
\ No newline at end of file
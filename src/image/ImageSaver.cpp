@@ -1,7 +1,7 @@
 #include "ImageSaver.h"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "../stb-master/stb_image_write.h"
+#include "../../stb-master/stb_image_write.h"
 
 void ImageSaver::Save(const std::filesystem::path &pathToFile) noexcept {
     if (m_Image == nullptr) {
@@ -0,0 +1,36 @@
+#include "ImageTexture.h"
+
+#ifdef _WIN32
+#include <gl/gl.h>
+#elif __linux__
+#include <GL/gl.h>
+#endif
+
+ImageTexture::ImageTexture(const Image *image) noexcept :
+    m_Image(image) {
+
+    glGenTextures(1, &m_Descriptor);
+    glBindTexture(GL_TEXTURE_2D, m_Descriptor);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_Image->GetWidth(), m_Image->GetHeight(), 0, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)m_Image->GetData());
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+ImageTexture::~ImageTexture() noexcept {
+    glDeleteTextures(1, &m_Descriptor);
+}
+
+void ImageTexture::Update() noexcept {
+    glBindTexture(GL_TEXTURE_2D, m_Descriptor);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_Image->GetWidth(), m_Image->GetHeight(), GL_RGBA, GL_UNSIGNED_BYTE, (const void*)m_Image->GetData());
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
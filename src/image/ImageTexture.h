@@ -0,0 +1,36 @@
+#ifndef _IMAGE_TEXTURE_H
+#define _IMAGE_TEXTURE_H
+
+#include "Image.h"
+
+//! OpenGL texture that mirrors Image. Requires current OpenGL context
+class ImageTexture {
+public:
+    ImageTexture() = delete;
+    ImageTexture(const ImageTexture&) = delete;
+    ImageTexture& operator=(const ImageTexture&) = delete;
+
+    //! Creates texture with size of given Image
+    ImageTexture(const Image *image) noexcept;
+
+    ~ImageTexture() noexcept;
+
+    //! Uploads Image data to GPU
+    void Update() noexcept;
+
+    //! Returns descriptor to texture
+    constexpr unsigned int GetDescriptor() const noexcept {
+        return m_Descriptor;
+    }
+
+    //! Returns Image that texture mirrors
+    constexpr const Image* GetImage() const noexcept {
+        return m_Image;
+    }
+
+private:
+    const Image *m_Image;
+    unsigned int m_Descriptor;
+};
+
+#endif
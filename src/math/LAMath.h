@@ -7,6 +7,7 @@
 #include "Vector4.h"
 #include "Matrix3.h"
 #include "Matrix4.h"
+#include "Matrix3x4.h"
 #include "MatrixCommon.h"
 #include "ElementaryFunctions.h"
 #include "GeometricFunctions.h"
@@ -24,6 +25,7 @@ namespace Math {
 
     using Matrix3f = Types::Matrix<float, 3, 3>;
     using Matrix4f = Types::Matrix<float, 4, 4>;
+    using Matrix3x4f = Types::Matrix<float, 3, 4>;
 }
 
 #endif
@@ -0,0 +1,51 @@
+#ifndef _MATRIX_3X4_H
+#define _MATRIX_3X4_H
+
+#include "Constants.h"
+#include "Types.h"
+
+#include <array>
+
+namespace Math {
+    namespace Types {
+        //! 3x4 Matrix. Affine transformation with implicit last row (0, 0, 0, 1)
+        template<typename T>
+        struct Matrix<T, 3, 4> {
+            union {
+                struct { T data[12]; };
+                struct { T table[3][4]; };
+            };
+
+            constexpr Matrix() noexcept {
+                for (int i = 0; i < 12; ++i) {
+                    data[i] = Constants::Zero<T>;
+                }
+            }
+
+            constexpr Matrix(const std::array<T, 12> &elements) noexcept {
+                for (int i = 0; i < 12; ++i) {
+                    data[i] = elements[i];
+                }
+            }
+
+            //! Drops last row of ```m```, which is expected to be (0, 0, 0, 1)
+            constexpr explicit Matrix(const Matrix<T, 4, 4> &m) noexcept {
+                for (int i = 0; i < 12; ++i) {
+                    data[i] = m.data[i];
+                }
+            }
+
+            constexpr Matrix(const Matrix &other) noexcept = default;
+
+            constexpr const T* operator[](std::size_t index) const noexcept {
+                return table[index];
+            }
+
+            constexpr T* operator[](std::size_t index) noexcept {
+                return table[index];
+            }
+        };
+    }
+}
+
+#endif
@@ -201,6 +201,42 @@ namespace Math {
 
         return inverse;
     }
+
+    //! Inverts affine transformation. Inverse of linear part is applied to negated translation
+    template<typename T>
+    constexpr Types::Matrix<T, 3, 4> Inverse(const Types::Matrix<T, 3, 4> &m) noexcept {
+        Types::Matrix<T, 3, 4> inverse;
+
+        inverse[0][0] = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+        inverse[0][1] = m[0][2] * m[2][1] - m[0][1] * m[2][2];
+        inverse[0][2] = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+        inverse[1][0] = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+        inverse[1][1] = m[0][0] * m[2][2] - m[0][2] * m[2][0];
+        inverse[1][2] = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+        inverse[2][0] = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+        inverse[2][1] = m[0][1] * m[2][0] - m[0][0] * m[2][1];
+        inverse[2][2] = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+
+        T determinant = m[0][0] * inverse[0][0] + m[0][1] * inverse[1][0] + m[0][2] * inverse[2][0];
+
+        if (Abs(determinant) <= Constants::Epsilon<T>) {
+            return Types::Matrix<T, 3, 4>(IdentityMatrix<T, 4>());
+        }
+
+        T inverseDeterminant = Constants::One<T> / determinant;
+
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                inverse[i][j] *= inverseDeterminant;
+            }
+        }
+
+        for (int i = 0; i < 3; ++i) {
+            inverse[i][3] = -(inverse[i][0] * m[0][3] + inverse[i][1] * m[1][3] + inverse[i][2] * m[2][3]);
+        }
+
+        return inverse;
+    }
 }
 
 #endif
\ No newline at end of file
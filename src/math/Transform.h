@@ -54,6 +54,35 @@ namespace Math {
         return transform * Types::Vector<T, 4>(v, Constants::One<T>);
     }
 
+    //! Applies linear part of affine transformation only
+    template<typename T>
+    constexpr Types::Vector<T, 3> TransformVector(const Types::Matrix<T, 3, 4> &transform, const Types::Vector<T, 3> &v) noexcept {
+        return Types::Vector<T, 3>(
+            transform[0][0] * v.x + transform[0][1] * v.y + transform[0][2] * v.z,
+            transform[1][0] * v.x + transform[1][1] * v.y + transform[1][2] * v.z,
+            transform[2][0] * v.x + transform[2][1] * v.y + transform[2][2] * v.z
+        );
+    }
+
+    //! Transforms normal by transposed linear part of ```inverseTransform```, so it stays perpendicular to transformed surface. Result is not normalized
+    template<typename T>
+    constexpr Types::Vector<T, 3> TransformNormal(const Types::Matrix<T, 3, 4> &inverseTransform, const Types::Vector<T, 3> &n) noexcept {
+        return Types::Vector<T, 3>(
+            inverseTransform[0][0] * n.x + inverseTransform[1][0] * n.y + inverseTransform[2][0] * n.z,
+            inverseTransform[0][1] * n.x + inverseTransform[1][1] * n.y + inverseTransform[2][1] * n.z,
+            inverseTransform[0][2] * n.x + inverseTransform[1][2] * n.y + inverseTransform[2][2] * n.z
+        );
+    }
+
+    template<typename T>
+    constexpr Types::Vector<T, 3> TransformPoint(const Types::Matrix<T, 3, 4> &transform, const Types::Vector<T, 3> &v) noexcept {
+        return Types::Vector<T, 3>(
+            transform[0][0] * v.x + transform[0][1] * v.y + transform[0][2] * v.z + transform[0][3],
+            transform[1][0] * v.x + transform[1][1] * v.y + transform[1][2] * v.z + transform[1][3],
+            transform[2][0] * v.x + transform[2][1] * v.y + transform[2][2] * v.z + transform[2][3]
+        );
+    }
+
     template<typename T>
     constexpr Types::Matrix<T, 3, 3> GenerateTangentSpace(const Types::Vector<T, 3> &normal) noexcept {
         Types::Vector<T, 3> axis(Math::Constants::One<T>, Math::Constants::Zero<T>, Math::Constants::Zero<T>);
@@ -0,0 +1,96 @@
+#ifndef _ALIAS_TABLE_H
+#define _ALIAS_TABLE_H
+
+#include "../math/LAMath.h"
+
+#include <vector>
+#include <span>
+
+//! Walker-Vose alias table. Samples index proportionally to its weight in O(1)
+class AliasTable {
+public:
+    //! Constructs empty table
+    AliasTable() noexcept = default;
+
+    //! Builds table from non-negative ```weights```. If all weights are zero, indices are sampled uniformly
+    inline AliasTable(std::span<const float> weights) noexcept {
+        int n = static_cast<int>(weights.size());
+        m_Probabilities.resize(n);
+        m_Aliases.resize(n);
+        m_Pdfs.resize(n);
+
+        if (n == 0) {
+            return;
+        }
+
+        float totalWeight = 0.f;
+        for (float weight : weights) {
+            totalWeight += Math::Max(weight, 0.f);
+        }
+
+        for (int i = 0; i < n; ++i) {
+            m_Pdfs[i] = totalWeight > 0.f ? Math::Max(weights[i], 0.f) / totalWeight : 1.f / static_cast<float>(n);
+        }
+
+        std::vector<float> scaled(n);
+        std::vector<int> small, large;
+        for (int i = 0; i < n; ++i) {
+            scaled[i] = m_Pdfs[i] * static_cast<float>(n);
+            (scaled[i] < 1.f ? small : large).push_back(i);
+        }
+
+        while (!small.empty() && !large.empty()) {
+            int less = small.back();
+            small.pop_back();
+            int more = large.back();
+            large.pop_back();
+
+            m_Probabilities[less] = scaled[less];
+            m_Aliases[less] = more;
+
+            scaled[more] = scaled[more] + scaled[less] - 1.f;
+            (scaled[more] < 1.f ? small : large).push_back(more);
+        }
+
+        for (int i : large) {
+            m_Probabilities[i] = 1.f;
+            m_Aliases[i] = i;
+        }
+
+        for (int i : small) {
+            m_Probabilities[i] = 1.f;
+            m_Aliases[i] = i;
+        }
+    }
+
+    //! Returns sampled index for uniform ```sample``` in [0, 1) and writes its probability to ```pdf```. Table must not be empty
+    inline int Sample(float sample, float &pdf) const noexcept {
+        int n = GetSize();
+        float scaled = sample * static_cast<float>(n);
+        int index = Math::Min(static_cast<int>(scaled), n - 1);
+
+        if (scaled - static_cast<float>(index) >= m_Probabilities[index]) {
+            index = m_Aliases[index];
+        }
+
+        pdf = m_Pdfs[index];
+        return index;
+    }
+
+    //! Returns probability of sampling ```index```
+    inline float GetPdf(int index) const noexcept {
+        return m_Pdfs[index];
+    }
+
+    //! Returns number of entries
+    inline int GetSize() const noexcept {
+        return static_cast<int>(m_Pdfs.size());
+    }
+
+private:
+    std::vector<float> m_Probabilities;
+    std::vector<int> m_Aliases;
+    std::vector<float> m_Pdfs;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "LightSampler.h"
+
+#include <vector>
+
+LightSampler::~LightSampler() noexcept {
+    if (m_LightBVH != nullptr) {
+        delete m_LightBVH;
+    }
+}
+
+void LightSampler::Build(std::span<const Light> lights) noexcept {
+    m_Lights = lights;
+
+    std::vector<float> powers;
+    powers.reserve(lights.size());
+    for (const auto &light : lights) {
+        powers.push_back(light.GetPower());
+    }
+
+    m_PowerTable = AliasTable(powers);
+
+    if (m_LightBVH != nullptr) {
+        delete m_LightBVH;
+    }
+
+    m_LightBVH = new LightBVH(lights);
+}
+
+const Light* LightSampler::Sample(const Math::Vector3f &point, float sample, float &pdf) const noexcept {
+    if (m_Lights.empty()) {
+        pdf = 0.f;
+        return nullptr;
+    }
+
+    int index;
+    switch (m_Strategy) {
+    case LightSamplingStrategy::BVH:
+        index = m_LightBVH->Sample(point, sample, pdf);
+        break;
+    case LightSamplingStrategy::Power:
+        index = m_PowerTable.Sample(sample, pdf);
+        break;
+    default:
+        index = Math::Min(static_cast<int>(sample * static_cast<float>(m_Lights.size())), static_cast<int>(m_Lights.size()) - 1);
+        pdf = 1.f / static_cast<float>(m_Lights.size());
+        break;
+    }
+
+    return &m_Lights[index];
+}
@@ -0,0 +1,55 @@
+#ifndef _LIGHT_SAMPLER_H
+#define _LIGHT_SAMPLER_H
+
+#include "../Light.h"
+#include "../acceleration/LightBVH.h"
+#include "AliasTable.h"
+
+#include <span>
+
+//! Strategy used to pick light sources for direct lighting
+enum class LightSamplingStrategy : int {
+    All = 0,
+    Power,
+    BVH
+};
+
+//! Chooses light sources for shadow rays. Either every light is sampled or one light is picked stochastically
+class LightSampler {
+public:
+    LightSampler() noexcept = default;
+    LightSampler(const LightSampler&) = delete;
+    LightSampler& operator=(const LightSampler&) = delete;
+
+    ~LightSampler() noexcept;
+
+    //! Rebuilds alias table and light BVH for given lights. Lights must outlive the sampler or next Build
+    void Build(std::span<const Light> lights) noexcept;
+
+    //! Picks one light for shading ```point```. Writes probability of the choice to ```pdf```. Returns nullptr if there are no lights
+    const Light* Sample(const Math::Vector3f &point, float sample, float &pdf) const noexcept;
+
+    //! Returns all lights
+    inline std::span<const Light> GetLights() const noexcept {
+        return m_Lights;
+    }
+
+    //! Returns current strategy
+    constexpr LightSamplingStrategy GetStrategy() const noexcept {
+        return m_Strategy;
+    }
+
+    //! Sets strategy used by Renderer
+    constexpr void SetStrategy(LightSamplingStrategy strategy) noexcept {
+        m_Strategy = strategy;
+    }
+
+private:
+    std::span<const Light> m_Lights;
+    LightSamplingStrategy m_Strategy = LightSamplingStrategy::BVH;
+
+    AliasTable m_PowerTable;
+    LightBVH *m_LightBVH = nullptr;
+};
+
+#endif